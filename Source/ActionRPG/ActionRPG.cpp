@@ -3,4 +3,16 @@
 #include "ActionRPG.h"
 #include "Modules/ModuleManager.h"
 
+DEFINE_LOG_CATEGORY(LogActionRPG);
+
+TAutoConsoleVariable<int32> CVarThreadSafeAnimUpdate(
+	TEXT("ActionRPG.Anim.ThreadSafeUpdate"),
+	1,
+	TEXT("1: anim instances snapshot their pawn on the game thread and update on the animation worker. 0: AnimBPs update them through UpdateAnimationProperties on the game thread."));
+
+TAutoConsoleVariable<int32> CVarParkHitboxes(
+	TEXT("ActionRPG.Hitbox.Park"),
+	1,
+	TEXT("1: blade boxes are detached outside hit windows and equipped items detach their idle components and stop overlapping. 0: they stay attached and follow their bones every frame."));
+
 IMPLEMENT_PRIMARY_GAME_MODULE( FDefaultGameModuleImpl, ActionRPG, "ActionRPG" );
@@ -3,4 +3,16 @@
 #pragma once
 
 #include "CoreMinimal.h"
+#include "Stats/Stats.h"
+#include "HAL/IConsoleManager.h"
 
+DECLARE_LOG_CATEGORY_EXTERN(LogActionRPG, Log, All);
+
+// "stat ActionRPG" shows the gameplay systems' counters and timings
+DECLARE_STATS_GROUP(TEXT("ActionRPG"), STATGROUP_ActionRPG, STATCAT_Advanced);
+
+// 0 puts the anim instances back on their old game thread UpdateAnimationProperties path
+extern TAutoConsoleVariable<int32> CVarThreadSafeAnimUpdate;
+
+// 0 keeps inactive blade boxes and equipped items' pickup components attached and updating, see FParkedComponent
+extern TAutoConsoleVariable<int32> CVarParkHitboxes;
@@ -2,4 +2,137 @@
 
 
 #include "ActionRPGGameModeBase.h"
+#include "ActionRPG.h"
+#include "Enemy.h"
+#include "ActorPoolSubsystem.h"
+#include "EnemySignificanceSubsystem.h"
+#include "DormantRegionSubsystem.h"
+#include "Engine/World.h"
 
+DECLARE_DWORD_COUNTER_STAT(TEXT("Director Population"), STAT_DirectorPopulation, STATGROUP_ActionRPG);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Director Max Population"), STAT_DirectorMaxPopulation, STATGROUP_ActionRPG);
+DECLARE_FLOAT_COUNTER_STAT(TEXT("Director Spawn Budget Used (ms)"), STAT_DirectorSpawnMs, STATGROUP_ActionRPG);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Director Spawns"), STAT_DirectorSpawns, STATGROUP_ActionRPG);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Director Deferred Spawns"), STAT_DirectorDeferred, STATGROUP_ActionRPG);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Director Recycled"), STAT_DirectorRecycled, STATGROUP_ActionRPG);
+
+AActionRPGGameModeBase::AActionRPGGameModeBase()
+{
+	PrimaryActorTick.bCanEverTick = true;
+
+	MaxPopulation = 60;
+	SpawnBudgetMs = 2.f;
+	RecycleMinBucket = 2;
+	MaxRecyclesPerFrame = 2;
+
+	Population = 0;
+	SpawnFrame = 0;
+	SpawnSeconds = 0.0;
+	FrameSpawns = 0;
+}
+
+void AActionRPGGameModeBase::Tick(float DeltaSeconds)
+{
+	Super::Tick(DeltaSeconds);
+
+	CountPopulation();
+
+	// Placed enemies and horde promotions don't ask first, trim them back gradually
+	for (int32 i = 0; i < MaxRecyclesPerFrame && Population > MaxPopulation; ++i) {
+
+		if (!RecycleLeastSignificant()) break;
+	}
+
+	SET_DWORD_STAT(STAT_DirectorPopulation, Population);
+	SET_DWORD_STAT(STAT_DirectorMaxPopulation, MaxPopulation);
+}
+
+void AActionRPGGameModeBase::CountPopulation()
+{
+	Population = 0;
+
+	UEnemySignificanceSubsystem* Significance = GetWorld()->GetSubsystem<UEnemySignificanceSubsystem>();
+	if (!Significance) return;
+
+	for (AEnemy* Enemy : Significance->GetEnemies()) {
+
+		if (Enemy && Enemy->Alive()) {
+
+			++Population;
+		}
+	}
+}
+
+bool AActionRPGGameModeBase::RequestSpawn(UClass* Class, const FTransform& Transform)
+{
+	if (!Class) return true;
+
+	if (SpawnFrame != GFrameCounter) {
+
+		SpawnFrame = GFrameCounter;
+		SpawnSeconds = 0.0;
+		FrameSpawns = 0;
+	}
+
+	if (FrameSpawns > 0 && SpawnSeconds * 1000.0 >= SpawnBudgetMs) {
+
+		INC_DWORD_STAT(STAT_DirectorDeferred);
+		return false;
+	}
+
+	const bool bEnemy = Class->IsChildOf(AEnemy::StaticClass());
+	if (bEnemy && !HasRoomForEnemy() && !RecycleLeastSignificant()) {
+
+		INC_DWORD_STAT(STAT_DirectorDeferred);
+		return false;
+	}
+
+	UActorPoolSubsystem* ActorPool = GetWorld()->GetSubsystem<UActorPoolSubsystem>();
+	if (!ActorPool) return true;
+
+	const double StartTime = FPlatformTime::Seconds();
+	AActor* Spawned = ActorPool->AcquireActor(Class, Transform);
+	SpawnSeconds += FPlatformTime::Seconds() - StartTime;
+	++FrameSpawns;
+
+	if (Spawned && bEnemy) {
+
+		++Population;
+	}
+
+	INC_DWORD_STAT(STAT_DirectorSpawns);
+	SET_FLOAT_STAT(STAT_DirectorSpawnMs, SpawnSeconds * 1000.0);
+	return true;
+}
+
+bool AActionRPGGameModeBase::RecycleLeastSignificant()
+{
+	UEnemySignificanceSubsystem* Significance = GetWorld()->GetSubsystem<UEnemySignificanceSubsystem>();
+	if (!Significance) return false;
+
+	// Only enemies nobody is fighting, a chase or a fight in progress is never cut short
+	AEnemy* Victim = nullptr;
+	for (AEnemy* Enemy : Significance->GetEnemies()) {
+
+		if (!Enemy || !Enemy->Alive() || Enemy->SignificanceBucket < RecycleMinBucket) continue;
+		if (Enemy->AggroTarget || !IsEnemyStateIn(Enemy->GetEnemyState(), EEnemyState::ES_Passive)) continue;
+
+		if (!Victim || Enemy->SignificanceScore > Victim->SignificanceScore) {
+
+			Victim = Enemy;
+		}
+	}
+
+	if (!Victim) return false;
+
+	// A placed enemy only goes to sleep and comes back with its cell, releasing it would delete it from the level
+	UDormantRegionSubsystem* Regions = GetWorld()->GetSubsystem<UDormantRegionSubsystem>();
+	if (!Regions || !Regions->DehydrateActor(Victim)) {
+
+		Victim->Disappear();
+	}
+	--Population;
+
+	INC_DWORD_STAT(STAT_DirectorRecycled);
+	return true;
+}
@@ -7,11 +7,58 @@
 #include "ActionRPGGameModeBase.generated.h"
 
 /**
- * 
+ * Directs the enemy population across every spawn volume. Volumes hand their queued spawns to the
+ * game mode, which keeps the number of live enemies under MaxPopulation and the time spent spawning
+ * under SpawnBudgetMs a frame. When the population is full the least significant idle enemy is
+ * recycled to make room, and enemies past the cap from elsewhere are recycled the same way.
  */
 UCLASS()
 class ACTIONRPG_API AActionRPGGameModeBase : public AGameModeBase
 {
 	GENERATED_BODY()
-	
+
+public:
+
+	AActionRPGGameModeBase();
+
+	// Live enemies allowed at once, whoever spawned them
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Population")
+	int32 MaxPopulation;
+
+	// Time all volumes together may spend spawning in a frame, at least one spawn always goes through
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Population")
+	float SpawnBudgetMs;
+
+	// Only enemies in this significance bucket or less significant ones are recycled
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Population")
+	int32 RecycleMinBucket;
+
+	// Enemies recycled per frame while the population is over MaxPopulation
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Population")
+	int32 MaxRecyclesPerFrame;
+
+	// Spawns Class through the actor pool if the budgets allow it, false means try again next frame
+	bool RequestSpawn(UClass* Class, const FTransform& Transform);
+
+	// False once enemies can only be added by recycling others
+	bool HasRoomForEnemy() const { return Population < MaxPopulation; }
+
+	UFUNCTION(BlueprintPure, Category = "Population")
+	int32 GetPopulation() const { return Population; }
+
+	virtual void Tick(float DeltaSeconds) override;
+
+private:
+
+	// Returns the least significant idle enemy to the pool, false when every enemy is needed
+	bool RecycleLeastSignificant();
+
+	void CountPopulation();
+
+	int32 Population;
+
+	// Spawn budget spent in SpawnFrame
+	uint64 SpawnFrame;
+	double SpawnSeconds;
+	int32 FrameSpawns;
 };
@@ -0,0 +1,308 @@
+// Copyright by Hakan Akkurt
+
+
+#include "ActorPoolSubsystem.h"
+#include "ActionRPG.h"
+#include "PoolableActor.h"
+#include "Enemy.h"
+#include "Engine/World.h"
+#include "TimerManager.h"
+#include "CombatSchedulerSubsystem.h"
+#include "HAL/IConsoleManager.h"
+#include "UObject/UObjectGlobals.h"
+
+DECLARE_DWORD_COUNTER_STAT(TEXT("Pool Hits"), STAT_PoolHits, STATGROUP_ActionRPG);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Pool Misses"), STAT_PoolMisses, STATGROUP_ActionRPG);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Pooled Actors"), STAT_PooledActors, STATGROUP_ActionRPG);
+
+UActorPoolSubsystem::UActorPoolSubsystem()
+{
+	MaxPooledPerClass = 64;
+}
+
+bool UActorPoolSubsystem::ShouldCreateSubsystem(UObject* Outer) const
+{
+	UWorld* World = Cast<UWorld>(Outer);
+	return World && World->IsGameWorld();
+}
+
+void UActorPoolSubsystem::Deinitialize()
+{
+	DEC_DWORD_STAT_BY(STAT_PooledActors, PooledActors.Num());
+
+	Pools.Empty();
+	PooledActors.Empty();
+
+	Super::Deinitialize();
+}
+
+void UActorPoolSubsystem::Prewarm(TSubclassOf<AActor> Class, int32 Count)
+{
+	if (!Class) return;
+
+	FActorPool& Pool = Pools.FindOrAdd(Class);
+	const int32 ToSpawn = FMath::Min(Count, MaxPooledPerClass) - Pool.FreeActors.Num();
+
+	// Spawn well out of the level so BeginPlay can't overlap anything before the actor is parked
+	const FTransform ParkingTransform(FVector(0.f, 0.f, -100000.f));
+
+	for (int32 i = 0; i < ToSpawn; ++i) {
+
+		AActor* Actor = SpawnPooledActor(Class, ParkingTransform);
+		if (Actor) {
+
+			ReleaseActor(Actor);
+		}
+	}
+}
+
+AActor* UActorPoolSubsystem::AcquireActor(TSubclassOf<AActor> Class, const FTransform& Transform)
+{
+	if (!Class) return nullptr;
+
+	FActorPool* Pool = Pools.Find(Class);
+	while (Pool && Pool->FreeActors.Num() > 0) {
+
+		AActor* Actor = Pool->FreeActors.Pop(false);
+		PooledActors.Remove(Actor);
+		DEC_DWORD_STAT(STAT_PooledActors);
+
+		// Something outside the pool may have destroyed it in the meantime
+		if (IsValid(Actor)) {
+
+			INC_DWORD_STAT(STAT_PoolHits);
+			Activate(Actor, Transform);
+			return Actor;
+		}
+	}
+
+	INC_DWORD_STAT(STAT_PoolMisses);
+	AActor* Actor = SpawnPooledActor(Class, Transform);
+	if (Actor) {
+
+		IPoolableActor* Poolable = Cast<IPoolableActor>(Actor);
+		if (Poolable) {
+
+			Poolable->OnAcquiredFromPool();
+		}
+	}
+	return Actor;
+}
+
+void UActorPoolSubsystem::ReleaseActor(AActor* Actor)
+{
+	if (!IsValid(Actor) || PooledActors.Contains(Actor)) return;
+
+	OnActorReleased.Broadcast(Actor);
+
+	FActorPool& Pool = Pools.FindOrAdd(Actor->GetClass());
+	if (Pool.FreeActors.Num() >= MaxPooledPerClass) {
+
+		// Still gets to clean up its gameplay state, Destroy() alone leaves tokens and registrations behind
+		IPoolableActor* Poolable = Cast<IPoolableActor>(Actor);
+		if (Poolable) {
+
+			Poolable->OnReturnedToPool();
+		}
+		Actor->Destroy();
+		return;
+	}
+
+	Deactivate(Actor);
+
+	Pool.FreeActors.Add(Actor);
+	PooledActors.Add(Actor);
+	INC_DWORD_STAT(STAT_PooledActors);
+}
+
+void UActorPoolSubsystem::ParkActor(AActor* Actor)
+{
+	if (!IsValid(Actor) || PooledActors.Contains(Actor)) return;
+
+	Deactivate(Actor);
+}
+
+void UActorPoolSubsystem::UnparkActor(AActor* Actor, const FTransform& Transform)
+{
+	if (!IsValid(Actor) || PooledActors.Contains(Actor)) return;
+
+	Activate(Actor, Transform);
+}
+
+int32 UActorPoolSubsystem::GetNumFree(TSubclassOf<AActor> Class) const
+{
+	const FActorPool* Pool = Pools.Find(Class);
+	return Pool ? Pool->FreeActors.Num() : 0;
+}
+
+void UActorPoolSubsystem::Trim(TSubclassOf<AActor> Class, int32 MaxFree)
+{
+	FActorPool* Pool = Pools.Find(Class);
+	if (!Pool) return;
+
+	while (Pool->FreeActors.Num() > FMath::Max(MaxFree, 0)) {
+
+		AActor* Actor = Pool->FreeActors.Pop(false);
+		PooledActors.Remove(Actor);
+		DEC_DWORD_STAT(STAT_PooledActors);
+
+		// Already returned to the pool, so there is no gameplay state left to clean up
+		if (IsValid(Actor)) {
+
+			Actor->Destroy();
+		}
+	}
+}
+
+void UActorPoolSubsystem::ReleaseOrDestroy(AActor* Actor)
+{
+	if (!Actor) return;
+
+	UWorld* World = Actor->GetWorld();
+	UActorPoolSubsystem* ActorPool = World ? World->GetSubsystem<UActorPoolSubsystem>() : nullptr;
+
+	if (ActorPool) {
+
+		ActorPool->ReleaseActor(Actor);
+	}
+	else {
+
+		Actor->Destroy();
+	}
+}
+
+AActor* UActorPoolSubsystem::SpawnPooledActor(UClass* Class, const FTransform& Transform)
+{
+	UWorld* World = GetWorld();
+	if (!World) return nullptr;
+
+	FActorSpawnParameters SpawnParams;
+	SpawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AdjustIfPossibleButAlwaysSpawn;
+
+	return World->SpawnActor<AActor>(Class, Transform, SpawnParams);
+}
+
+void UActorPoolSubsystem::Activate(AActor* Actor, const FTransform& Transform)
+{
+	// Move while collision is still off so nothing overlaps on the way
+	Actor->SetActorTransform(Transform, false, nullptr, ETeleportType::ResetPhysics);
+
+	Actor->SetActorHiddenInGame(false);
+	Actor->SetActorEnableCollision(true);
+	Actor->SetActorTickEnabled(Actor->PrimaryActorTick.bStartWithTickEnabled);
+
+	for (UActorComponent* Component : Actor->GetComponents()) {
+
+		Component->SetComponentTickEnabled(Component->PrimaryComponentTick.bStartWithTickEnabled);
+	}
+
+	IPoolableActor* Poolable = Cast<IPoolableActor>(Actor);
+	if (Poolable) {
+
+		Poolable->OnAcquiredFromPool();
+	}
+}
+
+void UActorPoolSubsystem::Deactivate(AActor* Actor)
+{
+	IPoolableActor* Poolable = Cast<IPoolableActor>(Actor);
+	if (Poolable) {
+
+		Poolable->OnReturnedToPool();
+	}
+
+	Actor->GetWorldTimerManager().ClearAllTimersForObject(Actor);
+
+	UCombatSchedulerSubsystem* Scheduler = UCombatSchedulerSubsystem::Get(Actor);
+	if (Scheduler) {
+
+		Scheduler->ClearAllTimersForObject(Actor);
+	}
+
+	Actor->SetActorHiddenInGame(true);
+	Actor->SetActorEnableCollision(false);
+	Actor->SetActorTickEnabled(false);
+
+	for (UActorComponent* Component : Actor->GetComponents()) {
+
+		Component->SetComponentTickEnabled(false);
+	}
+}
+
+// ActionRPG.Pool.Benchmark [Count] [Class]
+// Spawns and retires Count actors through SpawnActor/Destroy and then through the pool, and logs both timings.
+// Pawns get their AI controller in both passes, and the pool is trimmed back to its previous size afterwards.
+static FAutoConsoleCommandWithWorldAndArgs PoolBenchmarkCommand(
+	TEXT("ActionRPG.Pool.Benchmark"),
+	TEXT("Compares spawn throughput of pooled and unpooled actors. Usage: ActionRPG.Pool.Benchmark [Count] [Class]"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateStatic([](const TArray<FString>& Args, UWorld* World)
+	{
+		UActorPoolSubsystem* ActorPool = World ? World->GetSubsystem<UActorPoolSubsystem>() : nullptr;
+		if (!ActorPool) return;
+
+		const int32 Count = Args.Num() > 0 ? FCString::Atoi(*Args[0]) : 200;
+
+		UClass* Class = AEnemy::StaticClass();
+		if (Args.Num() > 1) {
+
+			UClass* Found = LoadClass<AActor>(nullptr, *Args[1]);
+			if (Found) { Class = Found; }
+		}
+
+		// Make room for the whole batch so the pooled pass never falls back to spawning
+		const int32 PreviousMaxPooled = ActorPool->MaxPooledPerClass;
+		const int32 PreviousFree = ActorPool->GetNumFree(Class);
+		ActorPool->MaxPooledPerClass = FMath::Max(PreviousMaxPooled, Count);
+
+		const FTransform Transform(FVector(0.f, 0.f, -100000.f));
+		TArray<AActor*> Actors;
+		Actors.Reserve(Count);
+
+		// Unpooled: the path ASpawnVolume and Destroy() used to take
+		double Start = FPlatformTime::Seconds();
+		for (int32 i = 0; i < Count; ++i) {
+
+			FActorSpawnParameters SpawnParams;
+			SpawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+			AActor* Actor = World->SpawnActor<AActor>(Class, Transform, SpawnParams);
+
+			// The pooled pass gets one from OnAcquiredFromPool, and destroying the pawn takes it down again
+			APawn* Pawn = Cast<APawn>(Actor);
+			if (Pawn) {
+
+				Pawn->SpawnDefaultController();
+			}
+			Actors.Add(Actor);
+		}
+		for (AActor* Actor : Actors) {
+
+			if (Actor) { Actor->Destroy(); }
+		}
+		const double UnpooledSeconds = FPlatformTime::Seconds() - Start;
+
+		Start = FPlatformTime::Seconds();
+		CollectGarbage(GARBAGE_COLLECTION_KEEPFLAGS);
+		const double GCSeconds = FPlatformTime::Seconds() - Start;
+
+		// Pooled: warm once, then measure a full acquire/release cycle
+		ActorPool->Prewarm(Class, Count);
+		Actors.Reset();
+
+		Start = FPlatformTime::Seconds();
+		for (int32 i = 0; i < Count; ++i) {
+
+			Actors.Add(ActorPool->AcquireActor(Class, Transform));
+		}
+		for (AActor* Actor : Actors) {
+
+			ActorPool->ReleaseActor(Actor);
+		}
+		const double PooledSeconds = FPlatformTime::Seconds() - Start;
+
+		// Don't leave the whole batch parked
+		ActorPool->MaxPooledPerClass = PreviousMaxPooled;
+		ActorPool->Trim(Class, PreviousFree);
+
+		UE_LOG(LogActionRPG, Log, TEXT("Pool benchmark %s x%d: unpooled %.2f ms (+%.2f ms GC), pooled %.2f ms"),
+			*Class->GetName(), Count, UnpooledSeconds * 1000.0, GCSeconds * 1000.0, PooledSeconds * 1000.0);
+	}));
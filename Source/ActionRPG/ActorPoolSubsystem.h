@@ -0,0 +1,92 @@
+// Copyright by Hakan Akkurt
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "ActorPoolSubsystem.generated.h"
+
+USTRUCT()
+struct FActorPool
+{
+	GENERATED_BODY()
+
+	UPROPERTY()
+	TArray<AActor*> FreeActors;
+};
+
+/**
+ * Keeps deactivated actors around per class so enemies, pickups and explosives
+ * can be handed out again instead of going through SpawnActor and Destroy.
+ */
+UCLASS(Config = Game)
+class ACTIONRPG_API UActorPoolSubsystem : public UWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+
+	UActorPoolSubsystem();
+
+	// Released actors beyond this many per class are destroyed instead of kept
+	UPROPERTY(Config, EditAnywhere, BlueprintReadOnly, Category = "Pool")
+	int32 MaxPooledPerClass;
+
+	// Spawns Count inactive instances of Class up front
+	UFUNCTION(BlueprintCallable, Category = "Pool")
+	void Prewarm(TSubclassOf<AActor> Class, int32 Count);
+
+	// Returns a pooled instance moved to Transform, spawning one if the pool is empty
+	UFUNCTION(BlueprintCallable, Category = "Pool")
+	AActor* AcquireActor(TSubclassOf<AActor> Class, const FTransform& Transform);
+
+	template<class T>
+	T* AcquireActor(TSubclassOf<AActor> Class, const FTransform& Transform)
+	{
+		return Cast<T>(AcquireActor(Class, Transform));
+	}
+
+	// Deactivates Actor and keeps it for the next AcquireActor of its class
+	UFUNCTION(BlueprintCallable, Category = "Pool")
+	void ReleaseActor(AActor* Actor);
+
+	// Deactivates Actor like a released one but keeps it out of the pool, for owners that want this very instance back
+	void ParkActor(AActor* Actor);
+
+	// Brings an actor parked with ParkActor back at Transform
+	void UnparkActor(AActor* Actor, const FTransform& Transform);
+
+	UFUNCTION(BlueprintPure, Category = "Pool")
+	int32 GetNumFree(TSubclassOf<AActor> Class) const;
+
+	// Destroys parked instances of Class until at most MaxFree are left
+	UFUNCTION(BlueprintCallable, Category = "Pool")
+	void Trim(TSubclassOf<AActor> Class, int32 MaxFree);
+
+	// Hands Actor back to its world's pool, or destroys it when there is none
+	static void ReleaseOrDestroy(AActor* Actor);
+
+	DECLARE_MULTICAST_DELEGATE_OneParam(FOnActorReleased, AActor*);
+
+	// Broadcast before a released actor is parked, or destroyed because its pool is full
+	FOnActorReleased OnActorReleased;
+
+	virtual bool ShouldCreateSubsystem(UObject* Outer) const override;
+
+	virtual void Deinitialize() override;
+
+private:
+
+	AActor* SpawnPooledActor(UClass* Class, const FTransform& Transform);
+
+	void Activate(AActor* Actor, const FTransform& Transform);
+
+	void Deactivate(AActor* Actor);
+
+	UPROPERTY()
+	TMap<UClass*, FActorPool> Pools;
+
+	// Every actor currently parked in a pool, guards against double release
+	UPROPERTY()
+	TSet<AActor*> PooledActors;
+};
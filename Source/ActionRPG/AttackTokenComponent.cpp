@@ -0,0 +1,77 @@
+// Copyright by Hakan Akkurt
+
+
+#include "AttackTokenComponent.h"
+#include "ActionRPG.h"
+#include "Enemy.h"
+#include "Main.h"
+
+DECLARE_DWORD_COUNTER_STAT(TEXT("Attack Tokens Granted"), STAT_AttackTokensGranted, STATGROUP_ActionRPG);
+
+UAttackTokenComponent::UAttackTokenComponent()
+{
+	PrimaryComponentTick.bCanEverTick = false;
+
+	MaxAttackers = 2;
+	QueueHead = 0;
+}
+
+bool UAttackTokenComponent::RequestToken(AEnemy* Enemy)
+{
+	if (!Enemy) return false;
+	if (Holders.Contains(Enemy)) return true;
+
+	if (Holders.Num() < MaxAttackers && Waiting.Num() == 0) {
+
+		Holders.Add(Enemy);
+		INC_DWORD_STAT(STAT_AttackTokensGranted);
+		return true;
+	}
+
+	bool bAlreadyWaiting = false;
+	Waiting.Add(Enemy, &bAlreadyWaiting);
+	if (!bAlreadyWaiting) {
+
+		// Drop the consumed front of the queue once it makes up most of the array
+		if (QueueHead > 32 && QueueHead * 2 > WaitQueue.Num()) {
+
+			WaitQueue.RemoveAt(0, QueueHead, false);
+			QueueHead = 0;
+		}
+		WaitQueue.Add(Enemy);
+	}
+	return false;
+}
+
+void UAttackTokenComponent::ReleaseToken(AEnemy* Enemy)
+{
+	if (Holders.Remove(Enemy) > 0) {
+
+		GrantWaiting();
+	}
+	else {
+
+		// Its queue entry is skipped when reached
+		Waiting.Remove(Enemy);
+	}
+}
+
+void UAttackTokenComponent::GrantWaiting()
+{
+	while (Holders.Num() < MaxAttackers && QueueHead < WaitQueue.Num()) {
+
+		AEnemy* Enemy = WaitQueue[QueueHead++].Get();
+		if (!Enemy || Waiting.Remove(Enemy) == 0) continue;
+
+		Holders.Add(Enemy);
+		INC_DWORD_STAT(STAT_AttackTokensGranted);
+
+		Enemy->OnAttackTokenGranted(Cast<AMain>(GetOwner()));
+	}
+
+	if (QueueHead == WaitQueue.Num()) {
+
+		WaitQueue.Reset();
+		QueueHead = 0;
+	}
+}
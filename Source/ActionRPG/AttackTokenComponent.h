@@ -0,0 +1,54 @@
+// Copyright by Hakan Akkurt
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Components/ActorComponent.h"
+#include "AttackTokenComponent.generated.h"
+
+/**
+ * Hands out a fixed number of melee attack slots on the player. Enemies in combat range ask for a
+ * token before winding up an attack and give it back when the swing ends; the rest queue up and
+ * are granted one in the order they asked. Acquire and release are O(1).
+ */
+UCLASS(ClassGroup = (Combat), meta = (BlueprintSpawnableComponent))
+class ACTIONRPG_API UAttackTokenComponent : public UActorComponent
+{
+	GENERATED_BODY()
+
+public:
+
+	UAttackTokenComponent();
+
+	// How many enemies may attack at the same time
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Combat")
+	int32 MaxAttackers;
+
+	// True when Enemy holds a token now, otherwise it is queued and gets OnAttackTokenGranted later
+	bool RequestToken(class AEnemy* Enemy);
+
+	// Gives back a held token or leaves the queue
+	void ReleaseToken(AEnemy* Enemy);
+
+	FORCEINLINE bool HasToken(AEnemy* Enemy) const { return Holders.Contains(Enemy); }
+
+	UFUNCTION(BlueprintPure, Category = "Combat")
+	int32 GetNumAttackers() const { return Holders.Num(); }
+
+	UFUNCTION(BlueprintPure, Category = "Combat")
+	int32 GetNumWaiting() const { return Waiting.Num(); }
+
+private:
+
+	void GrantWaiting();
+
+	UPROPERTY()
+	TSet<AEnemy*> Holders;
+
+	// Enemies currently waiting, WaitQueue may still list ones that have left or been destroyed since
+	UPROPERTY()
+	TSet<AEnemy*> Waiting;
+
+	TArray<TWeakObjectPtr<AEnemy>> WaitQueue;
+	int32 QueueHead;
+};
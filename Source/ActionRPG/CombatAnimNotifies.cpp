@@ -0,0 +1,107 @@
+// Copyright by Hakan Akkurt
+
+
+#include "CombatAnimNotifies.h"
+#include "Main.h"
+#include "Enemy.h"
+#include "Weapon.h"
+#include "MainAnimInstance.h"
+#include "EnemyAnimInstance.h"
+#include "Components/SkeletalMeshComponent.h"
+
+namespace
+{
+	// Anim instances not built on ours, and editor previews, fall back to the owner or nothing
+	AMain* GetNotifyMain(USkeletalMeshComponent* MeshComp)
+	{
+		UMainAnimInstance* Instance = Cast<UMainAnimInstance>(MeshComp->GetAnimInstance());
+		return Instance && Instance->Main ? Instance->Main : Cast<AMain>(MeshComp->GetOwner());
+	}
+
+	AEnemy* GetNotifyEnemy(USkeletalMeshComponent* MeshComp)
+	{
+		UEnemyAnimInstance* Instance = Cast<UEnemyAnimInstance>(MeshComp->GetAnimInstance());
+		return Instance && Instance->Enemy ? Instance->Enemy : Cast<AEnemy>(MeshComp->GetOwner());
+	}
+}
+
+void UAnimNotifyState_HitWindow::NotifyBegin(USkeletalMeshComponent* MeshComp, UAnimSequenceBase* Animation, float TotalDuration)
+{
+	if (!MeshComp) return;
+
+	AEnemy* Enemy = GetNotifyEnemy(MeshComp);
+	if (Enemy) {
+
+		Enemy->ActivateCollision();
+		return;
+	}
+
+	AMain* Main = GetNotifyMain(MeshComp);
+	if (Main && Main->EquippedWeapon) {
+
+		Main->EquippedWeapon->ActivateCollision();
+	}
+}
+
+void UAnimNotifyState_HitWindow::NotifyEnd(USkeletalMeshComponent* MeshComp, UAnimSequenceBase* Animation)
+{
+	if (!MeshComp) return;
+
+	AEnemy* Enemy = GetNotifyEnemy(MeshComp);
+	if (Enemy) {
+
+		Enemy->DeactivateCollision();
+		return;
+	}
+
+	AMain* Main = GetNotifyMain(MeshComp);
+	if (Main && Main->EquippedWeapon) {
+
+		Main->EquippedWeapon->DeactivateCollision();
+	}
+}
+
+void UAnimNotify_SwingSound::Notify(USkeletalMeshComponent* MeshComp, UAnimSequenceBase* Animation)
+{
+	AMain* Main = MeshComp ? GetNotifyMain(MeshComp) : nullptr;
+	if (Main) {
+
+		Main->PlaySwingSound();
+	}
+}
+
+void UAnimNotify_AttackEnd::Notify(USkeletalMeshComponent* MeshComp, UAnimSequenceBase* Animation)
+{
+	if (!MeshComp) return;
+
+	AEnemy* Enemy = GetNotifyEnemy(MeshComp);
+	if (Enemy) {
+
+		Enemy->AttackEnd();
+		return;
+	}
+
+	AMain* Main = GetNotifyMain(MeshComp);
+	if (Main) {
+
+		Main->AttackEnd();
+	}
+}
+
+void UAnimNotify_DeathEnd::Notify(USkeletalMeshComponent* MeshComp, UAnimSequenceBase* Animation)
+{
+	if (!MeshComp) return;
+
+	AEnemy* Enemy = GetNotifyEnemy(MeshComp);
+	if (Enemy) {
+
+		Enemy->DeathEnd();
+		return;
+	}
+
+	AMain* Main = GetNotifyMain(MeshComp);
+	if (Main) {
+
+		Main->DeathEnd();
+	}
+}
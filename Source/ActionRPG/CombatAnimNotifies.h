@@ -0,0 +1,64 @@
+// Copyright by Hakan Akkurt
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Animation/AnimNotifies/AnimNotify.h"
+#include "Animation/AnimNotifies/AnimNotifyState.h"
+#include "CombatAnimNotifies.generated.h"
+
+// Notify objects are shared by every mesh playing the animation, so none of these keep per-character
+// state. The owning AMain or AEnemy comes from the pointer its anim instance cached at initialization,
+// and notifies are dispatched on the game thread even when the anim graph runs on a worker.
+
+// Opens the weapon's hit window for the duration of the notify, closes it when the montage is left early too
+UCLASS(meta = (DisplayName = "Hit Window"))
+class ACTIONRPG_API UAnimNotifyState_HitWindow : public UAnimNotifyState
+{
+	GENERATED_BODY()
+
+public:
+
+	virtual void NotifyBegin(USkeletalMeshComponent* MeshComp, UAnimSequenceBase* Animation, float TotalDuration) override;
+
+	virtual void NotifyEnd(USkeletalMeshComponent* MeshComp, UAnimSequenceBase* Animation) override;
+
+	virtual FString GetNotifyName_Implementation() const override { return TEXT("Hit Window"); }
+};
+
+// The player's weapon swing sound, enemies play theirs when the hit window opens
+UCLASS(meta = (DisplayName = "Swing Sound"))
+class ACTIONRPG_API UAnimNotify_SwingSound : public UAnimNotify
+{
+	GENERATED_BODY()
+
+public:
+
+	virtual void Notify(USkeletalMeshComponent* MeshComp, UAnimSequenceBase* Animation) override;
+
+	virtual FString GetNotifyName_Implementation() const override { return TEXT("Swing Sound"); }
+};
+
+UCLASS(meta = (DisplayName = "Attack End"))
+class ACTIONRPG_API UAnimNotify_AttackEnd : public UAnimNotify
+{
+	GENERATED_BODY()
+
+public:
+
+	virtual void Notify(USkeletalMeshComponent* MeshComp, UAnimSequenceBase* Animation) override;
+
+	virtual FString GetNotifyName_Implementation() const override { return TEXT("Attack End"); }
+};
+
+UCLASS(meta = (DisplayName = "Death End"))
+class ACTIONRPG_API UAnimNotify_DeathEnd : public UAnimNotify
+{
+	GENERATED_BODY()
+
+public:
+
+	virtual void Notify(USkeletalMeshComponent* MeshComp, UAnimSequenceBase* Animation) override;
+
+	virtual FString GetNotifyName_Implementation() const override { return TEXT("Death End"); }
+};
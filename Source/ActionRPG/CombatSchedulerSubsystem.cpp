@@ -0,0 +1,308 @@
+// Copyright by Hakan Akkurt
+
+
+#include "CombatSchedulerSubsystem.h"
+#include "ActionRPG.h"
+#include "Engine/World.h"
+#include "Engine/Engine.h"
+
+DECLARE_CYCLE_STAT(TEXT("Scheduler Dispatch"), STAT_SchedulerDispatch, STATGROUP_ActionRPG);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Scheduler Fired"), STAT_SchedulerFired, STATGROUP_ActionRPG);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Scheduler Cancelled"), STAT_SchedulerCancelled, STATGROUP_ActionRPG);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Scheduler Pending"), STAT_SchedulerPending, STATGROUP_ActionRPG);
+
+UCombatSchedulerSubsystem::UCombatSchedulerSubsystem()
+{
+	TickResolution = 1.f / 60.f;
+
+	FreeList = INDEX_NONE;
+	CurrentTick = 0;
+	Accumulator = 0.f;
+	NumScheduled = 0;
+	TotalFired = 0;
+	TotalCancelled = 0;
+
+	for (int32 Level = 0; Level < NumLevels; ++Level) {
+
+		for (int32 Slot = 0; Slot < NumSlots; ++Slot) {
+
+			Slots[Level][Slot] = INDEX_NONE;
+		}
+	}
+}
+
+UCombatSchedulerSubsystem* UCombatSchedulerSubsystem::Get(const UObject* WorldContextObject)
+{
+	UWorld* World = GEngine->GetWorldFromContextObject(WorldContextObject, EGetWorldErrorMode::ReturnNull);
+	return World ? World->GetSubsystem<UCombatSchedulerSubsystem>() : nullptr;
+}
+
+bool UCombatSchedulerSubsystem::ShouldCreateSubsystem(UObject* Outer) const
+{
+	UWorld* World = Cast<UWorld>(Outer);
+	return World && World->IsGameWorld();
+}
+
+void UCombatSchedulerSubsystem::Deinitialize()
+{
+	SET_DWORD_STAT(STAT_SchedulerPending, 0);
+
+	Nodes.Empty();
+	DueNodes.Empty();
+	FreeList = INDEX_NONE;
+	NumScheduled = 0;
+
+	Super::Deinitialize();
+}
+
+void UCombatSchedulerSubsystem::SetTimer(FCombatTimerHandle& Handle, float Delay, FSimpleDelegate Callback)
+{
+	ClearTimer(Handle);
+
+	const int32 NodeIndex = AllocateNode();
+	FTimerNode& Node = Nodes[NodeIndex];
+
+	// Never due on the tick we are already past
+	const uint64 DelayTicks = FMath::Max<uint64>(1, (uint64)FMath::CeilToInt(FMath::Max(Delay, 0.f) / TickResolution));
+
+	Node.Callback = MoveTemp(Callback);
+	Node.ExpireTick = CurrentTick + DelayTicks;
+	Link(NodeIndex);
+
+	++NumScheduled;
+	INC_DWORD_STAT(STAT_SchedulerPending);
+
+	Handle.Index = NodeIndex;
+	Handle.Serial = Node.Serial;
+}
+
+void UCombatSchedulerSubsystem::ClearTimer(FCombatTimerHandle& Handle)
+{
+	if (IsTimerActive(Handle)) {
+
+		Cancel(Handle.Index);
+	}
+	Handle.Invalidate();
+}
+
+void UCombatSchedulerSubsystem::ClearAllTimersForObject(const UObject* Object)
+{
+	if (!Object) return;
+
+	for (int32 NodeIndex = 0; NodeIndex < Nodes.Num(); ++NodeIndex) {
+
+		const FTimerNode& Node = Nodes[NodeIndex];
+		if (Node.State != ENodeState::Free && !Node.bCancelled && Node.Callback.IsBoundToObject(Object)) {
+
+			Cancel(NodeIndex);
+		}
+	}
+}
+
+bool UCombatSchedulerSubsystem::IsTimerActive(const FCombatTimerHandle& Handle) const
+{
+	if (!Nodes.IsValidIndex(Handle.Index)) return false;
+
+	const FTimerNode& Node = Nodes[Handle.Index];
+	return Node.Serial == Handle.Serial && (Node.State == ENodeState::Wheel || (Node.State == ENodeState::Due && !Node.bCancelled));
+}
+
+void UCombatSchedulerSubsystem::Cancel(int32 NodeIndex)
+{
+	FTimerNode& Node = Nodes[NodeIndex];
+
+	if (Node.State == ENodeState::Wheel) {
+
+		Unlink(NodeIndex);
+		FreeNode(NodeIndex);
+	}
+	else if (Node.State == ENodeState::Due && !Node.bCancelled) {
+
+		// Already in this frame's batch, dispatch skips it and frees the node
+		Node.bCancelled = true;
+	}
+	else {
+
+		return;
+	}
+
+	--NumScheduled;
+	++TotalCancelled;
+	INC_DWORD_STAT(STAT_SchedulerCancelled);
+	DEC_DWORD_STAT(STAT_SchedulerPending);
+}
+
+int32 UCombatSchedulerSubsystem::AllocateNode()
+{
+	if (FreeList != INDEX_NONE) {
+
+		const int32 NodeIndex = FreeList;
+		FreeList = Nodes[NodeIndex].Next;
+		Nodes[NodeIndex].Next = INDEX_NONE;
+		return NodeIndex;
+	}
+	return Nodes.AddDefaulted();
+}
+
+void UCombatSchedulerSubsystem::FreeNode(int32 NodeIndex)
+{
+	FTimerNode& Node = Nodes[NodeIndex];
+
+	Node.Callback.Unbind();
+	Node.State = ENodeState::Free;
+	Node.bCancelled = false;
+	Node.Prev = INDEX_NONE;
+	Node.Next = FreeList;
+
+	// Stale handles to this node stop matching
+	++Node.Serial;
+
+	FreeList = NodeIndex;
+}
+
+void UCombatSchedulerSubsystem::Link(int32 NodeIndex)
+{
+	FTimerNode& Node = Nodes[NodeIndex];
+
+	const uint64 Delta = Node.ExpireTick > CurrentTick ? Node.ExpireTick - CurrentTick : 1;
+
+	int32 Level = 0;
+	while (Level < NumLevels - 1 && Delta >= (1ull << (SlotBits * (Level + 1)))) {
+
+		++Level;
+	}
+
+	// Delays beyond the top level's span wait in its last reachable slot and cascade again
+	const uint64 Expire = Level == NumLevels - 1
+		? FMath::Min(Node.ExpireTick, CurrentTick + (1ull << (SlotBits * NumLevels)) - 1)
+		: Node.ExpireTick;
+
+	const int32 Slot = (Expire >> (SlotBits * Level)) & SlotMask;
+
+	Node.Level = Level;
+	Node.Slot = Slot;
+	Node.State = ENodeState::Wheel;
+	Node.Prev = INDEX_NONE;
+	Node.Next = Slots[Level][Slot];
+
+	if (Node.Next != INDEX_NONE) {
+
+		Nodes[Node.Next].Prev = NodeIndex;
+	}
+	Slots[Level][Slot] = NodeIndex;
+}
+
+void UCombatSchedulerSubsystem::Unlink(int32 NodeIndex)
+{
+	FTimerNode& Node = Nodes[NodeIndex];
+
+	if (Node.Prev != INDEX_NONE) {
+
+		Nodes[Node.Prev].Next = Node.Next;
+	}
+	else {
+
+		Slots[Node.Level][Node.Slot] = Node.Next;
+	}
+
+	if (Node.Next != INDEX_NONE) {
+
+		Nodes[Node.Next].Prev = Node.Prev;
+	}
+
+	Node.Prev = INDEX_NONE;
+	Node.Next = INDEX_NONE;
+}
+
+int32 UCombatSchedulerSubsystem::DetachSlot(int32 Level, int32 Slot)
+{
+	const int32 Head = Slots[Level][Slot];
+	Slots[Level][Slot] = INDEX_NONE;
+	return Head;
+}
+
+void UCombatSchedulerSubsystem::AdvanceOneTick()
+{
+	++CurrentTick;
+
+	// Find the highest level whose slot boundary we just crossed
+	int32 TopLevel = 0;
+	while (TopLevel < NumLevels - 1 && (CurrentTick & ((1ull << (SlotBits * (TopLevel + 1))) - 1)) == 0) {
+
+		++TopLevel;
+	}
+
+	// Cascade from the top down so nodes moved out of a higher level land in slots not yet emptied
+	for (int32 Level = TopLevel; Level > 0; --Level) {
+
+		int32 NodeIndex = DetachSlot(Level, (CurrentTick >> (SlotBits * Level)) & SlotMask);
+		while (NodeIndex != INDEX_NONE) {
+
+			const int32 Next = Nodes[NodeIndex].Next;
+			Link(NodeIndex);
+			NodeIndex = Next;
+		}
+	}
+
+	int32 NodeIndex = DetachSlot(0, CurrentTick & SlotMask);
+	while (NodeIndex != INDEX_NONE) {
+
+		FTimerNode& Node = Nodes[NodeIndex];
+		const int32 Next = Node.Next;
+
+		Node.State = ENodeState::Due;
+		Node.Prev = INDEX_NONE;
+		Node.Next = INDEX_NONE;
+		DueNodes.Add(NodeIndex);
+
+		NodeIndex = Next;
+	}
+}
+
+bool UCombatSchedulerSubsystem::IsTickable() const
+{
+	return !IsTemplate() && NumScheduled > 0;
+}
+
+ETickableTickType UCombatSchedulerSubsystem::GetTickableTickType() const
+{
+	return IsTemplate() ? ETickableTickType::Never : ETickableTickType::Conditional;
+}
+
+TStatId UCombatSchedulerSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UCombatSchedulerSubsystem, STATGROUP_Tickables);
+}
+
+void UCombatSchedulerSubsystem::Tick(float DeltaTime)
+{
+	SCOPE_CYCLE_COUNTER(STAT_SchedulerDispatch);
+
+	Accumulator += DeltaTime;
+	while (Accumulator >= TickResolution) {
+
+		Accumulator -= TickResolution;
+		AdvanceOneTick();
+	}
+
+	// Callbacks may set or clear timers, so nodes are only read by index and freed before running
+	for (int32 i = 0; i < DueNodes.Num(); ++i) {
+
+		const int32 NodeIndex = DueNodes[i];
+		FSimpleDelegate Callback = MoveTemp(Nodes[NodeIndex].Callback);
+		const bool bCancelled = Nodes[NodeIndex].bCancelled;
+
+		FreeNode(NodeIndex);
+
+		if (!bCancelled) {
+
+			--NumScheduled;
+			++TotalFired;
+			INC_DWORD_STAT(STAT_SchedulerFired);
+			DEC_DWORD_STAT(STAT_SchedulerPending);
+
+			Callback.ExecuteIfBound();
+		}
+	}
+	DueNodes.Reset();
+}
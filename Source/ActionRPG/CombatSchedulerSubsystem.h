@@ -0,0 +1,138 @@
+// Copyright by Hakan Akkurt
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "Tickable.h"
+#include "CombatSchedulerSubsystem.generated.h"
+
+// Identifies one scheduled callback, goes stale once it fires or is cleared
+struct FCombatTimerHandle
+{
+	FCombatTimerHandle() : Index(INDEX_NONE), Serial(0) {}
+
+	bool IsValid() const { return Index != INDEX_NONE; }
+
+	void Invalidate() { Index = INDEX_NONE; }
+
+private:
+
+	friend class UCombatSchedulerSubsystem;
+
+	int32 Index;
+	uint32 Serial;
+};
+
+/**
+ * Gameplay timers on a hierarchical timing wheel. Setting and clearing a timer is O(1) and everything
+ * that comes due in a frame is dispatched in one batch, which keeps attack, death, switch and platform
+ * timers out of FTimerManager's heap. Timers fire on the first wheel tick at or after their delay,
+ * so they are up to one TickResolution late.
+ */
+UCLASS(Config = Game)
+class ACTIONRPG_API UCombatSchedulerSubsystem : public UWorldSubsystem, public FTickableGameObject
+{
+	GENERATED_BODY()
+
+public:
+
+	UCombatSchedulerSubsystem();
+
+	// Seconds per wheel tick
+	UPROPERTY(Config, EditAnywhere, BlueprintReadOnly, Category = "Scheduler")
+	float TickResolution;
+
+	static UCombatSchedulerSubsystem* Get(const UObject* WorldContextObject);
+
+	// Same contract as FTimerManager::SetTimer, an already running Handle is cleared first
+	void SetTimer(FCombatTimerHandle& Handle, float Delay, FSimpleDelegate Callback);
+
+	template<class UserClass>
+	void SetTimer(FCombatTimerHandle& Handle, UserClass* Object, void (UserClass::*Method)(), float Delay)
+	{
+		SetTimer(Handle, Delay, FSimpleDelegate::CreateUObject(Object, Method));
+	}
+
+	void ClearTimer(FCombatTimerHandle& Handle);
+
+	// Clears every timer bound to Object, the pool uses this when parking actors
+	void ClearAllTimersForObject(const UObject* Object);
+
+	bool IsTimerActive(const FCombatTimerHandle& Handle) const;
+
+	FORCEINLINE uint64 GetTotalFired() const { return TotalFired; }
+	FORCEINLINE uint64 GetTotalCancelled() const { return TotalCancelled; }
+
+	virtual bool ShouldCreateSubsystem(UObject* Outer) const override;
+
+	virtual void Deinitialize() override;
+
+	// FTickableGameObject
+	virtual void Tick(float DeltaTime) override;
+	virtual bool IsTickable() const override;
+	virtual ETickableTickType GetTickableTickType() const override;
+	virtual TStatId GetStatId() const override;
+	virtual UWorld* GetTickableGameObjectWorld() const override { return GetWorld(); }
+
+private:
+
+	static const int32 SlotBits = 6;
+	static const int32 NumSlots = 1 << SlotBits;
+	static const int32 SlotMask = NumSlots - 1;
+	static const int32 NumLevels = 4;
+
+	// Where a node currently lives
+	enum class ENodeState : uint8
+	{
+		Free,
+		Wheel,
+		Due
+	};
+
+	struct FTimerNode
+	{
+		FSimpleDelegate Callback;
+		uint64 ExpireTick = 0;
+		int32 Prev = INDEX_NONE;
+		int32 Next = INDEX_NONE;
+		uint32 Serial = 0;
+		uint8 Level = 0;
+		uint8 Slot = 0;
+		ENodeState State = ENodeState::Free;
+
+		// Cleared after it came due but before this frame's batch ran
+		bool bCancelled = false;
+	};
+
+	int32 AllocateNode();
+
+	void FreeNode(int32 NodeIndex);
+
+	// Puts a node into the slot matching its expiry relative to CurrentTick
+	void Link(int32 NodeIndex);
+
+	void Unlink(int32 NodeIndex);
+
+	// Empties a slot and returns the head of the list it held
+	int32 DetachSlot(int32 Level, int32 Slot);
+
+	void AdvanceOneTick();
+
+	void Cancel(int32 NodeIndex);
+
+	TArray<FTimerNode> Nodes;
+	int32 FreeList;
+
+	int32 Slots[NumLevels][NumSlots];
+
+	uint64 CurrentTick;
+	float Accumulator;
+	int32 NumScheduled;
+
+	// Nodes that came due this frame, dispatched together after the wheel has advanced
+	TArray<int32> DueNodes;
+
+	uint64 TotalFired;
+	uint64 TotalCancelled;
+};
@@ -0,0 +1,380 @@
+// Copyright by Hakan Akkurt
+
+
+#include "DormantRegionSubsystem.h"
+#include "ActionRPG.h"
+#include "Enemy.h"
+#include "Main.h"
+#include "Pickup.h"
+#include "Explosive.h"
+#include "FloatingPlatform.h"
+#include "FloorSwitch.h"
+#include "PoolableActor.h"
+#include "ActorPoolSubsystem.h"
+#include "EngineUtils.h"
+#include "Engine/World.h"
+#include "GameFramework/PlayerController.h"
+
+DECLARE_CYCLE_STAT(TEXT("Region Update"), STAT_RegionUpdate, STATGROUP_ActionRPG);
+DECLARE_CYCLE_STAT(TEXT("Region Transitions"), STAT_RegionTransitions, STATGROUP_ActionRPG);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Region Records"), STAT_RegionRecords, STATGROUP_ActionRPG);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Region Hydrated"), STAT_RegionHydrated, STATGROUP_ActionRPG);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Region Active Cells"), STAT_RegionActiveCells, STATGROUP_ActionRPG);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Region Pending Transitions"), STAT_RegionPending, STATGROUP_ActionRPG);
+
+UDormantRegionSubsystem::UDormantRegionSubsystem()
+{
+	bEnabled = true;
+	DormantClasses = { AEnemy::StaticClass(), APickup::StaticClass(), AExplosive::StaticClass(), AFloatingPlatform::StaticClass(), AFloorSwitch::StaticClass() };
+	CellSize = 4000.f;
+	ActivationRadius = 8000.f;
+	DeactivationRadius = 10000.f;
+	UpdateInterval = 0.25f;
+	MaxTransitionsPerFrame = 8;
+
+	NextTransition = 0;
+	bCaptured = false;
+	UpdateCountdown = 0.f;
+	NumHydrated = 0;
+}
+
+bool UDormantRegionSubsystem::ShouldCreateSubsystem(UObject* Outer) const
+{
+	UWorld* World = Cast<UWorld>(Outer);
+	return World && World->IsGameWorld();
+}
+
+void UDormantRegionSubsystem::Deinitialize()
+{
+	UActorPoolSubsystem* ActorPool = GetWorld()->GetSubsystem<UActorPoolSubsystem>();
+	if (ActorPool) {
+
+		ActorPool->OnActorReleased.Remove(ReleasedHandle);
+	}
+
+	Records.Empty();
+	Cells.Empty();
+	HydratedActors.Empty();
+	PendingTransitions.Empty();
+
+	Super::Deinitialize();
+}
+
+bool UDormantRegionSubsystem::IsTickable() const
+{
+	return !IsTemplate() && bEnabled;
+}
+
+ETickableTickType UDormantRegionSubsystem::GetTickableTickType() const
+{
+	return IsTemplate() ? ETickableTickType::Never : ETickableTickType::Conditional;
+}
+
+TStatId UDormantRegionSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UDormantRegionSubsystem, STATGROUP_Tickables);
+}
+
+void UDormantRegionSubsystem::Tick(float DeltaTime)
+{
+	if (CellSize <= 0.f) return;
+
+	// Not before the first frame, so every placed actor has had its BeginPlay
+	if (!bCaptured) {
+
+		bCaptured = true;
+		CaptureActors();
+	}
+
+	UpdateCountdown -= DeltaTime;
+	if (UpdateCountdown <= 0.f) {
+
+		UpdateCountdown = UpdateInterval;
+		UpdateCells();
+	}
+
+	ProcessTransitions();
+
+	SET_DWORD_STAT(STAT_RegionRecords, Records.Num());
+	SET_DWORD_STAT(STAT_RegionHydrated, NumHydrated);
+	SET_DWORD_STAT(STAT_RegionPending, PendingTransitions.Num() - NextTransition);
+}
+
+void UDormantRegionSubsystem::CaptureActors()
+{
+	UWorld* World = GetWorld();
+
+	UActorPoolSubsystem* ActorPool = World->GetSubsystem<UActorPoolSubsystem>();
+	if (ActorPool) {
+
+		ReleasedHandle = ActorPool->OnActorReleased.AddUObject(this, &UDormantRegionSubsystem::OnActorReleased);
+	}
+
+	for (TActorIterator<AActor> It(World); It; ++It) {
+
+		AActor* Actor = *It;
+
+		// Only what the level placed, spawned actors belong to whoever spawned them
+		if (!Actor->IsNetStartupActor() || Actor->IsPendingKill() || Actor->GetAttachParentActor()) continue;
+		if (!DormantClasses.ContainsByPredicate([Actor](const TSubclassOf<AActor>& Class) { return Class && Actor->IsA(Class); })) continue;
+
+		const int32 Index = Records.AddDefaulted();
+		FDormantRecord& Record = Records[Index];
+		Record.Transform = Actor->GetActorTransform();
+		Record.Actor = Actor;
+		Record.Cell = GetCell(Record.Transform.GetLocation());
+
+		// Pooling needs something to reset the actor on the way back out
+		Record.bPoolable = ActorPool && Actor->GetClass()->ImplementsInterface(UPoolableActor::StaticClass());
+		if (Record.bPoolable) {
+
+			HydratedActors.Add(Actor, Index);
+		}
+
+		Cells.FindOrAdd(Record.Cell).Records.Add(Index);
+		++NumHydrated;
+	}
+
+	UE_LOG(LogActionRPG, Log, TEXT("Dormant regions: %d actors in %d cells"), Records.Num(), Cells.Num());
+}
+
+void UDormantRegionSubsystem::UpdateCells()
+{
+	SCOPE_CYCLE_COUNTER(STAT_RegionUpdate);
+
+	TArray<FVector, TInlineAllocator<4>> Players;
+	for (FConstPlayerControllerIterator It = GetWorld()->GetPlayerControllerIterator(); It; ++It) {
+
+		AMain* Main = (*It).IsValid() ? Cast<AMain>((*It)->GetPawn()) : nullptr;
+		if (Main) {
+
+			Players.Add(Main->GetActorLocation());
+		}
+	}
+
+	// Nobody to measure from, e.g. while the player is being respawned
+	if (Players.Num() == 0) return;
+
+	const float ActivationSq = FMath::Square(ActivationRadius);
+	const float DeactivationSq = FMath::Square(FMath::Max(DeactivationRadius, ActivationRadius));
+	int32 ActiveCells = 0;
+
+	for (TPair<FIntPoint, FDormantCell>& Pair : Cells) {
+
+		FDormantCell& Cell = Pair.Value;
+		const FBox2D Bounds(FVector2D(Pair.Key) * CellSize, FVector2D(Pair.Key + FIntPoint(1, 1)) * CellSize);
+
+		float ClosestSq = MAX_flt;
+		for (const FVector& Location : Players) {
+
+			ClosestSq = FMath::Min(ClosestSq, Bounds.ComputeSquaredDistanceToPoint(FVector2D(Location)));
+		}
+
+		const bool bActive = ClosestSq <= (Cell.bActive ? DeactivationSq : ActivationSq);
+		if (bActive != Cell.bActive) {
+
+			Cell.bActive = bActive;
+			PendingTransitions.Append(Cell.Records);
+		}
+
+		ActiveCells += bActive ? 1 : 0;
+	}
+
+	SET_DWORD_STAT(STAT_RegionActiveCells, ActiveCells);
+}
+
+void UDormantRegionSubsystem::ProcessTransitions()
+{
+	if (NextTransition >= PendingTransitions.Num()) return;
+
+	SCOPE_CYCLE_COUNTER(STAT_RegionTransitions);
+
+	int32 Transitions = 0;
+	while (NextTransition < PendingTransitions.Num() && Transitions < MaxTransitionsPerFrame) {
+
+		const int32 Index = PendingTransitions[NextTransition++];
+		const FDormantRecord& Record = Records[Index];
+		if (Record.bConsumed) continue;
+
+		// The cell may have flipped back before the record got its turn
+		const bool bActive = Cells.FindChecked(Record.Cell).bActive;
+		if (bActive && !Record.bHydrated) {
+
+			Hydrate(Index);
+			++Transitions;
+		}
+		else if (!bActive && Record.bHydrated) {
+
+			Dehydrate(Index);
+			++Transitions;
+		}
+	}
+
+	if (NextTransition >= PendingTransitions.Num()) {
+
+		PendingTransitions.Reset();
+		NextTransition = 0;
+	}
+}
+
+void UDormantRegionSubsystem::Hydrate(int32 Index)
+{
+	FDormantRecord& Record = Records[Index];
+	AActor* Actor = Record.Actor.Get();
+
+	// Destroyed while dormant, e.g. by its level streaming out
+	if (!Actor) {
+
+		Record.bConsumed = true;
+		return;
+	}
+
+	if (!Record.bPoolable) {
+
+		Actor->SetActorTickEnabled(Record.bWasTicking);
+		for (UActorComponent* Component : Actor->GetComponents()) {
+
+			Component->SetComponentTickEnabled(Component->PrimaryComponentTick.bStartWithTickEnabled);
+		}
+		Record.bHydrated = true;
+		++NumHydrated;
+		return;
+	}
+
+	UActorPoolSubsystem* ActorPool = GetWorld()->GetSubsystem<UActorPoolSubsystem>();
+	if (!ActorPool) return;
+
+	ActorPool->UnparkActor(Actor, Record.Transform);
+
+	AEnemy* Enemy = Cast<AEnemy>(Actor);
+	if (Enemy) {
+
+		Enemy->Health = Record.Health;
+		Enemy->SetPatrolOrigin(Record.PatrolOrigin);
+	}
+
+	Record.bHydrated = true;
+	HydratedActors.Add(Actor, Index);
+	++NumHydrated;
+}
+
+void UDormantRegionSubsystem::Dehydrate(int32 Index)
+{
+	FDormantRecord& Record = Records[Index];
+	AActor* Actor = Record.Actor.Get();
+
+	// Gone, or picked up and carried around
+	if (!Actor || Actor->GetAttachParentActor()) {
+
+		Consume(Index);
+		return;
+	}
+
+	// Wandered into a cell a player is still near, it stays awake there
+	const FIntPoint ActorCell = GetCell(Actor->GetActorLocation());
+	if (ActorCell != Record.Cell) {
+
+		MoveRecord(Index, ActorCell);
+		if (Cells.FindChecked(ActorCell).bActive) return;
+	}
+
+	if (!Record.bPoolable) {
+
+		Record.bWasTicking = Actor->IsActorTickEnabled();
+		Actor->SetActorTickEnabled(false);
+		for (UActorComponent* Component : Actor->GetComponents()) {
+
+			Component->SetComponentTickEnabled(false);
+		}
+		Record.bHydrated = false;
+		--NumHydrated;
+		return;
+	}
+
+	Park(Index);
+}
+
+bool UDormantRegionSubsystem::DehydrateActor(AActor* Actor)
+{
+	const int32* Index = HydratedActors.Find(Actor);
+	if (!Index) return false;
+
+	const int32 RecordIndex = *Index;
+	const FIntPoint ActorCell = GetCell(Actor->GetActorLocation());
+	if (ActorCell != Records[RecordIndex].Cell) {
+
+		MoveRecord(RecordIndex, ActorCell);
+	}
+	return Park(RecordIndex);
+}
+
+bool UDormantRegionSubsystem::Park(int32 Index)
+{
+	FDormantRecord& Record = Records[Index];
+	AActor* Actor = Record.Actor.Get();
+
+	UActorPoolSubsystem* ActorPool = GetWorld()->GetSubsystem<UActorPoolSubsystem>();
+	if (!Actor || !ActorPool) return false;
+
+	AEnemy* Enemy = Cast<AEnemy>(Actor);
+	if (Enemy) {
+
+		// Dying, its corpse goes to the pool on its own
+		if (!Enemy->Alive()) {
+
+			Consume(Index);
+			return false;
+		}
+
+		Record.Health = Enemy->Health;
+		Record.PatrolOrigin = Enemy->GetPatrolOrigin();
+	}
+
+	Record.Transform = Actor->GetActorTransform();
+	Record.bHydrated = false;
+	--NumHydrated;
+
+	// Only hydrated actors are in the map, someone else releasing a parked one doesn't consume the record
+	HydratedActors.Remove(Actor);
+	ActorPool->ParkActor(Actor);
+	return true;
+}
+
+void UDormantRegionSubsystem::Consume(int32 Index)
+{
+	FDormantRecord& Record = Records[Index];
+	if (Record.bHydrated) {
+
+		--NumHydrated;
+	}
+
+	HydratedActors.Remove(Record.Actor);
+	Record.bConsumed = true;
+	Record.bHydrated = false;
+	Record.Actor = nullptr;
+}
+
+void UDormantRegionSubsystem::MoveRecord(int32 Index, const FIntPoint& NewCell)
+{
+	FDormantRecord& Record = Records[Index];
+	Cells.FindChecked(Record.Cell).Records.RemoveSingleSwap(Index);
+
+	FDormantCell* Cell = Cells.Find(NewCell);
+	if (!Cell) {
+
+		// A cell nobody placed anything in, dormant until the next update says otherwise
+		Cell = &Cells.Add(NewCell);
+		Cell->bActive = false;
+	}
+	Cell->Records.Add(Index);
+	Record.Cell = NewCell;
+}
+
+void UDormantRegionSubsystem::OnActorReleased(AActor* Actor)
+{
+	const int32* Index = HydratedActors.Find(Actor);
+	if (Index) {
+
+		Consume(*Index);
+	}
+}
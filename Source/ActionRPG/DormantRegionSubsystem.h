@@ -0,0 +1,148 @@
+// Copyright by Hakan Akkurt
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "Tickable.h"
+#include "DormantRegionSubsystem.generated.h"
+
+// What is kept of a placed actor while its cell is dormant
+USTRUCT()
+struct FDormantRecord
+{
+	GENERATED_BODY()
+
+	FTransform Transform;
+
+	// The placed actor itself, kept while dormant so nothing set on it per instance is lost
+	TWeakObjectPtr<AActor> Actor;
+
+	FIntPoint Cell;
+
+	// Enemy state the pool's reset would overwrite
+	float Health = 0.f;
+	FTransform PatrolOrigin;
+
+	// Poolable actors are parked like pooled ones while dormant, the rest only stop ticking
+	bool bPoolable = false;
+	bool bHydrated = true;
+	bool bWasTicking = true;
+
+	// Picked up, killed or destroyed, never comes back
+	bool bConsumed = false;
+};
+
+/**
+ * Keeps placed gameplay actors away from the player dormant. The first frame every placed actor of
+ * DormantClasses becomes a record in a grid cell; cells further than DeactivationRadius from every
+ * player park their enemies and pickups the way the actor pool does, and get the same actors back
+ * once a player comes within ActivationRadius. Platforms and switches can't reset themselves, so
+ * those only stop ticking.
+ */
+UCLASS(Config = Game)
+class ACTIONRPG_API UDormantRegionSubsystem : public UWorldSubsystem, public FTickableGameObject
+{
+	GENERATED_BODY()
+
+public:
+
+	UDormantRegionSubsystem();
+
+	UPROPERTY(Config, EditAnywhere, BlueprintReadOnly, Category = "Regions")
+	bool bEnabled;
+
+	// Placed actors of these classes are managed, equipped weapons and the player never are
+	UPROPERTY(Config, EditAnywhere, BlueprintReadOnly, Category = "Regions")
+	TArray<TSubclassOf<AActor>> DormantClasses;
+
+	UPROPERTY(Config, EditAnywhere, BlueprintReadOnly, Category = "Regions")
+	float CellSize;
+
+	// Cells this close to a player are hydrated, should sit beyond where enemies can be made out
+	UPROPERTY(Config, EditAnywhere, BlueprintReadOnly, Category = "Regions")
+	float ActivationRadius;
+
+	// Hydrated cells go dormant again past this, kept above ActivationRadius so borders don't flicker
+	UPROPERTY(Config, EditAnywhere, BlueprintReadOnly, Category = "Regions")
+	float DeactivationRadius;
+
+	UPROPERTY(Config, EditAnywhere, BlueprintReadOnly, Category = "Regions")
+	float UpdateInterval;
+
+	// Hydrations and dehydrations per frame, the rest wait for the next frame
+	UPROPERTY(Config, EditAnywhere, BlueprintReadOnly, Category = "Regions")
+	int32 MaxTransitionsPerFrame;
+
+	UFUNCTION(BlueprintPure, Category = "Regions")
+	int32 GetNumRecords() const { return Records.Num(); }
+
+	UFUNCTION(BlueprintPure, Category = "Regions")
+	int32 GetNumHydrated() const { return NumHydrated; }
+
+	// Parks one of our actors until its cell is next hydrated, false when Actor isn't one we can park
+	bool DehydrateActor(AActor* Actor);
+
+	virtual bool ShouldCreateSubsystem(UObject* Outer) const override;
+
+	virtual void Deinitialize() override;
+
+	// FTickableGameObject
+	virtual void Tick(float DeltaTime) override;
+	virtual bool IsTickable() const override;
+	virtual ETickableTickType GetTickableTickType() const override;
+	virtual TStatId GetStatId() const override;
+	virtual UWorld* GetTickableGameObjectWorld() const override { return GetWorld(); }
+
+private:
+
+	struct FDormantCell
+	{
+		TArray<int32> Records;
+		bool bActive = true;
+	};
+
+	FORCEINLINE FIntPoint GetCell(const FVector& Location) const
+	{
+		return FIntPoint(FMath::FloorToInt(Location.X / CellSize), FMath::FloorToInt(Location.Y / CellSize));
+	}
+
+	// Records every placed actor of DormantClasses, all of them start hydrated
+	void CaptureActors();
+
+	void UpdateCells();
+
+	void ProcessTransitions();
+
+	void Hydrate(int32 Index);
+
+	void Dehydrate(int32 Index);
+
+	// Parks a hydrated poolable record where it stands, whatever its cell, false when it couldn't be
+	bool Park(int32 Index);
+
+	// The actor is gone for good, the record is never hydrated again
+	void Consume(int32 Index);
+
+	void MoveRecord(int32 Index, const FIntPoint& NewCell);
+
+	// Picks up gameplay releasing one of our actors to the pool, the record is done with then
+	void OnActorReleased(AActor* Actor);
+
+	UPROPERTY()
+	TArray<FDormantRecord> Records;
+
+	TMap<FIntPoint, FDormantCell> Cells;
+
+	// Hydrated poolable actors back to their record
+	TMap<TWeakObjectPtr<AActor>, int32> HydratedActors;
+
+	// Records whose cell changed state, checked against the cell again when they are processed
+	TArray<int32> PendingTransitions;
+	int32 NextTransition;
+
+	bool bCaptured;
+	float UpdateCountdown;
+	int32 NumHydrated;
+	FDelegateHandle ReleasedHandle;
+};
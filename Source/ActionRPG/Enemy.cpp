@@ -2,6 +2,8 @@
 
 
 #include "Enemy.h"
+#include "EnemyArchetype.h"
+#include "ActionRPG.h"
 #include "Components/SphereComponent.h"
 #include "AIController.h"
 #include "Main.h"
@@ -11,9 +13,24 @@
 #include "Engine/SkeletalMeshSocket.h"
 #include "Sound/SoundCue.h"
 #include "Animation/AnimInstance.h"
-#include "TimerManager.h"
+#include "CombatSchedulerSubsystem.h"
 #include "Components/CapsuleComponent.h"
+#include "Components/SkeletalMeshComponent.h"
 #include "MainPlayerController.h"
+#include "EnemySignificanceSubsystem.h"
+#include "ActorPoolSubsystem.h"
+#include "EnemyAggroSubsystem.h"
+#include "EnemyFlowFieldSubsystem.h"
+#include "EnemyHordeSubsystem.h"
+#include "EnemyCorpseSubsystem.h"
+#include "EnemySquadSubsystem.h"
+#include "EnemyDecisionSubsystem.h"
+#include "EnemyHearingSubsystem.h"
+#include "FXPoolSubsystem.h"
+#include "GameplayAudioSubsystem.h"
+#include "AttackTokenComponent.h"
+#include "GameFramework/CharacterMovementComponent.h"
+#include "Navigation/PathFollowingComponent.h"
 
 // Sets default values
 AEnemy::AEnemy()
@@ -34,19 +51,43 @@ AEnemy::AEnemy()
 	CombatCollision->SetupAttachment(GetMesh(), FName("EnemySocket"));
 
 	bOverlappingCombatSphere = false;
+	AggroTarget = nullptr;
+	bAttackReady = false;
 
+	Archetype = nullptr;
 	Health = 100.f;
 	MaxHealth = 100.f;
-	Damage = 10.f;
 
-	AttackMinTime = 0.5f;
-	AttackMaxTime = 1.25f;
+#if WITH_EDITORONLY_DATA
+	// The old defaults, so Blueprints that never changed them still load them
+	Damage_DEPRECATED = 10.f;
+	HitParticles_DEPRECATED = nullptr;
+	HitSound_DEPRECATED = nullptr;
+	SwingSound_DEPRECATED = nullptr;
+	CombatMontage_DEPRECATED = nullptr;
+	AttackMinTime_DEPRECATED = 0.5f;
+	AttackMaxTime_DEPRECATED = 1.25f;
+	DeathDelay_DEPRECATED = 3.f;
+	PatrolAcceptanceRadius_DEPRECATED = 50.f;
+	StaggerDuration_DEPRECATED = 0.f;
+#endif
+
+	EnemyState = EEnemyState::ES_Idle;
+	EnemyMovementStatus = GetEnemyStateInfo(EnemyState).MovementStatus;
+
+	PatrolIndex = 0;
+	bInvestigatingNoise = false;
 
-	EnemyMovementStatus = EEnemyMovementStatus::EMS_Idle;
+	bHasValidTarget = false;
+	bUseSpatialAggro = false;
 
-	DeathDelay = 3.f;
+	SignificanceBucket = INDEX_NONE;
+	SignificanceScore = 0.f;
 
-	bHasValidTarget = false;
+	SquadIndex = INDEX_NONE;
+	bInFormation = false;
+
+	TipSocket = nullptr;
 }
 
 // Called when the game starts or when spawned
@@ -56,22 +97,98 @@ void AEnemy::BeginPlay()
 	
 	AIController = Cast<AAIController>(GetController());
 
-	AgroSphere->OnComponentBeginOverlap.AddDynamic(this, &AEnemy::AgroSphereOnOverlapBegin);
-	AgroSphere->OnComponentEndOverlap.AddDynamic(this, &AEnemy::AgroSphereOnOverlapEnd);
+	// Before the aggro subsystem reads the sphere radii
+	ApplyArchetype();
+	MaxHealth = GetMaxHealth();
+	Health = MaxHealth;
+
+	UEnemyAggroSubsystem* Aggro = GetWorld()->GetSubsystem<UEnemyAggroSubsystem>();
+	bUseSpatialAggro = Aggro && Aggro->bReplaceOverlapSpheres;
+
+	if (bUseSpatialAggro) {
+
+		AgroSphere->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+		CombatSphere->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+		Aggro->RegisterEnemy(this);
+	}
+	else {
 
-	CombatSphere->OnComponentBeginOverlap.AddDynamic(this, &AEnemy::CombatSphereOnOverlapBegin);
-	CombatSphere->OnComponentEndOverlap.AddDynamic(this, &AEnemy::CombatSphereOnOverlapEnd);
+		AgroSphere->OnComponentBeginOverlap.AddDynamic(this, &AEnemy::AgroSphereOnOverlapBegin);
+		AgroSphere->OnComponentEndOverlap.AddDynamic(this, &AEnemy::AgroSphereOnOverlapEnd);
 
-	CombatCollision->OnComponentBeginOverlap.AddDynamic(this, &AEnemy::CombatOnOverlapBegin);
-	CombatCollision->OnComponentEndOverlap.AddDynamic(this, &AEnemy::CombatOnOverlapEnd);
+		CombatSphere->OnComponentBeginOverlap.AddDynamic(this, &AEnemy::CombatSphereOnOverlapBegin);
+		CombatSphere->OnComponentEndOverlap.AddDynamic(this, &AEnemy::CombatSphereOnOverlapEnd);
+	}
 
+	// Only the shape of the weapon, swings are swept by UMeleeSwingSubsystem
 	CombatCollision->SetCollisionEnabled(ECollisionEnabled::NoCollision);
-	CombatCollision->SetCollisionObjectType(ECollisionChannel::ECC_WorldDynamic);
-	CombatCollision->SetCollisionResponseToAllChannels(ECollisionResponse::ECR_Ignore);
-	CombatCollision->SetCollisionResponseToChannel(ECollisionChannel::ECC_Pawn, ECollisionResponse::ECR_Overlap);
+
+	TipSocket = GetMesh()->GetSocketByName("TipSocket");
+
+	// Off EnemySocket until the first hit window
+	ParkedCombatCollision.SetParked(CombatCollision, FParkedComponent::IsEnabled());
 
 	GetMesh()->SetCollisionResponseToChannel(ECollisionChannel::ECC_Camera, ECollisionResponse::ECR_Ignore);
 	GetCapsuleComponent()->SetCollisionResponseToChannel(ECollisionChannel::ECC_Camera, ECollisionResponse::ECR_Ignore);
+
+	UEnemySignificanceSubsystem* Significance = GetWorld()->GetSubsystem<UEnemySignificanceSubsystem>();
+	if (Significance) {
+
+		Significance->RegisterEnemy(this);
+	}
+
+	UEnemyDecisionSubsystem* Decisions = GetWorld()->GetSubsystem<UEnemyDecisionSubsystem>();
+	if (Decisions) {
+
+		Decisions->RegisterEnemy(this);
+	}
+
+	PatrolOrigin = GetActorTransform();
+	RefreshTickRates();
+}
+
+void AEnemy::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	// A destroyed holder would keep its slot and a destroyed waiter would be granted one
+	ReleaseAttackToken();
+
+	UEnemySignificanceSubsystem* Significance = GetWorld()->GetSubsystem<UEnemySignificanceSubsystem>();
+	if (Significance) {
+
+		Significance->UnregisterEnemy(this);
+	}
+
+	UEnemyDecisionSubsystem* Decisions = GetWorld()->GetSubsystem<UEnemyDecisionSubsystem>();
+	if (Decisions) {
+
+		Decisions->UnregisterEnemy(this);
+	}
+
+	UEnemyAggroSubsystem* Aggro = GetWorld()->GetSubsystem<UEnemyAggroSubsystem>();
+	if (Aggro) {
+
+		Aggro->UnregisterEnemy(this);
+	}
+
+	UEnemyFlowFieldSubsystem* FlowField = GetWorld()->GetSubsystem<UEnemyFlowFieldSubsystem>();
+	if (FlowField) {
+
+		FlowField->StopFollowing(this);
+	}
+
+	UEnemyHordeSubsystem* Horde = GetWorld()->GetSubsystem<UEnemyHordeSubsystem>();
+	if (Horde) {
+
+		Horde->ForgetEnemy(this);
+	}
+
+	UEnemySquadSubsystem* Squads = GetWorld()->GetSubsystem<UEnemySquadSubsystem>();
+	if (Squads) {
+
+		Squads->ForgetEnemy(this);
+	}
+
+	Super::EndPlay(EndPlayReason);
 }
 
 // Called every frame
@@ -79,6 +196,189 @@ void AEnemy::Tick(float DeltaTime)
 {
 	Super::Tick(DeltaTime);
 
+	// Patrolling runs at the Passive tick rate, a reached point is noticed within one tick
+	if (EnemyState == EEnemyState::ES_Patrol && AIController && AIController->GetMoveStatus() == EPathFollowingStatus::Idle) {
+
+		if (PatrolPoints.Num() == 0) {
+
+			// Done looking into a noise
+			bInvestigatingNoise = false;
+			SetState(EEnemyState::ES_Idle);
+		}
+		else {
+
+			// A noise interrupted the walk to PatrolIndex, that point was never reached
+			if (!bInvestigatingNoise) {
+
+				PatrolIndex = (PatrolIndex + 1) % PatrolPoints.Num();
+			}
+			Patrol();
+		}
+	}
+}
+
+void AEnemy::SetState(EEnemyState NewState)
+{
+	if (NewState == EnemyState) return;
+
+	const EEnemyState OldState = EnemyState;
+
+	for (EEnemyState State = OldState; State != EEnemyState::ES_MAX && !IsEnemyStateIn(NewState, State); State = GetEnemyStateInfo(State).Parent) {
+
+		const FEnemyStateInfo& Info = GetEnemyStateInfo(State);
+		if (Info.OnExit) { Info.OnExit(*this); }
+	}
+
+	EnemyState = NewState;
+	EnemyMovementStatus = GetEnemyStateInfo(NewState).MovementStatus;
+
+	// Entered from the outermost state not shared with the old one inwards
+	EEnemyState Entered[(int32)EEnemyState::ES_MAX];
+	int32 NumEntered = 0;
+	for (EEnemyState State = NewState; State != EEnemyState::ES_MAX && !IsEnemyStateIn(OldState, State); State = GetEnemyStateInfo(State).Parent) {
+
+		Entered[NumEntered++] = State;
+	}
+	while (NumEntered > 0) {
+
+		const FEnemyStateInfo& Info = GetEnemyStateInfo(Entered[--NumEntered]);
+		if (Info.OnEnter) { Info.OnEnter(*this); }
+	}
+
+	ApplyStateComponents();
+	RefreshTickRates();
+}
+
+const UEnemyArchetype* AEnemy::GetArchetype() const
+{
+	if (Archetype) return Archetype;
+
+	// Placed enemies may have loaded before their class moved its tuning into an archetype
+	const AEnemy* Defaults = GetClass()->GetDefaultObject<AEnemy>();
+	return Defaults->Archetype ? Defaults->Archetype : GetDefault<UEnemyArchetype>();
+}
+
+float AEnemy::GetMaxHealth() const
+{
+	return GetArchetype()->MaxHealth;
+}
+
+#if WITH_EDITOR
+void AEnemy::PostLoad()
+{
+	Super::PostLoad();
+
+	// Set on purpose, rather than handed down from the class defaults
+	const AEnemy* Defaults = HasAnyFlags(RF_ClassDefaultObject) ? nullptr : GetClass()->GetDefaultObject<AEnemy>();
+	if (Archetype && (!Defaults || Archetype != Defaults->Archetype)) return;
+
+	// A placed enemy that kept its class's tuning follows the class's archetype, see GetArchetype,
+	// and class defaults never changed from the old defaults have nothing to move
+	if (Defaults ? LegacyTuningMatches(Defaults) : LegacyTuningMatches(GetDefault<UEnemyArchetype>())) return;
+
+	UEnemyArchetype* Migrated = NewObject<UEnemyArchetype>(this, TEXT("MigratedArchetype"));
+	CopyLegacyTuning(Migrated);
+	Archetype = Migrated;
+	UE_LOG(LogActionRPG, Log, TEXT("%s: moved its tuning into an archetype, resave to keep it"), *GetPathName());
+}
+
+void AEnemy::CopyLegacyTuning(UEnemyArchetype* Type) const
+{
+	Type->MaxHealth = MaxHealth;
+	Type->Damage = Damage_DEPRECATED;
+	Type->DamageTypeClass = DamagetTypeClass_DEPRECATED;
+	Type->AttackMinTime = AttackMinTime_DEPRECATED;
+	Type->AttackMaxTime = AttackMaxTime_DEPRECATED;
+	Type->StaggerDuration = StaggerDuration_DEPRECATED;
+	Type->DeathDelay = DeathDelay_DEPRECATED;
+	Type->AggroRadius = AgroSphere->GetUnscaledSphereRadius();
+	Type->CombatRadius = CombatSphere->GetUnscaledSphereRadius();
+	Type->PatrolAcceptanceRadius = PatrolAcceptanceRadius_DEPRECATED;
+	Type->CombatMontage = CombatMontage_DEPRECATED;
+	Type->HitParticles = HitParticles_DEPRECATED;
+	Type->HitSound = HitSound_DEPRECATED;
+	Type->SwingSound = SwingSound_DEPRECATED;
+}
+
+bool AEnemy::LegacyTuningMatches(const UEnemyArchetype* Type) const
+{
+	return MaxHealth == Type->MaxHealth
+		&& Damage_DEPRECATED == Type->Damage
+		&& DamagetTypeClass_DEPRECATED == Type->DamageTypeClass
+		&& AttackMinTime_DEPRECATED == Type->AttackMinTime
+		&& AttackMaxTime_DEPRECATED == Type->AttackMaxTime
+		&& StaggerDuration_DEPRECATED == Type->StaggerDuration
+		&& DeathDelay_DEPRECATED == Type->DeathDelay
+		&& AgroSphere->GetUnscaledSphereRadius() == Type->AggroRadius
+		&& CombatSphere->GetUnscaledSphereRadius() == Type->CombatRadius
+		&& PatrolAcceptanceRadius_DEPRECATED == Type->PatrolAcceptanceRadius
+		&& CombatMontage_DEPRECATED == Type->CombatMontage
+		&& HitParticles_DEPRECATED == Type->HitParticles
+		&& HitSound_DEPRECATED == Type->HitSound
+		&& SwingSound_DEPRECATED == Type->SwingSound;
+}
+
+bool AEnemy::LegacyTuningMatches(const AEnemy* Other) const
+{
+	return MaxHealth == Other->MaxHealth
+		&& Damage_DEPRECATED == Other->Damage_DEPRECATED
+		&& DamagetTypeClass_DEPRECATED == Other->DamagetTypeClass_DEPRECATED
+		&& AttackMinTime_DEPRECATED == Other->AttackMinTime_DEPRECATED
+		&& AttackMaxTime_DEPRECATED == Other->AttackMaxTime_DEPRECATED
+		&& StaggerDuration_DEPRECATED == Other->StaggerDuration_DEPRECATED
+		&& DeathDelay_DEPRECATED == Other->DeathDelay_DEPRECATED
+		&& AgroSphere->GetUnscaledSphereRadius() == Other->AgroSphere->GetUnscaledSphereRadius()
+		&& CombatSphere->GetUnscaledSphereRadius() == Other->CombatSphere->GetUnscaledSphereRadius()
+		&& PatrolAcceptanceRadius_DEPRECATED == Other->PatrolAcceptanceRadius_DEPRECATED
+		&& CombatMontage_DEPRECATED == Other->CombatMontage_DEPRECATED
+		&& HitParticles_DEPRECATED == Other->HitParticles_DEPRECATED
+		&& HitSound_DEPRECATED == Other->HitSound_DEPRECATED
+		&& SwingSound_DEPRECATED == Other->SwingSound_DEPRECATED;
+}
+#endif
+
+void AEnemy::ApplyArchetype()
+{
+	const UEnemyArchetype* Type = GetArchetype();
+	AgroSphere->SetSphereRadius(Type->AggroRadius);
+	CombatSphere->SetSphereRadius(Type->CombatRadius);
+}
+
+void AEnemy::ApplyStateComponents()
+{
+	const FEnemyStateInfo& Info = GetEnemyStateInfo(EnemyState);
+	const AEnemy* Defaults = GetClass()->GetDefaultObject<AEnemy>();
+
+	if (!bUseSpatialAggro) {
+
+		AgroSphere->SetCollisionEnabled(Info.bSenses ? Defaults->AgroSphere->GetCollisionEnabled() : ECollisionEnabled::NoCollision);
+		CombatSphere->SetCollisionEnabled(Info.bSenses ? Defaults->CombatSphere->GetCollisionEnabled() : ECollisionEnabled::NoCollision);
+	}
+	GetCapsuleComponent()->SetCollisionEnabled(Info.bBodyCollision ? Defaults->GetCapsuleComponent()->GetCollisionEnabled() : ECollisionEnabled::NoCollision);
+
+	if (!Info.bCollisionWindows) {
+
+		DeactivateCollision();
+	}
+}
+
+void AEnemy::RefreshTickRates()
+{
+	const FEnemyStateInfo& Info = GetEnemyStateInfo(EnemyState);
+	float Interval = Info.TickInterval;
+
+	UEnemySignificanceSubsystem* Significance = GetWorld()->GetSubsystem<UEnemySignificanceSubsystem>();
+	const FEnemySignificanceBucket* Bucket = Significance ? Significance->GetBucket(SignificanceBucket) : nullptr;
+	if (Bucket) {
+
+		Interval = FMath::Max(Interval, Bucket->ActorTickInterval);
+	}
+	SetActorTickInterval(Interval);
+
+	if (AIController) {
+
+		AIController->SetActorTickInterval(Info.TickInterval);
+	}
 }
 
 // Called to bind functionality to input
@@ -96,7 +396,7 @@ void AEnemy::AgroSphereOnOverlapBegin(UPrimitiveComponent* OverlappedComponent,
 
 		if (Main) {
 
-			MoveToTarget(Main);
+			OnAggroEnter(Main);
 		}
 	}
 }
@@ -109,21 +409,7 @@ void AEnemy::AgroSphereOnOverlapEnd(UPrimitiveComponent* OverlappedComponent, AA
 
 		if (Main) {
 
-			bHasValidTarget = false;
-			if (Main->CombatTarget == this) {
-
-				Main->SetCombatTarget(nullptr);
-			}
-
-			Main->SetHasCombatTarget(false);
-			Main->UpdateCombatTarget();
-
-			SetEnemyMovementStatus(EEnemyMovementStatus::EMS_Idle);
-
-			if (AIController) {
-
-				AIController->StopMovement();
-			}
+			OnAggroExit(Main);
 		}
 	}
 }
@@ -136,17 +422,7 @@ void AEnemy::CombatSphereOnOverlapBegin(UPrimitiveComponent* OverlappedComponent
 
 		if (Main) {
 
-			bHasValidTarget = true;
-
-			Main->SetCombatTarget(this);
-			Main->SetHasCombatTarget(true);
-			Main->UpdateCombatTarget();
-			
-			CombatTarget = Main;
-			bOverlappingCombatSphere = true;
-			
-			float AttackTime = FMath::FRandRange(AttackMinTime, AttackMaxTime);
-			GetWorldTimerManager().SetTimer(AttackTimer, this, &AEnemy::Attack, AttackTime);
+			OnCombatRangeEnter(Main);
 		}
 	}
 }
@@ -159,31 +435,93 @@ void AEnemy::CombatSphereOnOverlapEnd(UPrimitiveComponent* OverlappedComponent,
 
 		if (Main) {
 
-			bOverlappingCombatSphere = false;
-			MoveToTarget(Main);
-			CombatTarget = nullptr;
+			// Only the mesh leaving the sphere hides the health bar, the capsule ends its overlap separately
+			OnCombatRangeExit(Main, OtherComp->IsA<USkeletalMeshComponent>());
+		}
+	}
+}
 
-			if (Main->CombatTarget == this) {
+void AEnemy::OnAggroEnter(AMain* Main)
+{
+	AggroTarget = Main;
+}
 
-				Main->SetCombatTarget(nullptr);
-				Main->bHasCombatTarget = false;
-				Main->UpdateCombatTarget();
-			}
+void AEnemy::OnAggroExit(AMain* Main)
+{
+	bHasValidTarget = false;
+	if (Main->CombatTarget == this) {
 
-			if (Main->MainPlayerController) {
+		Main->SetCombatTarget(nullptr);
+	}
 
-				USkeletalMeshComponent* MainMesh = Cast<USkeletalMeshComponent>(OtherComp);
-				if (MainMesh) { Main->MainPlayerController->RemoveEnemyHealthBar(); }
-			}
+	Main->SetHasCombatTarget(false);
+	Main->UpdateCombatTarget();
 
-			GetWorldTimerManager().ClearTimer(AttackTimer);
-		}
+	if (AggroTarget == Main) {
+
+		AggroTarget = nullptr;
+	}
+}
+
+void AEnemy::OnCombatRangeEnter(AMain* Main)
+{
+	bHasValidTarget = true;
+
+	Main->SetCombatTarget(this);
+	Main->SetHasCombatTarget(true);
+	Main->UpdateCombatTarget();
+	
+	CombatTarget = Main;
+	bOverlappingCombatSphere = true;
+	
+	RequestAttack();
+}
+
+void AEnemy::OnCombatRangeExit(AMain* Main, bool bRemoveHealthBar)
+{
+	ReleaseAttackToken();
+	if (AIController) {
+
+		AIController->ClearFocus(EAIFocusPriority::Gameplay);
+	}
+
+	bOverlappingCombatSphere = false;
+	bAttackReady = false;
+	CombatTarget = nullptr;
+
+	if (Main->CombatTarget == this) {
+
+		Main->SetCombatTarget(nullptr);
+		Main->bHasCombatTarget = false;
+		Main->UpdateCombatTarget();
+	}
+
+	if (Main->MainPlayerController && bRemoveHealthBar) {
+
+		Main->MainPlayerController->RemoveEnemyHealthBar();
+	}
+
+	UCombatSchedulerSubsystem* Scheduler = UCombatSchedulerSubsystem::Get(this);
+	if (Scheduler) {
+
+		Scheduler->ClearTimer(AttackTimer);
 	}
 }
 
 void AEnemy::MoveToTarget(AMain* Target)
 {
-	SetEnemyMovementStatus(EEnemyMovementStatus::EMS_MoveToTarget);
+	SetState(EEnemyState::ES_Chase);
+
+	// Chasers near the player share one flow field instead of each running a path query
+	UEnemyFlowFieldSubsystem* FlowField = GetWorld()->GetSubsystem<UEnemyFlowFieldSubsystem>();
+	if (FlowField && FlowField->StartFollowing(this, Target)) {
+
+		if (AIController) {
+
+			AIController->StopMovement();
+		}
+		return;
+	}
 
 	if (AIController) {
 
@@ -197,49 +535,144 @@ void AEnemy::MoveToTarget(AMain* Target)
 	}
 }
 
-void AEnemy::CombatOnOverlapBegin(UPrimitiveComponent* OverlappedComponent, AActor* OtherActor, UPrimitiveComponent* OtherComp, int32 OtherBodyIndex, bool bFromSweep, const FHitResult& SweepResult)
+void AEnemy::StopChasing()
 {
-	if (OtherActor) {
-		
-		AMain* Main = Cast<AMain>(OtherActor);
-		if (Main) {
+	// Entering Idle stops the movement
+	SetState(EEnemyState::ES_Idle);
+}
 
-			if (Main->HitParticles) {
+void AEnemy::Patrol()
+{
+	if (PatrolPoints.Num() == 0) return;
 
-				const USkeletalMeshSocket* TipSocket = GetMesh()->GetSocketByName("TipSocket");
-				if (TipSocket) {
+	SetState(EEnemyState::ES_Patrol);
 
-					FVector SocketLocation = TipSocket->GetSocketLocation(GetMesh());
-					UGameplayStatics::SpawnEmitterAtLocation(GetWorld(), Main->HitParticles, SocketLocation, FRotator(0.f), false);
-				}
+	bInvestigatingNoise = false;
+	PatrolIndex %= PatrolPoints.Num();
+	if (AIController) {
+
+		AIController->MoveToLocation(PatrolOrigin.TransformPosition(PatrolPoints[PatrolIndex]), GetArchetype()->PatrolAcceptanceRadius);
+	}
+}
+
+void AEnemy::Stagger()
+{
+	const float StaggerDuration = GetArchetype()->StaggerDuration;
+	if (!Alive() || StaggerDuration <= 0.f) return;
+
+	SetState(EEnemyState::ES_Stagger);
+
+	UCombatSchedulerSubsystem* Scheduler = UCombatSchedulerSubsystem::Get(this);
+	if (Scheduler) {
+
+		Scheduler->SetTimer(StaggerTimer, this, &AEnemy::StaggerEnd, StaggerDuration);
+	}
+}
+
+bool AEnemy::CanHearNoise()
+{
+	return Alive() && !AggroTarget && !bInFormation && IsEnemyStateIn(EnemyState, EEnemyState::ES_Passive);
+}
+
+void AEnemy::OnHeardNoise(const FVector& Location, AActor* Instigator)
+{
+	if (!CanHearNoise()) return;
+
+	// Patrol carries on to the point it was heading for once the noise has been checked
+	SetState(EEnemyState::ES_Patrol);
+	bInvestigatingNoise = true;
+	if (AIController) {
+
+		AIController->MoveToLocation(Location, GetArchetype()->PatrolAcceptanceRadius);
+	}
+}
+
+void AEnemy::StaggerEnd()
+{
+	// The decision pass picks the chase or the attack back up from here
+	if (EnemyState == EEnemyState::ES_Stagger) {
+
+		SetState(EEnemyState::ES_Idle);
+	}
+}
+
+void AEnemy::OnSwingHits(const TArray<FHitResult>& Hits)
+{
+	for (const FHitResult& Hit : Hits) {
+
+		AMain* Main = Cast<AMain>(Hit.GetActor());
+		if (Main) {
+
+			if (Main->HitParticles && TipSocket) {
+
+				FVector SocketLocation = TipSocket->GetSocketLocation(GetMesh());
+				UFXPoolSubsystem::SpawnEmitterAtLocation(this, Main->HitParticles, SocketLocation);
 			}
 			if (Main->HitSound) {
-				UGameplayStatics::PlaySound2D(this, Main->HitSound);
+				UGameplayAudioSubsystem::PlaySoundAtLocation(this, Main->HitSound, Main->GetActorLocation());
 			}
-			if (DamagetTypeClass) {
-				UGameplayStatics::ApplyDamage(Main, Damage, AIController, this, DamagetTypeClass);
+			UEnemyHearingSubsystem::ReportNoise(this, Main->GetActorLocation(), 1.f, this);
+
+			const UEnemyArchetype* Type = GetArchetype();
+			if (Type->DamageTypeClass) {
+				UGameplayStatics::ApplyDamage(Main, Type->Damage, AIController, this, Type->DamageTypeClass);
 			}
 		}
 	}
 }
 
-void AEnemy::CombatOnOverlapEnd(UPrimitiveComponent* OverlappedComponent, AActor* OtherActor, UPrimitiveComponent* OtherComp, int32 OtherBodyIndex)
+void AEnemy::ActivateCollision()
 {
+	if (!GetEnemyStateInfo(EnemyState).bCollisionWindows) return;
 
-}
+	// Back on the socket before the swing reads where the blade is
+	ParkedCombatCollision.SetParked(CombatCollision, false);
 
-void AEnemy::ActivateCollision()
-{
-	CombatCollision->SetCollisionEnabled(ECollisionEnabled::QueryOnly);
+	UMeleeSwingSubsystem* Melee = UMeleeSwingSubsystem::Get(this);
+	if (Melee) {
+
+		Melee->BeginSwing(SwingHandle, CombatCollision, { this }, FOnMeleeHits::CreateUObject(this, &AEnemy::OnSwingHits));
+	}
+
+	USoundCue* SwingSound = GetArchetype()->SwingSound;
 	if (SwingSound) {
 
-		UGameplayStatics::PlaySound2D(this, SwingSound);
+		UGameplayAudioSubsystem::PlaySoundAtLocation(this, SwingSound, GetActorLocation());
+		UEnemyHearingSubsystem::ReportNoise(this, GetActorLocation(), 0.5f, this);
 	}
 }
 
 void AEnemy::DeactivateCollision()
 {
-	CombatCollision->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+	UMeleeSwingSubsystem* Melee = UMeleeSwingSubsystem::Get(this);
+	if (Melee) {
+
+		Melee->EndSwing(SwingHandle);
+	}
+
+	ParkedCombatCollision.SetParked(CombatCollision, FParkedComponent::IsEnabled());
+}
+
+void AEnemy::FireProjectile()
+{
+	if (!GetEnemyStateInfo(EnemyState).bCollisionWindows) return;
+
+	AMain* Target = CombatTarget ? CombatTarget : AggroTarget;
+	UProjectileSubsystem* Projectiles = UProjectileSubsystem::Get(this);
+	if (!Target || !Projectiles) return;
+
+	FVector Start = GetActorLocation();
+	if (TipSocket) {
+
+		Start = TipSocket->GetSocketLocation(GetMesh());
+	}
+
+	const UEnemyArchetype* Type = GetArchetype();
+	if (Projectiles->Fire(Type->Projectile, Start, Target->GetActorLocation() - Start, this, AIController) && Type->SwingSound) {
+
+		UGameplayAudioSubsystem::PlaySoundAtLocation(this, Type->SwingSound, GetActorLocation());
+		UEnemyHearingSubsystem::ReportNoise(this, GetActorLocation(), 0.5f, this);
+	}
 }
 
 void AEnemy::Attack()
@@ -249,17 +682,21 @@ void AEnemy::Attack()
 		if (AIController) {
 
 			AIController->StopMovement();
-			SetEnemyMovementStatus(EEnemyMovementStatus::EMS_Attacking);
+			SetState(EEnemyState::ES_Attack);
 		}
 		if (!bAttacking) {
 
 			bAttacking = true;
 			UAnimInstance* AnimInstance = GetMesh()->GetAnimInstance();
-			if (AnimInstance) {
+			UAnimMontage* CombatMontage = GetArchetype()->CombatMontage;
+			if (AnimInstance && CombatMontage && AnimInstance->Montage_Play(CombatMontage, 1.35f) > 0.f) {
 
-				AnimInstance->Montage_Play(CombatMontage, 1.35f);
 				AnimInstance->Montage_JumpToSection(FName("Attack"), CombatMontage);
+			}
+			else {
 
+				// Nothing to play, so no notify would ever end the attack or hand the token back
+				AttackEnd();
 			}
 
 		}
@@ -270,13 +707,74 @@ void AEnemy::Attack()
 void AEnemy::AttackEnd()
 {
 	bAttacking = false;
+
+	// Back of the queue, so waiting enemies take turns
+	ReleaseAttackToken();
 	if (bOverlappingCombatSphere) { 
 		
-		float AttackTime = FMath::FRandRange(AttackMinTime, AttackMaxTime);
-		GetWorldTimerManager().SetTimer(AttackTimer, this, &AEnemy::Attack, AttackTime);
+		RequestAttack();
 	}
 }
 
+void AEnemy::RequestAttack()
+{
+	bAttackReady = false;
+
+	UAttackTokenComponent* AttackTokens = CombatTarget ? CombatTarget->AttackTokens : nullptr;
+	if (AttackTokens && !AttackTokens->RequestToken(this)) {
+
+		// Hold position facing the target, no montage and no collision window until a token comes through
+		StopChasing();
+		if (AIController) {
+
+			AIController->SetFocus(CombatTarget);
+		}
+		return;
+	}
+
+	StartAttackTimer();
+}
+
+void AEnemy::OnAttackTokenGranted(AMain* Main)
+{
+	if (!Alive() || !bOverlappingCombatSphere || CombatTarget != Main) {
+
+		// Moved on while waiting, pass the token along
+		ReleaseAttackToken();
+		return;
+	}
+
+	if (AIController) {
+
+		AIController->ClearFocus(EAIFocusPriority::Gameplay);
+	}
+	StartAttackTimer();
+}
+
+void AEnemy::ReleaseAttackToken()
+{
+	if (CombatTarget && CombatTarget->AttackTokens) {
+
+		CombatTarget->AttackTokens->ReleaseToken(this);
+	}
+}
+
+void AEnemy::StartAttackTimer()
+{
+	const UEnemyArchetype* Type = GetArchetype();
+	float AttackTime = FMath::FRandRange(Type->AttackMinTime, Type->AttackMaxTime);
+	UCombatSchedulerSubsystem* Scheduler = UCombatSchedulerSubsystem::Get(this);
+	if (Scheduler) {
+
+		Scheduler->SetTimer(AttackTimer, this, &AEnemy::OnAttackTimer, AttackTime);
+	}
+}
+
+void AEnemy::OnAttackTimer()
+{
+	bAttackReady = true;
+}
+
 float AEnemy::TakeDamage(float DamageAmount, FDamageEvent const& DamageEvent, AController* EventInstigator, AActor* DamageCauser)
 {
 	if (Health - DamageAmount <= 0.f) {
@@ -287,6 +785,12 @@ float AEnemy::TakeDamage(float DamageAmount, FDamageEvent const& DamageEvent, AC
 	else {
 
 		Health -= DamageAmount;
+
+		// A swing already under way isn't interrupted
+		if (!bAttacking) {
+
+			Stagger();
+		}
 	}
 	return DamageAmount;
 }
@@ -294,26 +798,43 @@ float AEnemy::TakeDamage(float DamageAmount, FDamageEvent const& DamageEvent, AC
 void AEnemy::Die(AActor* Causer)
 {
 	UAnimInstance* AnimInstance = GetMesh()->GetAnimInstance();
-	if (AnimInstance) {
+	UAnimMontage* CombatMontage = GetArchetype()->CombatMontage;
+	const bool bDeathMontage = AnimInstance && CombatMontage && AnimInstance->Montage_Play(CombatMontage, 1.0f) > 0.f;
+	if (bDeathMontage) {
 
-		AnimInstance->Montage_Play(CombatMontage, 1.0f);
 		AnimInstance->Montage_JumpToSection(FName("Death"), CombatMontage);
-
 	}
-	SetEnemyMovementStatus(EEnemyMovementStatus::EMS_Dead);
+	// Dead switches off the weapon, the senses and the capsule
+	SetState(EEnemyState::ES_Dead);
 
-	CombatCollision->SetCollisionEnabled(ECollisionEnabled::NoCollision);
-	AgroSphere->SetCollisionEnabled(ECollisionEnabled::NoCollision);
-	CombatSphere->SetCollisionEnabled(ECollisionEnabled::NoCollision);
-	GetCapsuleComponent()->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+	UCombatSchedulerSubsystem* Scheduler = UCombatSchedulerSubsystem::Get(this);
+	if (Scheduler) {
+
+		Scheduler->ClearTimer(StaggerTimer);
+	}
 
 	bAttacking = false;
+	bAttackReady = false;
+	ReleaseAttackToken();
+
+	// Out of range before the player looks for a new target, so it can't pick the corpse
+	UEnemyAggroSubsystem* Aggro = GetWorld()->GetSubsystem<UEnemyAggroSubsystem>();
+	if (Aggro) {
+
+		Aggro->ClearEnemyRange(this);
+	}
 
 	AMain* Main = Cast<AMain>(Causer);
 	if (Main) {
 
 		Main->UpdateCombatTarget();
 	}
+
+	// Without a montage no DeathEnd notify is coming
+	if (!bDeathMontage) {
+
+		DeathEnd();
+	}
 }
 
 void AEnemy::DeathEnd()
@@ -321,7 +842,19 @@ void AEnemy::DeathEnd()
 	GetMesh()->bPauseAnims = true;
 	GetMesh()->bNoSkeletonUpdate = true;
 
-	GetWorldTimerManager().SetTimer(DeathTimer, this, &AEnemy::Disappear, DeathDelay);
+	// A frozen copy of the mesh stands in for the corpse, the enemy itself can go back to the pool now
+	UEnemyCorpseSubsystem* Corpses = GetWorld()->GetSubsystem<UEnemyCorpseSubsystem>();
+	if (Corpses && Corpses->AddCorpse(this)) {
+
+		Disappear();
+		return;
+	}
+
+	UCombatSchedulerSubsystem* Scheduler = UCombatSchedulerSubsystem::Get(this);
+	if (Scheduler) {
+
+		Scheduler->SetTimer(DeathTimer, this, &AEnemy::Disappear, GetArchetype()->DeathDelay);
+	}
 }
 
 bool AEnemy::Alive()
@@ -331,5 +864,201 @@ bool AEnemy::Alive()
 
 void AEnemy::Disappear()
 {
-	Destroy();
+	UActorPoolSubsystem::ReleaseOrDestroy(this);
 }
+
+void AEnemy::OnAcquiredFromPool()
+{
+	MaxHealth = GetMaxHealth();
+	Health = MaxHealth;
+
+	bAttacking = false;
+	bHasValidTarget = false;
+	bOverlappingCombatSphere = false;
+	bAttackReady = false;
+	CombatTarget = nullptr;
+	AggroTarget = nullptr;
+
+	GetMesh()->bPauseAnims = false;
+	GetMesh()->bNoSkeletonUpdate = false;
+
+	// The controller stays possessed while pooled, only freshly spawned enemies need one
+	if (!GetController()) {
+
+		SpawnDefaultController();
+	}
+	AIController = Cast<AAIController>(GetController());
+	if (AIController) {
+
+		AIController->SetActorTickEnabled(true);
+	}
+
+	// Back out of Dead, which also restores the collision Die() switched off
+	SetState(EEnemyState::ES_Idle);
+	ApplyStateComponents();
+
+	PatrolOrigin = GetActorTransform();
+	PatrolIndex = 0;
+	bInvestigatingNoise = false;
+
+	UEnemySignificanceSubsystem* Significance = GetWorld()->GetSubsystem<UEnemySignificanceSubsystem>();
+	if (Significance) {
+
+		Significance->RegisterEnemy(this);
+	}
+
+	UEnemyDecisionSubsystem* Decisions = GetWorld()->GetSubsystem<UEnemyDecisionSubsystem>();
+	if (Decisions) {
+
+		Decisions->RegisterEnemy(this);
+	}
+
+	UEnemyAggroSubsystem* Aggro = GetWorld()->GetSubsystem<UEnemyAggroSubsystem>();
+	if (Aggro && bUseSpatialAggro) {
+
+		Aggro->RegisterEnemy(this);
+	}
+}
+
+void AEnemy::OnReturnedToPool()
+{
+	UCombatSchedulerSubsystem* Scheduler = UCombatSchedulerSubsystem::Get(this);
+	if (Scheduler) {
+
+		Scheduler->ClearTimer(AttackTimer);
+		Scheduler->ClearTimer(DeathTimer);
+		Scheduler->ClearTimer(StaggerTimer);
+	}
+
+	DeactivateCollision();
+	ReleaseAttackToken();
+	if (CombatTarget && CombatTarget->CombatTarget == this) {
+
+		CombatTarget->SetCombatTarget(nullptr);
+		CombatTarget->SetHasCombatTarget(false);
+	}
+	CombatTarget = nullptr;
+	AggroTarget = nullptr;
+
+	UAnimInstance* AnimInstance = GetMesh()->GetAnimInstance();
+	if (AnimInstance) {
+
+		AnimInstance->Montage_Stop(0.f);
+	}
+
+	GetCharacterMovement()->StopMovementImmediately();
+
+	if (AIController) {
+
+		AIController->StopMovement();
+		AIController->SetActorTickEnabled(false);
+	}
+
+	UEnemySignificanceSubsystem* Significance = GetWorld()->GetSubsystem<UEnemySignificanceSubsystem>();
+	if (Significance) {
+
+		Significance->UnregisterEnemy(this);
+	}
+
+	UEnemyDecisionSubsystem* Decisions = GetWorld()->GetSubsystem<UEnemyDecisionSubsystem>();
+	if (Decisions) {
+
+		Decisions->UnregisterEnemy(this);
+	}
+
+	UEnemyAggroSubsystem* Aggro = GetWorld()->GetSubsystem<UEnemyAggroSubsystem>();
+	if (Aggro) {
+
+		Aggro->UnregisterEnemy(this);
+	}
+
+	UEnemyFlowFieldSubsystem* FlowField = GetWorld()->GetSubsystem<UEnemyFlowFieldSubsystem>();
+	if (FlowField) {
+
+		FlowField->StopFollowing(this);
+	}
+
+	UEnemyHordeSubsystem* Horde = GetWorld()->GetSubsystem<UEnemyHordeSubsystem>();
+	if (Horde) {
+
+		Horde->ForgetEnemy(this);
+	}
+
+	UEnemySquadSubsystem* Squads = GetWorld()->GetSubsystem<UEnemySquadSubsystem>();
+	if (Squads) {
+
+		Squads->ForgetEnemy(this);
+	}
+}
+
+// ActionRPG.Hitbox.Benchmark Class [Count] [Frames]
+// Spawns Count enemies of Class next to the player and, with ActionRPG.Hitbox.Park off and then on, moves each one and
+// pushes its pose to its attached components every frame, like movement and the anim update do. Logs the cost per enemy.
+// Class needs a mesh with the EnemySocket its blade box hangs from, plain AEnemy has neither.
+static FAutoConsoleCommandWithWorldAndArgs HitboxBenchmarkCommand(
+	TEXT("ActionRPG.Hitbox.Benchmark"),
+	TEXT("Compares enemy component update cost with blade boxes attached and parked. Usage: ActionRPG.Hitbox.Benchmark Class [Count] [Frames]"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateStatic([](const TArray<FString>& Args, UWorld* World)
+	{
+		UActorPoolSubsystem* ActorPool = World ? World->GetSubsystem<UActorPoolSubsystem>() : nullptr;
+		APawn* PlayerPawn = World ? UGameplayStatics::GetPlayerPawn(World, 0) : nullptr;
+		UClass* Class = Args.Num() > 0 ? LoadClass<AEnemy>(nullptr, *Args[0]) : nullptr;
+
+		if (!ActorPool || !PlayerPawn || !Class) {
+
+			UE_LOG(LogActionRPG, Warning, TEXT("ActionRPG.Hitbox.Benchmark needs a player and an enemy Blueprint class"));
+			return;
+		}
+
+		const int32 Count = Args.Num() > 1 ? FCString::Atoi(*Args[1]) : 100;
+		const int32 Frames = FMath::Max(1, Args.Num() > 2 ? FCString::Atoi(*Args[2]) : 120);
+
+		const int32 Columns = FMath::CeilToInt(FMath::Sqrt((float)Count));
+		const FVector Origin = PlayerPawn->GetActorLocation() + FVector(500.f, 0.f, 0.f);
+
+		TArray<AEnemy*> Enemies;
+		for (int32 i = 0; i < Count; ++i) {
+
+			const FVector Location = Origin + FVector((i / Columns) * 150.f, (i % Columns) * 150.f, 0.f);
+			AEnemy* Enemy = ActorPool->AcquireActor<AEnemy>(Class, FTransform(Location));
+			if (Enemy) {
+
+				Enemies.Add(Enemy);
+			}
+		}
+
+		const int32 PreviousMode = CVarParkHitboxes.GetValueOnGameThread();
+		double Seconds[2] = { 0.0, 0.0 };
+
+		for (int32 Mode = 0; Mode < 2; ++Mode) {
+
+			// Closing the hit window parks or unparks the blade to match the mode
+			CVarParkHitboxes.AsVariable()->Set(Mode, ECVF_SetByCode);
+			for (AEnemy* Enemy : Enemies) {
+
+				Enemy->DeactivateCollision();
+			}
+
+			const double Start = FPlatformTime::Seconds();
+			for (int32 Frame = 0; Frame < Frames; ++Frame) {
+
+				const FVector Offset(0.f, 0.f, (Frame & 1) ? -1.f : 1.f);
+				for (AEnemy* Enemy : Enemies) {
+
+					Enemy->SetActorLocation(Enemy->GetActorLocation() + Offset, false, nullptr, ETeleportType::TeleportPhysics);
+					Enemy->GetMesh()->UpdateChildTransforms();
+				}
+			}
+			Seconds[Mode] = FPlatformTime::Seconds() - Start;
+		}
+
+		CVarParkHitboxes.AsVariable()->Set(PreviousMode, ECVF_SetByCode);
+		for (AEnemy* Enemy : Enemies) {
+
+			UActorPoolSubsystem::ReleaseOrDestroy(Enemy);
+		}
+
+		const double Updates = FMath::Max(1, Enemies.Num() * Frames);
+		UE_LOG(LogActionRPG, Log, TEXT("Hitbox benchmark %d enemies x%d frames: attached %.2f us, parked %.2f us per enemy update"),
+			Enemies.Num(), Frames, Seconds[0] * 1000000.0 / Updates, Seconds[1] * 1000000.0 / Updates);
+	}));
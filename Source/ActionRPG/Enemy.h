@@ -4,21 +4,15 @@
 
 #include "CoreMinimal.h"
 #include "GameFramework/Character.h"
+#include "PoolableActor.h"
+#include "CombatSchedulerSubsystem.h"
+#include "EnemyState.h"
+#include "MeleeSwingSubsystem.h"
+#include "ParkedComponent.h"
 #include "Enemy.generated.h"
 
-UENUM(BlueprintType)
-enum class EEnemyMovementStatus : uint8
-{
-	EMS_Idle			UMETA(DisplayName = "Idle"),
-	EMS_MoveToTarget	UMETA(DisplayName = "MoveToTarget"),
-	EMS_Attacking		UMETA(DisplayName = "Attacking"),
-	EMS_Dead			UMETA(DisplayName = "Dead"),
-
-	EMS_MAX				UMETA(DisplayName = "DefaultMAX")
-};
-
 UCLASS()
-class ACTIONRPG_API AEnemy : public ACharacter
+class ACTIONRPG_API AEnemy : public ACharacter, public IPoolableActor
 {
 	GENERATED_BODY()
 
@@ -28,11 +22,22 @@ public:
 
 	bool bHasValidTarget;
 
+	// Follows EnemyState, see FEnemyStateInfo::MovementStatus
 	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Movement")
 	EEnemyMovementStatus EnemyMovementStatus;
 
 	FORCEINLINE EEnemyMovementStatus GetEnemyMovementStatus() { return EnemyMovementStatus; }
-	FORCEINLINE void SetEnemyMovementStatus(EEnemyMovementStatus Status) { EnemyMovementStatus = Status; }
+
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "AI")
+	EEnemyState EnemyState;
+
+	FORCEINLINE EEnemyState GetEnemyState() const { return EnemyState; }
+
+	// Exits up to the parent shared with NewState, enters down into it and applies its row of the state table
+	void SetState(EEnemyState NewState);
+
+	// Actor and AI controller tick rate from the current state and significance bucket, whichever is slower
+	void RefreshTickRates();
 
 	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "AI")
 	class USphereComponent* AgroSphere;
@@ -43,50 +48,63 @@ public:
 	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "AI")
 	class AAIController* AIController;
 
-	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "AI")
-	float Health;
-
-	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "AI")
-	float MaxHealth;
+	// Tuning and assets shared by every enemy of this type, set once in the class defaults
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "AI")
+	class UEnemyArchetype* Archetype;
 
-	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "AI")
-	float Damage;
+	// Archetype, else the class defaults' one, else the archetype defaults
+	const UEnemyArchetype* GetArchetype() const;
 
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "AI")
-	class UParticleSystem* HitParticles;
+	float Health;
 
-	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "AI")
-	class USoundCue* HitSound;
+	UFUNCTION(BlueprintPure, Category = "AI")
+	float GetMaxHealth() const;
 
-	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "AI")
-	USoundCue* SwingSound;
+	// Reset to the archetype's MaxHealth on every spawn, Blueprints may still read and change it
+	UPROPERTY(VisibleAnywhere, BlueprintReadWrite, Category = "AI")
+	float MaxHealth;
 
 	UPROPERTY(VisibleAnywhere, BlueprintReadWrite, Category = "Combat")
 	class UBoxComponent* CombatCollision;
 
-	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Combat")
-	class UAnimMontage* CombatMontage;
+	FCombatTimerHandle AttackTimer;
+
+	FCombatTimerHandle DeathTimer;
 
-	FTimerHandle AttackTimer;
+	// Offsets from where the enemy was placed, walked in order while nothing has its attention
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "AI", meta = (MakeEditWidget = true))
+	TArray<FVector> PatrolPoints;
 
-	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Combat")
-	float AttackMinTime;
+	FCombatTimerHandle StaggerTimer;
 
-	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Combat")
-	float AttackMaxTime;
+	// Bucket assigned by UEnemySignificanceSubsystem, 0 is the most significant
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Significance")
+	int32 SignificanceBucket;
 
-	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Combat")
-	TSubclassOf<UDamageType> DamagetTypeClass;
+	// Distance to the player weighted by view direction, lower is more significant
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Significance")
+	float SignificanceScore;
 
-	FTimerHandle DeathTimer;
+	// Squad assigned by UEnemySquadSubsystem, INDEX_NONE when on its own
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Squad")
+	int32 SquadIndex;
 
-	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Combat")
-	float DeathDelay;
+	// Following the squad leader, the decision pass leaves it alone meanwhile
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Squad")
+	bool bInFormation;
 
 protected:
 	// Called when the game starts or when spawned
 	virtual void BeginPlay() override;
 
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+#if WITH_EDITOR
+	// Moves tuning saved before UEnemyArchetype into an archetype, kept once the asset is resaved
+	virtual void PostLoad() override;
+#endif
+
 public:	
 	// Called every frame
 	virtual void Tick(float DeltaTime) override;
@@ -104,32 +122,84 @@ public:
 	UFUNCTION()
 	virtual void CombatSphereOnOverlapEnd(UPrimitiveComponent* OverlappedComponent, AActor* OtherActor, UPrimitiveComponent* OtherComp, int32 OtherBodyIndex);
 
+	// Raised by the sphere overlaps above, or by UEnemyAggroSubsystem when the spheres are off.
+	// They only record what changed, UEnemyDecisionSubsystem decides what to do about it
+	void OnAggroEnter(class AMain* Main);
+	void OnAggroExit(AMain* Main);
+	void OnCombatRangeEnter(AMain* Main);
+	void OnCombatRangeExit(AMain* Main, bool bRemoveHealthBar);
+
+	// True when UEnemyAggroSubsystem replaces AgroSphere and CombatSphere for this enemy
+	bool bUseSpatialAggro;
+
 	UFUNCTION(BlueprintCallable)
 	void MoveToTarget(class AMain* Target);
 
+	// Stops moving and goes back to idle
+	void StopChasing();
+
+	// Heads for the next patrol point
+	void Patrol();
+
+	void Stagger();
+
+	void StaggerEnd();
+
+	// Passive enemies with nobody to fight are the only ones a noise can wake
+	bool CanHearNoise();
+
+	// Called by UEnemyHearingSubsystem with the closest noise heard this frame, walks over to look
+	void OnHeardNoise(const FVector& Location, AActor* Instigator);
+
+	// Transform PatrolPoints are relative to, where the enemy was placed or last acquired from the pool
+	FORCEINLINE const FTransform& GetPatrolOrigin() const { return PatrolOrigin; }
+	FORCEINLINE void SetPatrolOrigin(const FTransform& Origin) { PatrolOrigin = Origin; }
+
+	// Player this enemy knows about and goes after, set while it is inside aggro range
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "AI")
+	AMain* AggroTarget;
+
 	UPROPERTY(VisibleAnywhere, BlueprintReadWrite, Category = "AI")
 	bool bOverlappingCombatSphere;
 
 	UPROPERTY(VisibleAnywhere, BlueprintReadWrite, Category = "AI")
 	AMain* CombatTarget;
 
-	UFUNCTION()
-	void CombatOnOverlapBegin(UPrimitiveComponent* OverlappedComponent, AActor* OtherActor, UPrimitiveComponent* OtherComp, int32 OtherBodyIndex, bool bFromSweep, const FHitResult& SweepResult);
-
-	UFUNCTION()
-	void CombatOnOverlapEnd(UPrimitiveComponent* OverlappedComponent, AActor* OtherActor, UPrimitiveComponent* OtherComp, int32 OtherBodyIndex);
+	// Everything the swing cut through this frame, each target once per swing
+	void OnSwingHits(const TArray<FHitResult>& Hits);
 
+	// Starts sweeping CombatCollision, see UMeleeSwingSubsystem
 	UFUNCTION(BlueprintCallable)
 	void ActivateCollision();
 
 	UFUNCTION(BlueprintCallable)
 	void DeactivateCollision();
 
+	// Shoots the archetype's Projectile from the TipSocket at the combat target, the ranged counterpart of ActivateCollision for attack montages
+	UFUNCTION(BlueprintCallable)
+	void FireProjectile();
+
 	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Combat")
 	bool bAttacking;
 
 	void Attack();
 
+	// Starts the attack timer, or waits in place until the target hands out an attack token
+	void RequestAttack();
+
+	// Called by the target's UAttackTokenComponent once a queued request comes through
+	void OnAttackTokenGranted(AMain* Main);
+
+	// Gives the attack token back to, or leaves the queue of, CombatTarget
+	void ReleaseAttackToken();
+
+	void StartAttackTimer();
+
+	// Set by the attack timer, the next decision pass turns it into a swing
+	bool bAttackReady;
+
+	void OnAttackTimer();
+
 	UFUNCTION(BlueprintCallable)
 	void AttackEnd();
 
@@ -144,4 +214,74 @@ public:
 	bool Alive();
 
 	void Disappear();
+
+	// Restores a recycled enemy to its freshly spawned state
+	virtual void OnAcquiredFromPool() override;
+
+	virtual void OnReturnedToPool() override;
+
+private:
+
+	// Turns collision on and off the way the current state's row says
+	void ApplyStateComponents();
+
+	// Sizes AgroSphere and CombatSphere from the archetype
+	void ApplyArchetype();
+
+#if WITH_EDITORONLY_DATA
+	// Fills Type from the deprecated tuning
+	void CopyLegacyTuning(UEnemyArchetype* Type) const;
+
+	// True when the deprecated tuning says the same as Type, or as Other's
+	bool LegacyTuningMatches(const UEnemyArchetype* Type) const;
+	bool LegacyTuningMatches(const AEnemy* Other) const;
+
+	// Tuning from before UEnemyArchetype, only read by PostLoad in the editor
+	UPROPERTY()
+	float Damage_DEPRECATED;
+
+	UPROPERTY()
+	class UParticleSystem* HitParticles_DEPRECATED;
+
+	UPROPERTY()
+	class USoundCue* HitSound_DEPRECATED;
+
+	UPROPERTY()
+	USoundCue* SwingSound_DEPRECATED;
+
+	UPROPERTY()
+	class UAnimMontage* CombatMontage_DEPRECATED;
+
+	UPROPERTY()
+	float AttackMinTime_DEPRECATED;
+
+	UPROPERTY()
+	float AttackMaxTime_DEPRECATED;
+
+	UPROPERTY()
+	TSubclassOf<UDamageType> DamagetTypeClass_DEPRECATED;
+
+	UPROPERTY()
+	float DeathDelay_DEPRECATED;
+
+	UPROPERTY()
+	float PatrolAcceptanceRadius_DEPRECATED;
+
+	UPROPERTY()
+	float StaggerDuration_DEPRECATED;
+#endif
+
+	FTransform PatrolOrigin;
+	int32 PatrolIndex;
+
+	// Walking to a heard noise in ES_Patrol rather than to PatrolPoints[PatrolIndex]
+	bool bInvestigatingNoise;
+
+	FMeleeSwingHandle SwingHandle;
+
+	// CombatCollision between hit windows
+	FParkedComponent ParkedCombatCollision;
+
+	// Looked up once, hit effects and projectiles start here
+	const class USkeletalMeshSocket* TipSocket;
 };
\ No newline at end of file
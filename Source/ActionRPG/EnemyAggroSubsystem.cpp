@@ -0,0 +1,294 @@
+// Copyright by Hakan Akkurt
+
+
+#include "EnemyAggroSubsystem.h"
+#include "ActionRPG.h"
+#include "Enemy.h"
+#include "Main.h"
+#include "EnemyPerceptionSubsystem.h"
+#include "EnemySquadSubsystem.h"
+#include "Engine/World.h"
+#include "GameFramework/PlayerController.h"
+#include "Components/SphereComponent.h"
+#include "Components/CapsuleComponent.h"
+
+DECLARE_CYCLE_STAT(TEXT("Aggro Update"), STAT_AggroUpdate, STATGROUP_ActionRPG);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Aggro Distance Tests"), STAT_AggroDistanceTests, STATGROUP_ActionRPG);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Aggro Events"), STAT_AggroEvents, STATGROUP_ActionRPG);
+
+namespace
+{
+	enum class EAggroEvent : uint8
+	{
+		AggroEnter,
+		CombatEnter,
+		CombatExit,
+		AggroExit
+	};
+
+	struct FPendingAggroEvent
+	{
+		AEnemy* Enemy;
+		AMain* Main;
+		EAggroEvent Type;
+	};
+
+	struct FAggroCandidate
+	{
+		AMain* Main;
+		float Distance;
+	};
+}
+
+UEnemyAggroSubsystem::UEnemyAggroSubsystem()
+{
+	bReplaceOverlapSpheres = true;
+	CellSize = 1250.f;
+	MaxAggroRadius = 0.f;
+}
+
+bool UEnemyAggroSubsystem::ShouldCreateSubsystem(UObject* Outer) const
+{
+	UWorld* World = Cast<UWorld>(Outer);
+	return World && World->IsGameWorld();
+}
+
+void UEnemyAggroSubsystem::Deinitialize()
+{
+	Entries.Empty();
+	Grid.Empty();
+
+	Super::Deinitialize();
+}
+
+void UEnemyAggroSubsystem::RegisterEnemy(AEnemy* Enemy)
+{
+	if (!Enemy) return;
+
+	UnregisterEnemy(Enemy);
+
+	FAggroEntry& Entry = Entries.AddDefaulted_GetRef();
+	Entry.Enemy = Enemy;
+	Entry.AggroRadius = Enemy->AgroSphere->GetScaledSphereRadius();
+	Entry.CombatRadius = Enemy->CombatSphere->GetScaledSphereRadius();
+
+	MaxAggroRadius = FMath::Max3(MaxAggroRadius, Entry.AggroRadius, Entry.CombatRadius);
+}
+
+void UEnemyAggroSubsystem::UnregisterEnemy(AEnemy* Enemy)
+{
+	const int32 Index = Entries.IndexOfByPredicate([Enemy](const FAggroEntry& Entry) { return Entry.Enemy == Enemy; });
+	if (Index != INDEX_NONE) {
+
+		Entries.RemoveAtSwap(Index);
+	}
+
+	UEnemyPerceptionSubsystem* Perception = GetWorld()->GetSubsystem<UEnemyPerceptionSubsystem>();
+	if (Perception) {
+
+		Perception->ForgetEnemy(Enemy);
+	}
+}
+
+void UEnemyAggroSubsystem::ClearEnemyRange(AEnemy* Enemy)
+{
+	FAggroEntry* Entry = Entries.FindByPredicate([Enemy](const FAggroEntry& Candidate) { return Candidate.Enemy == Enemy; });
+	if (!Entry) return;
+
+	const bool bWasInCombatRange = Entry->bInCombatRange;
+	const bool bWasInAggroRange = Entry->bInAggroRange;
+	AMain* OldTarget = Entry->Target.Get();
+
+	// Committed before the callbacks, they look for a new combat target
+	Entry->bInAggroRange = false;
+	Entry->bInCombatRange = false;
+	Entry->Target = nullptr;
+
+	if (!OldTarget) return;
+
+	if (bWasInCombatRange) {
+
+		Enemy->OnCombatRangeExit(OldTarget, true);
+	}
+	if (bWasInAggroRange) {
+
+		Enemy->OnAggroExit(OldTarget);
+	}
+}
+
+void UEnemyAggroSubsystem::GetEnemiesInRange(const AMain* Main, TArray<AActor*>& OutEnemies, TSubclassOf<AEnemy> Filter) const
+{
+	for (const FAggroEntry& Entry : Entries) {
+
+		if ((Entry.bInAggroRange || Entry.bInCombatRange) && Entry.Target.Get() == Main && Entry.Enemy && Entry.Enemy->Alive()) {
+
+			if (!Filter || Entry.Enemy->IsA(Filter)) {
+
+				OutEnemies.Add(Entry.Enemy);
+			}
+		}
+	}
+}
+
+bool UEnemyAggroSubsystem::IsTickable() const
+{
+	return !IsTemplate() && bReplaceOverlapSpheres && Entries.Num() > 0;
+}
+
+ETickableTickType UEnemyAggroSubsystem::GetTickableTickType() const
+{
+	return IsTemplate() ? ETickableTickType::Never : ETickableTickType::Conditional;
+}
+
+TStatId UEnemyAggroSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UEnemyAggroSubsystem, STATGROUP_Tickables);
+}
+
+void UEnemyAggroSubsystem::Tick(float DeltaTime)
+{
+	SCOPE_CYCLE_COUNTER(STAT_AggroUpdate);
+
+	UWorld* World = GetWorld();
+
+	// Hash every living enemy into its cell
+	Grid.Reset();
+	for (int32 Index = 0; Index < Entries.Num(); ++Index) {
+
+		AEnemy* Enemy = Entries[Index].Enemy;
+		if (Enemy && Enemy->Alive()) {
+
+			Grid.FindOrAdd(GetCell(Enemy->GetActorLocation())).Add(Index);
+		}
+	}
+
+	// Each player only looks at the cells its largest aggro radius can reach
+	TArray<FAggroCandidate> Candidates;
+	Candidates.SetNumZeroed(Entries.Num());
+
+	int32 DistanceTests = 0;
+
+	for (FConstPlayerControllerIterator It = World->GetPlayerControllerIterator(); It; ++It) {
+
+		AMain* Main = (*It).IsValid() ? Cast<AMain>((*It)->GetPawn()) : nullptr;
+		if (!Main) continue;
+
+		const FVector PlayerLocation = Main->GetActorLocation();
+		const float PlayerRadius = Main->GetCapsuleComponent()->GetScaledCapsuleRadius();
+		const FIntPoint PlayerCell = GetCell(PlayerLocation);
+
+		// Distances are measured to the capsule's edge, so the reach covers its radius too
+		const int32 CellReach = FMath::CeilToInt((MaxAggroRadius + PlayerRadius) / CellSize);
+
+		for (int32 X = PlayerCell.X - CellReach; X <= PlayerCell.X + CellReach; ++X) {
+
+			for (int32 Y = PlayerCell.Y - CellReach; Y <= PlayerCell.Y + CellReach; ++Y) {
+
+				const TArray<int32>* Cell = Grid.Find(FIntPoint(X, Y));
+				if (!Cell) continue;
+
+				for (int32 Index : *Cell) {
+
+					++DistanceTests;
+
+					// Spheres overlapped as soon as they touched the capsule
+					const float Distance = FVector::Dist(Entries[Index].Enemy->GetActorLocation(), PlayerLocation) - PlayerRadius;
+
+					FAggroCandidate& Candidate = Candidates[Index];
+					if (!Candidate.Main || Distance < Candidate.Distance) {
+
+						Candidate.Main = Main;
+						Candidate.Distance = Distance;
+					}
+				}
+			}
+		}
+	}
+
+	// Diff against last frame, state is committed before any callback runs so queries from them see it
+	TArray<FPendingAggroEvent> Events;
+
+	UEnemyPerceptionSubsystem* Perception = World->GetSubsystem<UEnemyPerceptionSubsystem>();
+	UEnemySquadSubsystem* Squads = World->GetSubsystem<UEnemySquadSubsystem>();
+
+	for (int32 Index = 0; Index < Entries.Num(); ++Index) {
+
+		FAggroEntry& Entry = Entries[Index];
+		if (!Entry.Enemy) continue;
+
+		if (!Entry.Enemy->Alive()) {
+
+			// Die() used to switch the spheres off, dead enemies just drop out
+			Entry.bInAggroRange = false;
+			Entry.bInCombatRange = false;
+			Entry.Target = nullptr;
+			continue;
+		}
+
+		const FAggroCandidate& Candidate = Candidates[Index];
+		const bool bInAggroRadius = Candidate.Main && Candidate.Distance <= Entry.AggroRadius;
+		const bool bInCombatRadius = Candidate.Main && Candidate.Distance <= Entry.CombatRadius;
+
+		// A player has to be seen once to be engaged, after that the enemy keeps track of them behind cover
+		// Squad members trust their leader's eyes and skip their own sight check
+		bool bPerceived = bInAggroRadius || bInCombatRadius;
+		const bool bSquadSeesTarget = Squads && Squads->GetSquadTarget(Entry.Enemy) == Candidate.Main;
+		if (bPerceived && Perception && !bSquadSeesTarget && Entry.Target.Get() != Candidate.Main) {
+
+			Perception->RequestLineOfSight(Entry.Enemy, Candidate.Main);
+			bPerceived = Perception->HasLineOfSight(Entry.Enemy, Candidate.Main);
+		}
+
+		const bool bAggro = bInAggroRadius && bPerceived;
+		const bool bCombat = bInCombatRadius && bPerceived;
+		AMain* OldTarget = Entry.Target.Get();
+		AMain* NewTarget = (bAggro || bCombat) ? Candidate.Main : nullptr;
+
+		const bool bTargetChanged = OldTarget != NewTarget;
+
+		if (Entry.bInCombatRange && (!bCombat || bTargetChanged) && OldTarget) {
+
+			Events.Add({ Entry.Enemy, OldTarget, EAggroEvent::CombatExit });
+		}
+		if (Entry.bInAggroRange && (!bAggro || bTargetChanged) && OldTarget) {
+
+			Events.Add({ Entry.Enemy, OldTarget, EAggroEvent::AggroExit });
+		}
+		if (bAggro && (!Entry.bInAggroRange || bTargetChanged)) {
+
+			Events.Add({ Entry.Enemy, NewTarget, EAggroEvent::AggroEnter });
+		}
+		if (bCombat && (!Entry.bInCombatRange || bTargetChanged)) {
+
+			Events.Add({ Entry.Enemy, NewTarget, EAggroEvent::CombatEnter });
+		}
+
+		Entry.bInAggroRange = bAggro;
+		Entry.bInCombatRange = bCombat;
+		Entry.Target = NewTarget;
+	}
+
+	for (const FPendingAggroEvent& Event : Events) {
+
+		switch (Event.Type) {
+
+		case EAggroEvent::AggroEnter:
+			Event.Enemy->OnAggroEnter(Event.Main);
+			break;
+		case EAggroEvent::CombatEnter:
+			Event.Enemy->OnCombatRangeEnter(Event.Main);
+			break;
+		case EAggroEvent::CombatExit:
+			Event.Enemy->OnCombatRangeExit(Event.Main, true);
+			break;
+		case EAggroEvent::AggroExit:
+			Event.Enemy->OnAggroExit(Event.Main);
+			break;
+		default:
+			;
+		}
+	}
+
+	SET_DWORD_STAT(STAT_AggroDistanceTests, DistanceTests);
+	SET_DWORD_STAT(STAT_AggroEvents, Events.Num());
+}
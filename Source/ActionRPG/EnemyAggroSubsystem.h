@@ -0,0 +1,84 @@
+// Copyright by Hakan Akkurt
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "Tickable.h"
+#include "EnemyAggroSubsystem.generated.h"
+
+USTRUCT()
+struct FAggroEntry
+{
+	GENERATED_BODY()
+
+	UPROPERTY()
+	class AEnemy* Enemy = nullptr;
+
+	// Taken from the enemy's AgroSphere and CombatSphere so Blueprint tuning still applies
+	float AggroRadius = 0.f;
+	float CombatRadius = 0.f;
+
+	bool bInAggroRange = false;
+	bool bInCombatRange = false;
+
+	TWeakObjectPtr<class AMain> Target;
+};
+
+/**
+ * Hashes enemy positions into a uniform grid once per frame and tests them against the players,
+ * raising the same aggro and combat range events the AgroSphere and CombatSphere overlaps used to.
+ * With bReplaceOverlapSpheres set the enemies switch both spheres off entirely.
+ */
+UCLASS(Config = Game)
+class ACTIONRPG_API UEnemyAggroSubsystem : public UWorldSubsystem, public FTickableGameObject
+{
+	GENERATED_BODY()
+
+public:
+
+	UEnemyAggroSubsystem();
+
+	UPROPERTY(Config, EditAnywhere, BlueprintReadOnly, Category = "Aggro")
+	bool bReplaceOverlapSpheres;
+
+	// Should be around the largest aggro radius so a query touches few cells
+	UPROPERTY(Config, EditAnywhere, BlueprintReadOnly, Category = "Aggro")
+	float CellSize;
+
+	void RegisterEnemy(AEnemy* Enemy);
+
+	void UnregisterEnemy(AEnemy* Enemy);
+
+	// Takes a dying enemy out of range now and raises its exit events, instead of waiting for the next tick
+	void ClearEnemyRange(AEnemy* Enemy);
+
+	// Living enemies currently in aggro or combat range of Main, what GetOverlappingActors returned with the spheres on
+	void GetEnemiesInRange(const AMain* Main, TArray<AActor*>& OutEnemies, TSubclassOf<AEnemy> Filter = nullptr) const;
+
+	virtual bool ShouldCreateSubsystem(UObject* Outer) const override;
+
+	virtual void Deinitialize() override;
+
+	// FTickableGameObject
+	virtual void Tick(float DeltaTime) override;
+	virtual bool IsTickable() const override;
+	virtual ETickableTickType GetTickableTickType() const override;
+	virtual TStatId GetStatId() const override;
+	virtual UWorld* GetTickableGameObjectWorld() const override { return GetWorld(); }
+
+private:
+
+	FORCEINLINE FIntPoint GetCell(const FVector& Location) const
+	{
+		return FIntPoint(FMath::FloorToInt(Location.X / CellSize), FMath::FloorToInt(Location.Y / CellSize));
+	}
+
+	UPROPERTY()
+	TArray<FAggroEntry> Entries;
+
+	// Rebuilt every tick, cell to indices into Entries
+	TMap<FIntPoint, TArray<int32>> Grid;
+
+	float MaxAggroRadius;
+};
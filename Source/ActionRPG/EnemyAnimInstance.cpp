@@ -2,7 +2,73 @@
 
 
 #include "EnemyAnimInstance.h"
+#include "ActionRPG.h"
 #include "Enemy.h"
+#include "ActorPoolSubsystem.h"
+#include "Engine/World.h"
+#include "Kismet/GameplayStatics.h"
+#include "Containers/Ticker.h"
+#include "HAL/ThreadSafeCounter64.h"
+
+DECLARE_CYCLE_STAT(TEXT("Enemy Anim Update Game Thread"), STAT_EnemyAnimGameThread, STATGROUP_ActionRPG);
+DECLARE_CYCLE_STAT(TEXT("Enemy Anim Update Worker"), STAT_EnemyAnimWorker, STATGROUP_ActionRPG);
+
+namespace
+{
+	// Running totals for ActionRPG.Anim.Benchmark, the game thread one is only touched from the game thread
+	uint64 EnemyAnimGameThreadCycles = 0;
+	FThreadSafeCounter64 EnemyAnimWorkerCycles;
+
+	struct FScopedGameThreadCycles
+	{
+		FScopedGameThreadCycles() : StartCycles(FPlatformTime::Cycles64()) {}
+		~FScopedGameThreadCycles() { EnemyAnimGameThreadCycles += FPlatformTime::Cycles64() - StartCycles; }
+
+		uint64 StartCycles;
+	};
+}
+
+void FEnemyAnimInstanceProxy::PreUpdate(UAnimInstance* InAnimInstance, float DeltaSeconds)
+{
+	SCOPE_CYCLE_COUNTER(STAT_EnemyAnimGameThread);
+	FScopedGameThreadCycles GameThreadCycles;
+
+	FAnimInstanceProxy::PreUpdate(InAnimInstance, DeltaSeconds);
+
+	UEnemyAnimInstance* Instance = CastChecked<UEnemyAnimInstance>(InAnimInstance);
+	bHasPawn = Instance->Pawn && CVarThreadSafeAnimUpdate.GetValueOnGameThread() != 0;
+
+	if (bHasPawn) {
+
+		Velocity = Instance->Pawn->GetVelocity();
+	}
+}
+
+void FEnemyAnimInstanceProxy::Update(float DeltaSeconds)
+{
+	SCOPE_CYCLE_COUNTER(STAT_EnemyAnimWorker);
+	const uint64 StartCycles = FPlatformTime::Cycles64();
+
+	FAnimInstanceProxy::Update(DeltaSeconds);
+
+	if (bHasPawn) {
+
+		MovementSpeed = Velocity.Size2D();
+	}
+
+	EnemyAnimWorkerCycles.Add(FPlatformTime::Cycles64() - StartCycles);
+}
+
+void FEnemyAnimInstanceProxy::PostUpdate(UAnimInstance* InAnimInstance) const
+{
+	FAnimInstanceProxy::PostUpdate(InAnimInstance);
+
+	// Back on the game thread, where Blueprints read the instance
+	if (bHasPawn) {
+
+		CastChecked<UEnemyAnimInstance>(InAnimInstance)->MovementSpeed = MovementSpeed;
+	}
+}
 
 void UEnemyAnimInstance::NativeInitializeAnimation()
 {
@@ -16,9 +82,33 @@ void UEnemyAnimInstance::NativeInitializeAnimation()
 	}
 }
 
+void UEnemyAnimInstance::NativeUpdateAnimation(float DeltaSeconds)
+{
+	Super::NativeUpdateAnimation(DeltaSeconds);
+
+	// Pooled or late possessed enemies may have had no pawn at initialization, the next PreUpdate picks it up
+	if (Pawn == nullptr) {
+
+		Pawn = TryGetPawnOwner();
+		if (Pawn) {
+
+			Enemy = Cast<AEnemy>(Pawn);
+		}
+	}
+}
+
+FAnimInstanceProxy* UEnemyAnimInstance::CreateAnimInstanceProxy()
+{
+	return new FEnemyAnimInstanceProxy(this);
+}
 
 void UEnemyAnimInstance::UpdateAnimationProperties()
 {
+	if (CVarThreadSafeAnimUpdate.GetValueOnGameThread() != 0) return;
+
+	SCOPE_CYCLE_COUNTER(STAT_EnemyAnimGameThread);
+	FScopedGameThreadCycles GameThreadCycles;
+
 	if (Pawn == nullptr) {
 
 		Pawn = TryGetPawnOwner();
@@ -35,3 +125,87 @@ void UEnemyAnimInstance::UpdateAnimationProperties()
 		MovementSpeed = LateralSpeed.Size();
 	}
 }
+
+// ActionRPG.Anim.Benchmark Class [Count] [Frames]
+// Spawns Count enemies of Class around the player, runs Frames frames on the game thread update path and Frames on
+// the thread-safe one, then logs the enemy anim update time per frame for both. Class needs an AnimBP built on
+// UEnemyAnimInstance that still calls UpdateAnimationProperties, otherwise the game thread pass has nothing to time.
+static FAutoConsoleCommandWithWorldAndArgs AnimBenchmarkCommand(
+	TEXT("ActionRPG.Anim.Benchmark"),
+	TEXT("Compares game thread enemy anim update cost with and without the thread-safe path. Usage: ActionRPG.Anim.Benchmark Class [Count] [Frames]"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateStatic([](const TArray<FString>& Args, UWorld* World)
+	{
+		UActorPoolSubsystem* ActorPool = World ? World->GetSubsystem<UActorPoolSubsystem>() : nullptr;
+		APawn* PlayerPawn = World ? UGameplayStatics::GetPlayerPawn(World, 0) : nullptr;
+		UClass* Class = Args.Num() > 0 ? LoadClass<AEnemy>(nullptr, *Args[0]) : nullptr;
+
+		if (!ActorPool || !PlayerPawn || !Class) {
+
+			UE_LOG(LogActionRPG, Warning, TEXT("ActionRPG.Anim.Benchmark needs a player and an enemy class"));
+			return;
+		}
+
+		const int32 Count = Args.Num() > 1 ? FCString::Atoi(*Args[1]) : 100;
+		const int32 Frames = FMath::Max(1, Args.Num() > 2 ? FCString::Atoi(*Args[2]) : 120);
+
+		struct FAnimBenchmark
+		{
+			TArray<TWeakObjectPtr<AActor>> Enemies;
+			int32 Frames = 0;
+			int32 Frame = 0;
+			int32 PreviousMode = 1;
+			uint64 GameThreadCycles[2] = { 0, 0 };
+			int64 WorkerCycles[2] = { 0, 0 };
+		};
+
+		TSharedRef<FAnimBenchmark> Benchmark = MakeShared<FAnimBenchmark>();
+		Benchmark->Frames = Frames;
+		Benchmark->PreviousMode = CVarThreadSafeAnimUpdate.GetValueOnGameThread();
+
+		// Rings around the player so every enemy is on screen and animating
+		const FVector Center = PlayerPawn->GetActorLocation();
+		for (int32 i = 0; i < Count; ++i) {
+
+			const float Angle = 2.f * PI * i / FMath::Max(1, Count);
+			const FVector Location = Center + FVector(FMath::Cos(Angle), FMath::Sin(Angle), 0.f) * (600.f + 150.f * (i % 6));
+			Benchmark->Enemies.Add(ActorPool->AcquireActor(Class, FTransform(Location)));
+		}
+
+		CVarThreadSafeAnimUpdate.AsVariable()->Set(0, ECVF_SetByCode);
+		EnemyAnimGameThreadCycles = 0;
+		EnemyAnimWorkerCycles.Set(0);
+
+		FTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateLambda([Benchmark](float DeltaTime)
+		{
+			// First half runs on the game thread path, second half on the thread-safe one
+			const int32 Pass = Benchmark->Frame < Benchmark->Frames ? 0 : 1;
+			Benchmark->GameThreadCycles[Pass] += EnemyAnimGameThreadCycles;
+			Benchmark->WorkerCycles[Pass] += EnemyAnimWorkerCycles.Set(0);
+			EnemyAnimGameThreadCycles = 0;
+
+			++Benchmark->Frame;
+			if (Benchmark->Frame == Benchmark->Frames) {
+
+				CVarThreadSafeAnimUpdate.AsVariable()->Set(1, ECVF_SetByCode);
+			}
+			if (Benchmark->Frame < Benchmark->Frames * 2) return true;
+
+			CVarThreadSafeAnimUpdate.AsVariable()->Set(Benchmark->PreviousMode, ECVF_SetByCode);
+
+			for (const TWeakObjectPtr<AActor>& Enemy : Benchmark->Enemies) {
+
+				if (Enemy.IsValid()) {
+
+					UActorPoolSubsystem::ReleaseOrDestroy(Enemy.Get());
+				}
+			}
+
+			const double MsPerCycle = FPlatformTime::GetSecondsPerCycle64() * 1000.0 / Benchmark->Frames;
+			UE_LOG(LogActionRPG, Log, TEXT("Anim benchmark %d enemies: game thread %.3f ms/frame before, %.3f ms/frame after (+%.3f ms/frame on workers)"),
+				Benchmark->Enemies.Num(),
+				Benchmark->GameThreadCycles[0] * MsPerCycle,
+				Benchmark->GameThreadCycles[1] * MsPerCycle,
+				Benchmark->WorkerCycles[1] * MsPerCycle);
+			return false;
+		}));
+	}));
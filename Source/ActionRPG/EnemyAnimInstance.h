@@ -4,10 +4,47 @@
 
 #include "CoreMinimal.h"
 #include "Animation/AnimInstance.h"
+#include "Animation/AnimInstanceProxy.h"
 #include "EnemyAnimInstance.generated.h"
 
+// Copies what the update needs off the pawn on the game thread, the rest runs on the animation worker
+struct FEnemyAnimInstanceProxy : public FAnimInstanceProxy
+{
+	FEnemyAnimInstanceProxy()
+		: Velocity(ForceInitToZero)
+		, bHasPawn(false)
+		, MovementSpeed(0.f)
+	{
+	}
+
+	FEnemyAnimInstanceProxy(UAnimInstance* InAnimInstance)
+		: FAnimInstanceProxy(InAnimInstance)
+		, Velocity(ForceInitToZero)
+		, bHasPawn(false)
+		, MovementSpeed(0.f)
+	{
+	}
+
+protected:
+
+	virtual void PreUpdate(UAnimInstance* InAnimInstance, float DeltaSeconds) override;
+
+	virtual void Update(float DeltaSeconds) override;
+
+	virtual void PostUpdate(UAnimInstance* InAnimInstance) const override;
+
+private:
+
+	FVector Velocity;
+	bool bHasPawn;
+
+	// Worked out on the worker, handed to the instance on the game thread in PostUpdate
+	float MovementSpeed;
+};
+
 /**
- * 
+ * Movement properties are filled in natively after each animation update, so the AnimBP can read them
+ * through fast-path property access and no longer needs to call UpdateAnimationProperties.
  */
 UCLASS()
 class ACTIONRPG_API UEnemyAnimInstance : public UAnimInstance
@@ -18,6 +55,9 @@ public:
 
 	virtual void NativeInitializeAnimation() override;
 
+	virtual void NativeUpdateAnimation(float DeltaSeconds) override;
+
+	// Only does work with ActionRPG.Anim.ThreadSafeUpdate 0, the native update covers it otherwise
 	UFUNCTION(BlueprintCallable, Category = AnimationProperties)
 	void UpdateAnimationProperties();
 
@@ -30,5 +70,7 @@ public:
 	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = Movement)
 	class AEnemy* Enemy;
 
-	
+protected:
+
+	virtual FAnimInstanceProxy* CreateAnimInstanceProxy() override;
 };
@@ -0,0 +1,25 @@
+// Copyright by Hakan Akkurt
+
+
+#include "EnemyArchetype.h"
+
+UEnemyArchetype::UEnemyArchetype()
+{
+	MaxHealth = 100.f;
+	Damage = 10.f;
+
+	AttackMinTime = 0.5f;
+	AttackMaxTime = 1.25f;
+
+	StaggerDuration = 0.f;
+	DeathDelay = 3.f;
+
+	AggroRadius = 1250.f;
+	CombatRadius = 75.f;
+	PatrolAcceptanceRadius = 50.f;
+
+	CombatMontage = nullptr;
+	HitParticles = nullptr;
+	HitSound = nullptr;
+	SwingSound = nullptr;
+}
@@ -0,0 +1,74 @@
+// Copyright by Hakan Akkurt
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Engine/DataAsset.h"
+#include "ProjectileSubsystem.h"
+#include "EnemyArchetype.generated.h"
+
+/**
+ * Tuning and asset references shared by every enemy of one type. Enemy classes point at one archetype
+ * from their defaults, so it is loaded with the class and never copied into the instances; those only
+ * keep what changes while they are alive.
+ */
+UCLASS(BlueprintType)
+class ACTIONRPG_API UEnemyArchetype : public UPrimaryDataAsset
+{
+	GENERATED_BODY()
+
+public:
+
+	UEnemyArchetype();
+
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "Stats")
+	float MaxHealth;
+
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "Combat")
+	float Damage;
+
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "Combat")
+	TSubclassOf<UDamageType> DamageTypeClass;
+
+	// The next attack comes a random time between these after the last one
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "Combat")
+	float AttackMinTime;
+
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "Combat")
+	float AttackMaxTime;
+
+	// How long a hit interrupts the enemy, 0 means hits never stagger
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "Combat")
+	float StaggerDuration;
+
+	// How long the body stays around after the death animation
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "Combat")
+	float DeathDelay;
+
+	// Radius of the AgroSphere, also used by the spatial aggro pass
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "AI")
+	float AggroRadius;
+
+	// Radius of the CombatSphere, ranged enemies want it wide
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "AI")
+	float CombatRadius;
+
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "AI")
+	float PatrolAcceptanceRadius;
+
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "Combat")
+	class UAnimMontage* CombatMontage;
+
+	// Launched by AEnemy::FireProjectile
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "Combat")
+	FProjectileParams Projectile;
+
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "FX")
+	class UParticleSystem* HitParticles;
+
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "FX")
+	class USoundCue* HitSound;
+
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "FX")
+	USoundCue* SwingSound;
+};
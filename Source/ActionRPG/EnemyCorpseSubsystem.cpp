@@ -0,0 +1,190 @@
+// Copyright by Hakan Akkurt
+
+
+#include "EnemyCorpseSubsystem.h"
+#include "ActionRPG.h"
+#include "Enemy.h"
+#include "EnemyArchetype.h"
+#include "Engine/World.h"
+#include "GameFramework/PlayerController.h"
+#include "Components/PoseableMeshComponent.h"
+#include "Components/SkeletalMeshComponent.h"
+
+DECLARE_DWORD_COUNTER_STAT(TEXT("Corpses"), STAT_Corpses, STATGROUP_ActionRPG);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Corpse Evictions"), STAT_CorpseEvictions, STATGROUP_ActionRPG);
+
+UEnemyCorpseSubsystem::UEnemyCorpseSubsystem()
+{
+	MaxCorpses = 24;
+	EvictDistance = 6000.f;
+
+	ProxyOwner = nullptr;
+}
+
+bool UEnemyCorpseSubsystem::ShouldCreateSubsystem(UObject* Outer) const
+{
+	UWorld* World = Cast<UWorld>(Outer);
+	return World && World->IsGameWorld();
+}
+
+void UEnemyCorpseSubsystem::Deinitialize()
+{
+	Corpses.Empty();
+	FreeProxies.Empty();
+	ProxyOwner = nullptr;
+
+	Super::Deinitialize();
+}
+
+bool UEnemyCorpseSubsystem::AddCorpse(AEnemy* Enemy)
+{
+	if (!Enemy || MaxCorpses <= 0) return false;
+
+	USkeletalMeshComponent* Mesh = Enemy->GetMesh();
+	if (!Mesh || !Mesh->SkeletalMesh) return false;
+
+	// Make room first so the new corpse is never the one evicted
+	TrimTo(MaxCorpses - 1);
+
+	UPoseableMeshComponent* Proxy = AcquireProxy();
+	if (!Proxy) return false;
+
+	Proxy->SetSkeletalMesh(Mesh->SkeletalMesh);
+	Proxy->EmptyOverrideMaterials();
+	for (int32 MaterialIndex = 0; MaterialIndex < Mesh->GetNumMaterials(); ++MaterialIndex) {
+
+		Proxy->SetMaterial(MaterialIndex, Mesh->GetMaterial(MaterialIndex));
+	}
+
+	Proxy->SetWorldTransform(Mesh->GetComponentTransform());
+	Proxy->CopyPoseFromSkeletalComponent(Mesh);
+	Proxy->RefreshBoneTransforms();
+	Proxy->SetCastShadow(Mesh->CastShadow);
+	Proxy->SetVisibility(true);
+
+	FEnemyCorpse& Corpse = Corpses.AddDefaulted_GetRef();
+	Corpse.Proxy = Proxy;
+	Corpse.Lifetime = Enemy->GetArchetype()->DeathDelay;
+
+	return true;
+}
+
+UPoseableMeshComponent* UEnemyCorpseSubsystem::AcquireProxy()
+{
+	if (FreeProxies.Num() > 0) {
+
+		return FreeProxies.Pop(false);
+	}
+
+	if (!ProxyOwner) {
+
+		FActorSpawnParameters SpawnParams;
+		SpawnParams.Name = TEXT("EnemyCorpses");
+		SpawnParams.ObjectFlags |= RF_Transient;
+
+		ProxyOwner = GetWorld()->SpawnActor<AActor>(AActor::StaticClass(), FTransform::Identity, SpawnParams);
+		if (!ProxyOwner) return nullptr;
+	}
+
+	// Proxies never tick, collide or animate, they only hold the copied bone transforms
+	UPoseableMeshComponent* Proxy = NewObject<UPoseableMeshComponent>(ProxyOwner);
+	Proxy->PrimaryComponentTick.bCanEverTick = false;
+	Proxy->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+	Proxy->SetGenerateOverlapEvents(false);
+	Proxy->SetCanEverAffectNavigation(false);
+	Proxy->RegisterComponent();
+	ProxyOwner->AddInstanceComponent(Proxy);
+
+	return Proxy;
+}
+
+void UEnemyCorpseSubsystem::EvictCorpse(int32 Index)
+{
+	UPoseableMeshComponent* Proxy = Corpses[Index].Proxy;
+	if (Proxy) {
+
+		Proxy->SetVisibility(false);
+		FreeProxies.Add(Proxy);
+	}
+
+	Corpses.RemoveAtSwap(Index);
+	INC_DWORD_STAT(STAT_CorpseEvictions);
+}
+
+void UEnemyCorpseSubsystem::TrimTo(int32 Count)
+{
+	while (Corpses.Num() > FMath::Max(Count, 0)) {
+
+		// Old corpses far from the player are the least likely to be missed
+		int32 Worst = INDEX_NONE;
+		float WorstScore = -1.f;
+
+		for (int32 Index = 0; Index < Corpses.Num(); ++Index) {
+
+			const FEnemyCorpse& Corpse = Corpses[Index];
+			const float Distance = Corpse.Proxy ? GetDistanceToPlayers(Corpse.Proxy->GetComponentLocation()) : MAX_flt;
+			const float Score = Corpse.Age / FMath::Max(Corpse.Lifetime, KINDA_SMALL_NUMBER) + Distance / FMath::Max(EvictDistance, 1.f);
+
+			if (Score > WorstScore) {
+
+				Worst = Index;
+				WorstScore = Score;
+			}
+		}
+
+		EvictCorpse(Worst);
+	}
+}
+
+float UEnemyCorpseSubsystem::GetDistanceToPlayers(const FVector& Location) const
+{
+	float Distance = MAX_flt;
+
+	for (FConstPlayerControllerIterator It = GetWorld()->GetPlayerControllerIterator(); It; ++It) {
+
+		APawn* Pawn = (*It).IsValid() ? (*It)->GetPawn() : nullptr;
+		if (Pawn) {
+
+			Distance = FMath::Min(Distance, FVector::Dist(Location, Pawn->GetActorLocation()));
+		}
+	}
+	return Distance;
+}
+
+bool UEnemyCorpseSubsystem::IsTickable() const
+{
+	return !IsTemplate() && Corpses.Num() > 0;
+}
+
+ETickableTickType UEnemyCorpseSubsystem::GetTickableTickType() const
+{
+	return IsTemplate() ? ETickableTickType::Never : ETickableTickType::Conditional;
+}
+
+TStatId UEnemyCorpseSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UEnemyCorpseSubsystem, STATGROUP_Tickables);
+}
+
+void UEnemyCorpseSubsystem::Tick(float DeltaTime)
+{
+	for (int32 Index = Corpses.Num() - 1; Index >= 0; --Index) {
+
+		FEnemyCorpse& Corpse = Corpses[Index];
+		Corpse.Age += DeltaTime;
+
+		// Without a player pawn there is nothing to measure against, only age counts then
+		const float Distance = Corpse.Proxy ? GetDistanceToPlayers(Corpse.Proxy->GetComponentLocation()) : MAX_flt;
+		const bool bTooFar = Distance != MAX_flt && Distance > EvictDistance;
+
+		if (!Corpse.Proxy || Corpse.Age >= Corpse.Lifetime || bTooFar) {
+
+			EvictCorpse(Index);
+		}
+	}
+
+	// MaxCorpses can be lowered at runtime
+	TrimTo(MaxCorpses);
+
+	SET_DWORD_STAT(STAT_Corpses, Corpses.Num());
+}
@@ -0,0 +1,83 @@
+// Copyright by Hakan Akkurt
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "Tickable.h"
+#include "EnemyCorpseSubsystem.generated.h"
+
+USTRUCT()
+struct FEnemyCorpse
+{
+	GENERATED_BODY()
+
+	UPROPERTY()
+	class UPoseableMeshComponent* Proxy = nullptr;
+
+	float Age = 0.f;
+
+	// The dead enemy's archetype DeathDelay, the corpse used to stay this long
+	float Lifetime = 0.f;
+};
+
+/**
+ * Takes over dead enemies once their death animation has frozen. The final pose is copied onto a
+ * poseable mesh that nothing ticks or animates, and the enemy itself goes straight back to the actor pool.
+ * Corpses expire after their DeathDelay, or earlier once there are more than MaxCorpses or the
+ * player has moved far away from them.
+ */
+UCLASS(Config = Game)
+class ACTIONRPG_API UEnemyCorpseSubsystem : public UWorldSubsystem, public FTickableGameObject
+{
+	GENERATED_BODY()
+
+public:
+
+	UEnemyCorpseSubsystem();
+
+	UPROPERTY(Config, EditAnywhere, BlueprintReadOnly, Category = "Corpses")
+	int32 MaxCorpses;
+
+	// Corpses further than this from every player are removed
+	UPROPERTY(Config, EditAnywhere, BlueprintReadOnly, Category = "Corpses")
+	float EvictDistance;
+
+	// Replaces Enemy with a static copy of its current pose, false when the enemy has to keep its own corpse
+	bool AddCorpse(class AEnemy* Enemy);
+
+	UFUNCTION(BlueprintPure, Category = "Corpses")
+	int32 GetNumCorpses() const { return Corpses.Num(); }
+
+	virtual bool ShouldCreateSubsystem(UObject* Outer) const override;
+
+	virtual void Deinitialize() override;
+
+	// FTickableGameObject
+	virtual void Tick(float DeltaTime) override;
+	virtual bool IsTickable() const override;
+	virtual ETickableTickType GetTickableTickType() const override;
+	virtual TStatId GetStatId() const override;
+	virtual UWorld* GetTickableGameObjectWorld() const override { return GetWorld(); }
+
+private:
+
+	UPoseableMeshComponent* AcquireProxy();
+
+	void EvictCorpse(int32 Index);
+
+	// Evicts the corpses that are oldest and furthest away until at most Count are left
+	void TrimTo(int32 Count);
+
+	float GetDistanceToPlayers(const FVector& Location) const;
+
+	UPROPERTY()
+	TArray<FEnemyCorpse> Corpses;
+
+	UPROPERTY()
+	TArray<UPoseableMeshComponent*> FreeProxies;
+
+	// Owns every proxy component, spawned with the first corpse
+	UPROPERTY()
+	AActor* ProxyOwner;
+};
@@ -0,0 +1,235 @@
+// Copyright by Hakan Akkurt
+
+
+#include "EnemyDecisionSubsystem.h"
+#include "ActionRPG.h"
+#include "Main.h"
+#include "EnemySquadSubsystem.h"
+#include "Engine/World.h"
+#include "Async/ParallelFor.h"
+#include "HAL/IConsoleManager.h"
+
+DECLARE_CYCLE_STAT(TEXT("Decision Gather"), STAT_DecisionGather, STATGROUP_ActionRPG);
+DECLARE_CYCLE_STAT(TEXT("Decision Evaluate"), STAT_DecisionEvaluate, STATGROUP_ActionRPG);
+DECLARE_CYCLE_STAT(TEXT("Decision Apply"), STAT_DecisionApply, STATGROUP_ActionRPG);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Decision Enemies"), STAT_DecisionEnemies, STATGROUP_ActionRPG);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Decision Intents"), STAT_DecisionIntents, STATGROUP_ActionRPG);
+
+UEnemyDecisionSubsystem::UEnemyDecisionSubsystem()
+{
+	MinParallelEnemies = 64;
+	ChunkSize = 32;
+}
+
+bool UEnemyDecisionSubsystem::ShouldCreateSubsystem(UObject* Outer) const
+{
+	UWorld* World = Cast<UWorld>(Outer);
+	return World && World->IsGameWorld();
+}
+
+void UEnemyDecisionSubsystem::Deinitialize()
+{
+	Enemies.Empty();
+	Snapshots.Empty();
+	Intents.Empty();
+
+	Super::Deinitialize();
+}
+
+bool UEnemyDecisionSubsystem::IsTickable() const
+{
+	return !IsTemplate() && Enemies.Num() > 0;
+}
+
+ETickableTickType UEnemyDecisionSubsystem::GetTickableTickType() const
+{
+	return IsTemplate() ? ETickableTickType::Never : ETickableTickType::Conditional;
+}
+
+TStatId UEnemyDecisionSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UEnemyDecisionSubsystem, STATGROUP_Tickables);
+}
+
+void UEnemyDecisionSubsystem::Tick(float DeltaTime)
+{
+	GatherSnapshots();
+	EvaluateIntents(Snapshots.Num() < MinParallelEnemies);
+	ApplyIntents();
+}
+
+void UEnemyDecisionSubsystem::RegisterEnemy(AEnemy* Enemy)
+{
+	if (Enemy) {
+
+		Enemies.AddUnique(Enemy);
+	}
+}
+
+void UEnemyDecisionSubsystem::UnregisterEnemy(AEnemy* Enemy)
+{
+	Enemies.RemoveSwap(Enemy);
+}
+
+void UEnemyDecisionSubsystem::GatherSnapshots()
+{
+	SCOPE_CYCLE_COUNTER(STAT_DecisionGather);
+
+	Snapshots.Reset();
+	Snapshots.Reserve(Enemies.Num());
+
+	UEnemySquadSubsystem* Squads = GetWorld()->GetSubsystem<UEnemySquadSubsystem>();
+
+	for (AEnemy* Enemy : Enemies) {
+
+		if (!Enemy) continue;
+
+		FEnemySnapshot& Snapshot = Snapshots.AddDefaulted_GetRef();
+		Snapshot.Enemy = Enemy;
+		// Squad members that haven't seen the player themselves go after the leader's target
+		Snapshot.Target = Enemy->AggroTarget ? Enemy->AggroTarget : (Squads ? Squads->GetSquadTarget(Enemy) : nullptr);
+		Snapshot.State = Enemy->GetEnemyState();
+		Snapshot.bTargetDead = Snapshot.Target && (Snapshot.Target->MovementStatus == EMovementStatus::EMS_Dead || Snapshot.Target->Health <= 0.f);
+		Snapshot.bInFormation = Enemy->bInFormation;
+		Snapshot.bInCombatRange = Enemy->bOverlappingCombatSphere;
+		Snapshot.bHasValidTarget = Enemy->bHasValidTarget;
+		Snapshot.bAttacking = Enemy->bAttacking;
+		Snapshot.bAttackReady = Enemy->bAttackReady;
+		Snapshot.bCanPatrol = Enemy->PatrolPoints.Num() > 0;
+	}
+
+	SET_DWORD_STAT(STAT_DecisionEnemies, Snapshots.Num());
+}
+
+void UEnemyDecisionSubsystem::EvaluateIntents(bool bSingleThreaded)
+{
+	SCOPE_CYCLE_COUNTER(STAT_DecisionEvaluate);
+
+	const int32 Count = Snapshots.Num();
+	Intents.SetNumUninitialized(Count, false);
+
+	const int32 Chunk = FMath::Max(1, ChunkSize);
+	const int32 NumChunks = FMath::DivideAndRoundUp(Count, Chunk);
+
+	ParallelFor(NumChunks, [this, Count, Chunk](int32 ChunkIndex)
+	{
+		const int32 ChunkBegin = ChunkIndex * Chunk;
+		const int32 ChunkEnd = FMath::Min(ChunkBegin + Chunk, Count);
+
+		for (int32 i = ChunkBegin; i < ChunkEnd; ++i) {
+
+			Intents[i] = Decide(Snapshots[i]);
+		}
+	}, bSingleThreaded);
+}
+
+UEnemyDecisionSubsystem::EEnemyIntent UEnemyDecisionSubsystem::Decide(const FEnemySnapshot& Snapshot)
+{
+	// Stagger ends on its own timer and followers in formation are moved by their squad
+	if (Snapshot.State == EEnemyState::ES_Dead || Snapshot.State == EEnemyState::ES_Stagger || Snapshot.bInFormation) return EEnemyIntent::None;
+
+	if (!Snapshot.Target || Snapshot.bTargetDead) {
+
+		// Nobody left to chase or swing at
+		if (IsEnemyStateIn(Snapshot.State, EEnemyState::ES_Engaged)) return EEnemyIntent::Idle;
+		return Snapshot.State == EEnemyState::ES_Idle && Snapshot.bCanPatrol ? EEnemyIntent::Patrol : EEnemyIntent::None;
+	}
+
+	if (Snapshot.bInCombatRange) {
+
+		// The attack timer only runs while this enemy holds an attack token
+		return Snapshot.bAttackReady && Snapshot.bHasValidTarget && !Snapshot.bAttacking ? EEnemyIntent::Attack : EEnemyIntent::None;
+	}
+
+	return Snapshot.State != EEnemyState::ES_Chase ? EEnemyIntent::MoveToTarget : EEnemyIntent::None;
+}
+
+void UEnemyDecisionSubsystem::ApplyIntents()
+{
+	SCOPE_CYCLE_COUNTER(STAT_DecisionApply);
+
+	int32 NumApplied = 0;
+
+	for (int32 i = 0; i < Intents.Num(); ++i) {
+
+		const FEnemySnapshot& Snapshot = Snapshots[i];
+		AEnemy* Enemy = Snapshot.Enemy;
+
+		switch (Intents[i]) {
+
+		case EEnemyIntent::MoveToTarget:
+			Enemy->MoveToTarget(Snapshot.Target);
+			break;
+
+		case EEnemyIntent::Attack:
+			Enemy->bAttackReady = false;
+			Enemy->Attack();
+			break;
+
+		case EEnemyIntent::Idle:
+			Enemy->StopChasing();
+			break;
+
+		case EEnemyIntent::Patrol:
+			Enemy->Patrol();
+			break;
+
+		default:
+			continue;
+		}
+		++NumApplied;
+	}
+
+	SET_DWORD_STAT(STAT_DecisionIntents, NumApplied);
+}
+
+void UEnemyDecisionSubsystem::TileSnapshots(int32 Count)
+{
+	const int32 NumGathered = Snapshots.Num();
+	if (NumGathered == 0) {
+
+		Snapshots.AddDefaulted(Count);
+		return;
+	}
+
+	Snapshots.Reserve(Count);
+	for (int32 i = NumGathered; i < Count; ++i) {
+
+		Snapshots.Add(Snapshots[i % NumGathered]);
+	}
+}
+
+// ActionRPG.AI.Benchmark [Count] [Iterations]
+// Evaluates Count copies of the current enemies' snapshots single threaded and in parallel, nothing is applied
+static FAutoConsoleCommandWithWorldAndArgs DecisionBenchmarkCommand(
+	TEXT("ActionRPG.AI.Benchmark"),
+	TEXT("Measures enemy decision throughput. Usage: ActionRPG.AI.Benchmark [Count] [Iterations]"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateStatic([](const TArray<FString>& Args, UWorld* World)
+	{
+		UEnemyDecisionSubsystem* Decisions = World ? World->GetSubsystem<UEnemyDecisionSubsystem>() : nullptr;
+		if (!Decisions) return;
+
+		const int32 Count = FMath::Max(1, Args.Num() > 0 ? FCString::Atoi(*Args[0]) : 10000);
+		const int32 Iterations = FMath::Max(1, Args.Num() > 1 ? FCString::Atoi(*Args[1]) : 60);
+
+		Decisions->GatherSnapshots();
+		Decisions->TileSnapshots(Count);
+
+		double Start = FPlatformTime::Seconds();
+		for (int32 Iteration = 0; Iteration < Iterations; ++Iteration) {
+
+			Decisions->EvaluateIntents(true);
+		}
+		const double SingleSeconds = (FPlatformTime::Seconds() - Start) / Iterations;
+
+		Start = FPlatformTime::Seconds();
+		for (int32 Iteration = 0; Iteration < Iterations; ++Iteration) {
+
+			Decisions->EvaluateIntents(false);
+		}
+		const double ParallelSeconds = (FPlatformTime::Seconds() - Start) / Iterations;
+
+		// The tiled copies never reach ApplyIntents, the next tick gathers afresh
+		UE_LOG(LogActionRPG, Log, TEXT("AI decision benchmark %d enemies: single thread %.3f ms, parallel %.3f ms on %d workers"),
+			Count, SingleSeconds * 1000.0, ParallelSeconds * 1000.0, FTaskGraphInterface::Get().GetNumWorkerThreads());
+	}));
@@ -0,0 +1,100 @@
+// Copyright by Hakan Akkurt
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "Tickable.h"
+#include "Enemy.h"
+#include "EnemyDecisionSubsystem.generated.h"
+
+/**
+ * Makes the chase, attack and give-up decisions for every enemy once a frame in two phases. Overlap,
+ * aggro and timer callbacks only record what happened on the enemy; a snapshot of those facts is then
+ * evaluated on worker threads into one intent per enemy, and a short game thread pass carries the
+ * intents out through the usual AEnemy calls.
+ */
+UCLASS(Config = Game)
+class ACTIONRPG_API UEnemyDecisionSubsystem : public UWorldSubsystem, public FTickableGameObject
+{
+	GENERATED_BODY()
+
+public:
+
+	UEnemyDecisionSubsystem();
+
+	// Fewer enemies than this are evaluated on the game thread, the task overhead isn't worth it
+	UPROPERTY(Config, EditAnywhere, BlueprintReadOnly, Category = "AI")
+	int32 MinParallelEnemies;
+
+	// Enemies per ParallelFor task
+	UPROPERTY(Config, EditAnywhere, BlueprintReadOnly, Category = "AI")
+	int32 ChunkSize;
+
+	// Enemies are registered while they are in play, from BeginPlay and pool reuse
+	void RegisterEnemy(AEnemy* Enemy);
+
+	void UnregisterEnemy(AEnemy* Enemy);
+
+	FORCEINLINE const TArray<AEnemy*>& GetEnemies() const { return Enemies; }
+
+	// Copies what the decision rules read off every registered enemy and its target, game thread only
+	void GatherSnapshots();
+
+	// Turns the snapshots into intents, touches nothing but the two arrays so it can run on workers
+	void EvaluateIntents(bool bSingleThreaded);
+
+	// Carries out the intents on the game thread
+	void ApplyIntents();
+
+	// Repeats the gathered snapshots until there are Count of them, for benchmarking only, don't apply afterwards
+	void TileSnapshots(int32 Count);
+
+	FORCEINLINE int32 GetNumSnapshots() const { return Snapshots.Num(); }
+
+	virtual bool ShouldCreateSubsystem(UObject* Outer) const override;
+
+	virtual void Deinitialize() override;
+
+	// FTickableGameObject
+	virtual void Tick(float DeltaTime) override;
+	virtual bool IsTickable() const override;
+	virtual ETickableTickType GetTickableTickType() const override;
+	virtual TStatId GetStatId() const override;
+	virtual UWorld* GetTickableGameObjectWorld() const override { return GetWorld(); }
+
+private:
+
+	enum class EEnemyIntent : uint8
+	{
+		None,
+		MoveToTarget,
+		Attack,
+		Idle,
+		Patrol
+	};
+
+	struct FEnemySnapshot
+	{
+		AEnemy* Enemy = nullptr;
+		AMain* Target = nullptr;
+		EEnemyState State = EEnemyState::ES_Idle;
+		bool bTargetDead = false;
+		bool bInCombatRange = false;
+		bool bHasValidTarget = false;
+		bool bAttacking = false;
+		bool bAttackReady = false;
+		bool bCanPatrol = false;
+		bool bInFormation = false;
+	};
+
+	static EEnemyIntent Decide(const FEnemySnapshot& Snapshot);
+
+	UPROPERTY()
+	TArray<AEnemy*> Enemies;
+
+	TArray<FEnemySnapshot> Snapshots;
+
+	// Parallel to Snapshots
+	TArray<EEnemyIntent> Intents;
+};
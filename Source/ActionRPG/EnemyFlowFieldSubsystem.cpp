@@ -0,0 +1,412 @@
+// Copyright by Hakan Akkurt
+
+
+#include "EnemyFlowFieldSubsystem.h"
+#include "ActionRPG.h"
+#include "Enemy.h"
+#include "Main.h"
+#include "AIController.h"
+#include "NavigationSystem.h"
+#include "NavigationPath.h"
+#include "Engine/World.h"
+#include "Kismet/GameplayStatics.h"
+#include "Components/CapsuleComponent.h"
+#include "HAL/IConsoleManager.h"
+
+DECLARE_CYCLE_STAT(TEXT("Flow Field Build"), STAT_FlowFieldBuild, STATGROUP_ActionRPG);
+DECLARE_CYCLE_STAT(TEXT("Flow Field Steering"), STAT_FlowFieldSteering, STATGROUP_ActionRPG);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Flow Field Followers"), STAT_FlowFieldFollowers, STATGROUP_ActionRPG);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Flow Field Projections"), STAT_FlowFieldProjections, STATGROUP_ActionRPG);
+
+namespace
+{
+	const int32 NumNeighbours = 8;
+	const int8 GoalDirection = NumNeighbours;
+	const int8 NoDirection = -1;
+
+	// Opposite directions sit next to each other so Dir ^ 1 flips a direction
+	const FIntPoint NeighbourOffsets[NumNeighbours] = {
+		FIntPoint(1, 0), FIntPoint(-1, 0), FIntPoint(0, 1), FIntPoint(0, -1),
+		FIntPoint(1, 1), FIntPoint(-1, -1), FIntPoint(1, -1), FIntPoint(-1, 1)
+	};
+
+	const float NeighbourCosts[NumNeighbours] = {
+		1.f, 1.f, 1.f, 1.f,
+		1.41421356f, 1.41421356f, 1.41421356f, 1.41421356f
+	};
+
+	// Floors are this many cells tall when keying the projection cache
+	const float LayerHeightInCells = 2.f;
+}
+
+UEnemyFlowFieldSubsystem::UEnemyFlowFieldSubsystem()
+{
+	bEnabled = true;
+	CellSize = 150.f;
+	FieldRadius = 24;
+	MaxStepHeight = 60.f;
+	AcceptanceRadius = 10.f;
+
+	FieldTarget = nullptr;
+	FieldOrigin = FIntVector::ZeroValue;
+	GoalLocation = FVector::ZeroVector;
+	bFieldValid = false;
+}
+
+bool UEnemyFlowFieldSubsystem::ShouldCreateSubsystem(UObject* Outer) const
+{
+	UWorld* World = Cast<UWorld>(Outer);
+	return World && World->IsGameWorld();
+}
+
+void UEnemyFlowFieldSubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+
+	UNavigationSystemV1* NavSys = FNavigationSystem::GetCurrent<UNavigationSystemV1>(GetWorld());
+	if (NavSys) {
+
+		NavSys->OnNavigationGenerationFinishedDelegate.AddDynamic(this, &UEnemyFlowFieldSubsystem::OnNavigationGenerationFinished);
+	}
+}
+
+void UEnemyFlowFieldSubsystem::Deinitialize()
+{
+	Followers.Empty();
+	ProjectionCache.Empty();
+	FieldTarget = nullptr;
+	bFieldValid = false;
+
+	Super::Deinitialize();
+}
+
+void UEnemyFlowFieldSubsystem::OnNavigationGenerationFinished(ANavigationData* NavData)
+{
+	ProjectionCache.Empty();
+	bFieldValid = false;
+}
+
+bool UEnemyFlowFieldSubsystem::StartFollowing(AEnemy* Enemy, AMain* Target)
+{
+	if (!bEnabled || !Enemy || !Target) return false;
+
+	if (FieldTarget != Target || !bFieldValid || GetCell(Target->GetActorLocation()) != FieldOrigin) {
+
+		BuildField(Target);
+	}
+
+	FVector Direction;
+	if (!SampleDirection(Enemy->GetActorLocation(), Direction)) return false;
+
+	Followers.AddUnique(Enemy);
+	return true;
+}
+
+void UEnemyFlowFieldSubsystem::StopFollowing(AEnemy* Enemy)
+{
+	if (Followers.RemoveSwap(Enemy) > 0 && Enemy->AIController) {
+
+		Enemy->AIController->ClearFocus(EAIFocusPriority::Gameplay);
+	}
+}
+
+FIntVector UEnemyFlowFieldSubsystem::GetCell(const FVector& Location) const
+{
+	return FIntVector(
+		FMath::FloorToInt(Location.X / CellSize),
+		FMath::FloorToInt(Location.Y / CellSize),
+		FMath::FloorToInt(Location.Z / (CellSize * LayerHeightInCells)));
+}
+
+FVector UEnemyFlowFieldSubsystem::GetCellCenter(int32 LocalX, int32 LocalY) const
+{
+	const int32 Index = (LocalY + FieldRadius) * GetFieldWidth() + (LocalX + FieldRadius);
+
+	return FVector(
+		(FieldOrigin.X + LocalX + 0.5f) * CellSize,
+		(FieldOrigin.Y + LocalY + 0.5f) * CellSize,
+		Height[Index]);
+}
+
+const UEnemyFlowFieldSubsystem::FCellNav& UEnemyFlowFieldSubsystem::ProjectCell(int32 CellX, int32 CellY, float ReferenceZ)
+{
+	const float LayerHeight = CellSize * LayerHeightInCells;
+	const int32 Layer = FMath::FloorToInt(ReferenceZ / LayerHeight);
+	const FIntVector Key(CellX, CellY, Layer);
+
+	FCellNav* Cached = ProjectionCache.Find(Key);
+	if (Cached) return *Cached;
+
+	INC_DWORD_STAT(STAT_FlowFieldProjections);
+
+	FCellNav Nav;
+	Nav.bWalkable = false;
+	Nav.Height = (Layer + 0.5f) * LayerHeight;
+
+	UNavigationSystemV1* NavSys = FNavigationSystem::GetCurrent<UNavigationSystemV1>(GetWorld());
+	if (NavSys) {
+
+		const FVector Center((CellX + 0.5f) * CellSize, (CellY + 0.5f) * CellSize, Nav.Height);
+		const FVector Extent(CellSize * 0.5f, CellSize * 0.5f, LayerHeight);
+
+		FNavLocation Projected;
+		if (NavSys->ProjectPointToNavigation(Center, Projected, Extent)) {
+
+			Nav.bWalkable = true;
+			Nav.Height = Projected.Location.Z;
+		}
+	}
+
+	return ProjectionCache.Add(Key, Nav);
+}
+
+void UEnemyFlowFieldSubsystem::BuildField(AMain* Target)
+{
+	SCOPE_CYCLE_COUNTER(STAT_FlowFieldBuild);
+
+	FieldTarget = Target;
+	bFieldValid = false;
+	if (!Target) return;
+
+	GoalLocation = Target->GetActorLocation();
+	FieldOrigin = GetCell(GoalLocation);
+
+	for (TMap<FIntVector, FCellNav>::TIterator It = ProjectionCache.CreateIterator(); It; ++It) {
+
+		if (FMath::Abs(It.Key().X - FieldOrigin.X) > FieldRadius || FMath::Abs(It.Key().Y - FieldOrigin.Y) > FieldRadius) {
+
+			It.RemoveCurrent();
+		}
+	}
+
+	const int32 Width = GetFieldWidth();
+	const int32 NumCells = Width * Width;
+
+	Cost.Init(MAX_flt, NumCells);
+	Height.SetNumUninitialized(NumCells);
+	FlowDirection.Init(NoDirection, NumCells);
+
+	TArray<bool> Walkable;
+	Walkable.SetNumUninitialized(NumCells);
+
+	for (int32 Y = 0; Y < Width; ++Y) {
+
+		for (int32 X = 0; X < Width; ++X) {
+
+			const FCellNav& Nav = ProjectCell(FieldOrigin.X + X - FieldRadius, FieldOrigin.Y + Y - FieldRadius, GoalLocation.Z);
+			Walkable[Y * Width + X] = Nav.bWalkable;
+			Height[Y * Width + X] = Nav.Height;
+		}
+	}
+
+	// Dijkstra out from the player's cell
+	const int32 GoalIndex = FieldRadius * Width + FieldRadius;
+	Cost[GoalIndex] = 0.f;
+	FlowDirection[GoalIndex] = GoalDirection;
+	Walkable[GoalIndex] = true;
+	Height[GoalIndex] = GoalLocation.Z - Target->GetCapsuleComponent()->GetScaledCapsuleHalfHeight();
+
+	typedef TPair<float, int32> FOpenCell;
+	TArray<FOpenCell> Open;
+	Open.Reserve(NumCells);
+
+	auto Compare = [](const FOpenCell& A, const FOpenCell& B) { return A.Key < B.Key; };
+	Open.HeapPush(FOpenCell(0.f, GoalIndex), Compare);
+
+	while (Open.Num() > 0) {
+
+		FOpenCell Current;
+		Open.HeapPop(Current, Compare, false);
+
+		const int32 Index = Current.Value;
+		if (Current.Key > Cost[Index]) continue;
+
+		const int32 X = Index % Width;
+		const int32 Y = Index / Width;
+
+		for (int32 Dir = 0; Dir < NumNeighbours; ++Dir) {
+
+			const int32 NX = X + NeighbourOffsets[Dir].X;
+			const int32 NY = Y + NeighbourOffsets[Dir].Y;
+			if (NX < 0 || NY < 0 || NX >= Width || NY >= Width) continue;
+
+			const int32 Neighbour = NY * Width + NX;
+			if (!Walkable[Neighbour]) continue;
+			if (FMath::Abs(Height[Neighbour] - Height[Index]) > MaxStepHeight) continue;
+
+			// No cutting corners past walls on diagonals
+			if (NeighbourOffsets[Dir].X != 0 && NeighbourOffsets[Dir].Y != 0) {
+
+				if (!Walkable[Y * Width + NX] || !Walkable[NY * Width + X]) continue;
+			}
+
+			const float NewCost = Cost[Index] + NeighbourCosts[Dir];
+			if (NewCost < Cost[Neighbour]) {
+
+				Cost[Neighbour] = NewCost;
+
+				// Neighbour reaches the goal by stepping back the way we came
+				FlowDirection[Neighbour] = Dir ^ 1;
+				Open.HeapPush(FOpenCell(NewCost, Neighbour), Compare);
+			}
+		}
+	}
+
+	bFieldValid = true;
+}
+
+bool UEnemyFlowFieldSubsystem::SampleDirection(const FVector& Location, FVector& OutDirection) const
+{
+	if (!bFieldValid) return false;
+
+	const int32 LocalX = FMath::FloorToInt(Location.X / CellSize) - FieldOrigin.X;
+	const int32 LocalY = FMath::FloorToInt(Location.Y / CellSize) - FieldOrigin.Y;
+	if (FMath::Abs(LocalX) > FieldRadius || FMath::Abs(LocalY) > FieldRadius) return false;
+
+	const int32 Index = (LocalY + FieldRadius) * GetFieldWidth() + (LocalX + FieldRadius);
+	const int8 Dir = FlowDirection[Index];
+	if (Dir == NoDirection) return false;
+
+	// Enemies on a different floor than the cell was projected to aren't on this field
+	if (FMath::Abs(Location.Z - Height[Index]) > CellSize * LayerHeightInCells) return false;
+
+	if (Dir == GoalDirection) {
+
+		OutDirection = (GoalLocation - Location).GetSafeNormal2D();
+	}
+	else {
+
+		const FVector Next = GetCellCenter(LocalX + NeighbourOffsets[Dir].X, LocalY + NeighbourOffsets[Dir].Y);
+		OutDirection = (Next - Location).GetSafeNormal2D();
+	}
+	return true;
+}
+
+bool UEnemyFlowFieldSubsystem::IsTickable() const
+{
+	return !IsTemplate() && Followers.Num() > 0;
+}
+
+ETickableTickType UEnemyFlowFieldSubsystem::GetTickableTickType() const
+{
+	return IsTemplate() ? ETickableTickType::Never : ETickableTickType::Conditional;
+}
+
+TStatId UEnemyFlowFieldSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UEnemyFlowFieldSubsystem, STATGROUP_Tickables);
+}
+
+void UEnemyFlowFieldSubsystem::Tick(float DeltaTime)
+{
+	// One rebuild per player cell change, shared by every chaser
+	if (FieldTarget && (!bFieldValid || GetCell(FieldTarget->GetActorLocation()) != FieldOrigin)) {
+
+		BuildField(FieldTarget);
+	}
+	if (FieldTarget) {
+
+		GoalLocation = FieldTarget->GetActorLocation();
+	}
+
+	SCOPE_CYCLE_COUNTER(STAT_FlowFieldSteering);
+
+	const float TargetRadius = FieldTarget ? FieldTarget->GetCapsuleComponent()->GetScaledCapsuleRadius() : 0.f;
+
+	for (int32 i = Followers.Num() - 1; i >= 0; --i) {
+
+		AEnemy* Enemy = Followers[i];
+
+		if (!Enemy || !Enemy->Alive() || Enemy->GetEnemyMovementStatus() != EEnemyMovementStatus::EMS_MoveToTarget) {
+
+			if (Enemy) { StopFollowing(Enemy); }
+			else { Followers.RemoveAtSwap(i); }
+			continue;
+		}
+
+		const FVector Location = Enemy->GetActorLocation();
+
+		FVector Direction;
+		if (!SampleDirection(Location, Direction)) {
+
+			// Walked off the field, let the navmesh take over
+			StopFollowing(Enemy);
+			if (FieldTarget) { Enemy->MoveToTarget(FieldTarget); }
+			continue;
+		}
+
+		const float Reach = AcceptanceRadius + TargetRadius + Enemy->GetCapsuleComponent()->GetScaledCapsuleRadius();
+		if (FVector::DistSquared2D(Location, GoalLocation) <= FMath::Square(Reach)) continue;
+
+		Enemy->AddMovementInput(Direction);
+
+		if (Enemy->AIController) {
+
+			Enemy->AIController->SetFocalPoint(Location + Direction * CellSize, EAIFocusPriority::Gameplay);
+		}
+	}
+
+	SET_DWORD_STAT(STAT_FlowFieldFollowers, Followers.Num());
+}
+
+// ActionRPG.FlowField.Benchmark [Counts...]
+// Times N individual navmesh path queries against one field build plus N field samples, for 50, 200 and 1000 chasers by default
+static FAutoConsoleCommandWithWorldAndArgs FlowFieldBenchmarkCommand(
+	TEXT("ActionRPG.FlowField.Benchmark"),
+	TEXT("Compares per-enemy path queries with the shared flow field. Usage: ActionRPG.FlowField.Benchmark [Count...]"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateStatic([](const TArray<FString>& Args, UWorld* World)
+	{
+		UEnemyFlowFieldSubsystem* FlowField = World ? World->GetSubsystem<UEnemyFlowFieldSubsystem>() : nullptr;
+		UNavigationSystemV1* NavSys = FNavigationSystem::GetCurrent<UNavigationSystemV1>(World);
+		AMain* Main = Cast<AMain>(UGameplayStatics::GetPlayerPawn(World, 0));
+		if (!FlowField || !NavSys || !Main) return;
+
+		TArray<int32> Counts;
+		for (const FString& Arg : Args) {
+
+			Counts.Add(FCString::Atoi(*Arg));
+		}
+		if (Counts.Num() == 0) {
+
+			Counts = { 50, 200, 1000 };
+		}
+
+		const FVector Goal = Main->GetActorLocation();
+		const float Radius = FlowField->CellSize * FlowField->FieldRadius;
+
+		for (int32 Count : Counts) {
+
+			TArray<FVector> Chasers;
+			Chasers.Reserve(Count);
+			for (int32 i = 0; i < Count; ++i) {
+
+				FNavLocation Point;
+				if (NavSys->GetRandomReachablePointInRadius(Goal, Radius, Point)) {
+
+					Chasers.Add(Point.Location);
+				}
+			}
+
+			// What MoveToTarget costs when every chaser repaths in the same frame
+			double Start = FPlatformTime::Seconds();
+			for (const FVector& Chaser : Chasers) {
+
+				UNavigationSystemV1::FindPathToLocationSynchronously(World, Chaser, Goal);
+			}
+			const double PathSeconds = FPlatformTime::Seconds() - Start;
+
+			// One shared build, then a lookup per chaser
+			Start = FPlatformTime::Seconds();
+			FlowField->BuildField(Main);
+			int32 Sampled = 0;
+			for (const FVector& Chaser : Chasers) {
+
+				FVector Direction;
+				if (FlowField->SampleDirection(Chaser, Direction)) { ++Sampled; }
+			}
+			const double FieldSeconds = FPlatformTime::Seconds() - Start;
+
+			UE_LOG(LogActionRPG, Log, TEXT("Flow field benchmark %d chasers: %d path queries %.2f ms, 1 field build + %d samples %.2f ms"),
+				Count, Chasers.Num(), PathSeconds * 1000.0, Sampled, FieldSeconds * 1000.0);
+		}
+	}));
@@ -0,0 +1,107 @@
+// Copyright by Hakan Akkurt
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "Tickable.h"
+#include "EnemyFlowFieldSubsystem.generated.h"
+
+/**
+ * Shared navigation for enemies chasing the player. A grid of cells around the player is projected
+ * onto the navmesh and flooded with a Dijkstra pass once whenever the player changes cell; every
+ * chaser then steers by looking up its cell instead of running its own MoveTo path query.
+ * Enemies outside the field fall back to AAIController::MoveTo.
+ */
+UCLASS(Config = Game)
+class ACTIONRPG_API UEnemyFlowFieldSubsystem : public UWorldSubsystem, public FTickableGameObject
+{
+	GENERATED_BODY()
+
+public:
+
+	UEnemyFlowFieldSubsystem();
+
+	UPROPERTY(Config, EditAnywhere, BlueprintReadOnly, Category = "Flow Field")
+	bool bEnabled;
+
+	UPROPERTY(Config, EditAnywhere, BlueprintReadOnly, Category = "Flow Field")
+	float CellSize;
+
+	// Field covers this many cells in every direction around the player
+	UPROPERTY(Config, EditAnywhere, BlueprintReadOnly, Category = "Flow Field")
+	int32 FieldRadius;
+
+	// Neighbouring cells further apart than this in height are not connected
+	UPROPERTY(Config, EditAnywhere, BlueprintReadOnly, Category = "Flow Field")
+	float MaxStepHeight;
+
+	// Same acceptance radius AEnemy::MoveToTarget gives its MoveTo requests
+	UPROPERTY(Config, EditAnywhere, BlueprintReadOnly, Category = "Flow Field")
+	float AcceptanceRadius;
+
+	// Hands Enemy over to the flow field, returns false when it has to path on its own
+	bool StartFollowing(class AEnemy* Enemy, class AMain* Target);
+
+	void StopFollowing(AEnemy* Enemy);
+
+	// Direction towards the goal from Location, false when Location is outside the reachable field
+	bool SampleDirection(const FVector& Location, FVector& OutDirection) const;
+
+	// Floods the field around Target right away
+	void BuildField(AMain* Target);
+
+	FORCEINLINE int32 GetNumFollowers() const { return Followers.Num(); }
+
+	virtual bool ShouldCreateSubsystem(UObject* Outer) const override;
+
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+
+	virtual void Deinitialize() override;
+
+	// FTickableGameObject
+	virtual void Tick(float DeltaTime) override;
+	virtual bool IsTickable() const override;
+	virtual ETickableTickType GetTickableTickType() const override;
+	virtual TStatId GetStatId() const override;
+	virtual UWorld* GetTickableGameObjectWorld() const override { return GetWorld(); }
+
+private:
+
+	struct FCellNav
+	{
+		bool bWalkable;
+		float Height;
+	};
+
+	UFUNCTION()
+	void OnNavigationGenerationFinished(class ANavigationData* NavData);
+
+	// Global cell of Location, Z is a coarse floor layer so stacked floors don't share a field
+	FIntVector GetCell(const FVector& Location) const;
+
+	FVector GetCellCenter(int32 LocalX, int32 LocalY) const;
+
+	const FCellNav& ProjectCell(int32 CellX, int32 CellY, float ReferenceZ);
+
+	FORCEINLINE int32 GetFieldWidth() const { return FieldRadius * 2 + 1; }
+
+	UPROPERTY()
+	TArray<AEnemy*> Followers;
+
+	UPROPERTY()
+	AMain* FieldTarget;
+
+	FIntVector FieldOrigin;
+	FVector GoalLocation;
+	bool bFieldValid;
+
+	// Per local cell: summed path cost to the goal, ground height and the neighbour to head for
+	TArray<float> Cost;
+	TArray<float> Height;
+	TArray<int8> FlowDirection;
+
+	// Navmesh projections survive rebuilds, the navmesh rarely changes while the player moves.
+	// Cells the field has moved off are dropped on rebuild, so it holds one field's worth per layer.
+	TMap<FIntVector, FCellNav> ProjectionCache;
+};
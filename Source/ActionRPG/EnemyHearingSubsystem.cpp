@@ -0,0 +1,144 @@
+// Copyright by Hakan Akkurt
+
+
+#include "EnemyHearingSubsystem.h"
+#include "ActionRPG.h"
+#include "Enemy.h"
+#include "EnemySignificanceSubsystem.h"
+#include "Engine/World.h"
+#include "Engine/Engine.h"
+
+DECLARE_CYCLE_STAT(TEXT("Hearing Update"), STAT_HearingUpdate, STATGROUP_ActionRPG);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Hearing Noises"), STAT_HearingNoises, STATGROUP_ActionRPG);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Hearing Listeners"), STAT_HearingListeners, STATGROUP_ActionRPG);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Hearing Deliveries"), STAT_HearingDeliveries, STATGROUP_ActionRPG);
+
+UEnemyHearingSubsystem::UEnemyHearingSubsystem()
+{
+	HearingRange = 1500.f;
+	CellSize = 1500.f;
+}
+
+bool UEnemyHearingSubsystem::ShouldCreateSubsystem(UObject* Outer) const
+{
+	UWorld* World = Cast<UWorld>(Outer);
+	return World && World->IsGameWorld();
+}
+
+void UEnemyHearingSubsystem::Deinitialize()
+{
+	PendingNoises.Empty();
+
+	Super::Deinitialize();
+}
+
+void UEnemyHearingSubsystem::ReportNoise(const UObject* WorldContextObject, const FVector& Location, float Loudness, AActor* Instigator)
+{
+	UWorld* World = GEngine->GetWorldFromContextObject(WorldContextObject, EGetWorldErrorMode::ReturnNull);
+	UEnemyHearingSubsystem* Hearing = World ? World->GetSubsystem<UEnemyHearingSubsystem>() : nullptr;
+	if (Hearing) {
+
+		Hearing->AddNoise(Location, Loudness, Instigator);
+	}
+}
+
+void UEnemyHearingSubsystem::AddNoise(const FVector& Location, float Loudness, AActor* Instigator)
+{
+	const float Range = HearingRange * Loudness;
+	if (Range <= 0.f) return;
+
+	PendingNoises.Add({ Location, Range, Instigator });
+}
+
+bool UEnemyHearingSubsystem::IsTickable() const
+{
+	return !IsTemplate() && PendingNoises.Num() > 0;
+}
+
+ETickableTickType UEnemyHearingSubsystem::GetTickableTickType() const
+{
+	return IsTemplate() ? ETickableTickType::Never : ETickableTickType::Conditional;
+}
+
+TStatId UEnemyHearingSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UEnemyHearingSubsystem, STATGROUP_Tickables);
+}
+
+void UEnemyHearingSubsystem::Tick(float DeltaTime)
+{
+	SCOPE_CYCLE_COUNTER(STAT_HearingUpdate);
+
+	SET_DWORD_STAT(STAT_HearingNoises, PendingNoises.Num());
+
+	UEnemySignificanceSubsystem* Significance = GetWorld()->GetSubsystem<UEnemySignificanceSubsystem>();
+	if (!Significance || CellSize <= 0.f) {
+
+		PendingNoises.Reset();
+		return;
+	}
+
+	// Only enemies a noise could still wake are hashed
+	TArray<AEnemy*> Listeners;
+	TMap<FIntPoint, TArray<int32>> Grid;
+
+	for (AEnemy* Enemy : Significance->GetEnemies()) {
+
+		if (Enemy && Enemy->CanHearNoise()) {
+
+			Grid.FindOrAdd(GetCell(Enemy->GetActorLocation())).Add(Listeners.Add(Enemy));
+		}
+	}
+
+	// Closest noise per listener, so nobody reacts twice in a frame
+	TArray<int32> HeardNoise;
+	TArray<float> HeardDistSq;
+	HeardNoise.Init(INDEX_NONE, Listeners.Num());
+	HeardDistSq.Init(MAX_flt, Listeners.Num());
+
+	for (int32 NoiseIndex = 0; NoiseIndex < PendingNoises.Num(); ++NoiseIndex) {
+
+		const FNoiseEvent& Noise = PendingNoises[NoiseIndex];
+		const AActor* Instigator = Noise.Instigator.Get();
+		const float RangeSq = FMath::Square(Noise.Range);
+
+		const FIntPoint Min = GetCell(Noise.Location - FVector(Noise.Range));
+		const FIntPoint Max = GetCell(Noise.Location + FVector(Noise.Range));
+
+		for (int32 X = Min.X; X <= Max.X; ++X) {
+
+			for (int32 Y = Min.Y; Y <= Max.Y; ++Y) {
+
+				const TArray<int32>* Cell = Grid.Find(FIntPoint(X, Y));
+				if (!Cell) continue;
+
+				for (int32 Index : *Cell) {
+
+					if (Listeners[Index] == Instigator) continue;
+
+					const float DistSq = FVector::DistSquared(Listeners[Index]->GetActorLocation(), Noise.Location);
+					if (DistSq <= RangeSq && DistSq < HeardDistSq[Index]) {
+
+						HeardNoise[Index] = NoiseIndex;
+						HeardDistSq[Index] = DistSq;
+					}
+				}
+			}
+		}
+	}
+
+	int32 Deliveries = 0;
+	for (int32 Index = 0; Index < Listeners.Num(); ++Index) {
+
+		if (HeardNoise[Index] == INDEX_NONE) continue;
+
+		const FNoiseEvent& Noise = PendingNoises[HeardNoise[Index]];
+		Listeners[Index]->OnHeardNoise(Noise.Location, Noise.Instigator.Get());
+		++Deliveries;
+	}
+
+	PendingNoises.Reset();
+
+	SET_DWORD_STAT(STAT_HearingListeners, Listeners.Num());
+	SET_DWORD_STAT(STAT_HearingDeliveries, Deliveries);
+}
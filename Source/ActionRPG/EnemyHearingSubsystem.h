@@ -0,0 +1,63 @@
+// Copyright by Hakan Akkurt
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "Tickable.h"
+#include "EnemyHearingSubsystem.generated.h"
+
+/**
+ * Lets enemies hear combat. Gameplay code reports noises with a position and loudness; once a frame
+ * the enemies that can still be woken are hashed into a grid and each noise is handed only to those
+ * within its range. An enemy that hears several noises in a frame reacts to the closest one.
+ */
+UCLASS(Config = Game)
+class ACTIONRPG_API UEnemyHearingSubsystem : public UWorldSubsystem, public FTickableGameObject
+{
+	GENERATED_BODY()
+
+public:
+
+	UEnemyHearingSubsystem();
+
+	// How far a noise of loudness 1 carries
+	UPROPERTY(Config, EditAnywhere, BlueprintReadOnly, Category = "Hearing")
+	float HearingRange;
+
+	// Should be around HearingRange so a noise touches few cells
+	UPROPERTY(Config, EditAnywhere, BlueprintReadOnly, Category = "Hearing")
+	float CellSize;
+
+	// Queues a noise for the next hearing pass, does nothing outside game worlds
+	static void ReportNoise(const UObject* WorldContextObject, const FVector& Location, float Loudness, AActor* Instigator);
+
+	void AddNoise(const FVector& Location, float Loudness, AActor* Instigator);
+
+	virtual bool ShouldCreateSubsystem(UObject* Outer) const override;
+
+	virtual void Deinitialize() override;
+
+	// FTickableGameObject
+	virtual void Tick(float DeltaTime) override;
+	virtual bool IsTickable() const override;
+	virtual ETickableTickType GetTickableTickType() const override;
+	virtual TStatId GetStatId() const override;
+	virtual UWorld* GetTickableGameObjectWorld() const override { return GetWorld(); }
+
+private:
+
+	struct FNoiseEvent
+	{
+		FVector Location;
+		float Range;
+		TWeakObjectPtr<AActor> Instigator;
+	};
+
+	FORCEINLINE FIntPoint GetCell(const FVector& Location) const
+	{
+		return FIntPoint(FMath::FloorToInt(Location.X / CellSize), FMath::FloorToInt(Location.Y / CellSize));
+	}
+
+	TArray<FNoiseEvent> PendingNoises;
+};
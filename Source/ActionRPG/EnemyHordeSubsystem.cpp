@@ -0,0 +1,472 @@
+// Copyright by Hakan Akkurt
+
+
+#include "EnemyHordeSubsystem.h"
+#include "ActionRPG.h"
+#include "EnemyArchetype.h"
+#include "Main.h"
+#include "ActorPoolSubsystem.h"
+#include "ActionRPGGameModeBase.h"
+#include "EnemyFlowFieldSubsystem.h"
+#include "NavigationSystem.h"
+#include "Engine/World.h"
+#include "GameFramework/PlayerController.h"
+#include "Components/CapsuleComponent.h"
+#include "Kismet/GameplayStatics.h"
+#include "Async/ParallelFor.h"
+#include "HAL/IConsoleManager.h"
+
+DECLARE_CYCLE_STAT(TEXT("Horde Simulate"), STAT_HordeSimulate, STATGROUP_ActionRPG);
+DECLARE_CYCLE_STAT(TEXT("Horde Apply"), STAT_HordeApply, STATGROUP_ActionRPG);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Horde Minions"), STAT_HordeMinions, STATGROUP_ActionRPG);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Horde Promoted"), STAT_HordePromoted, STATGROUP_ActionRPG);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Horde Promotions"), STAT_HordePromotions, STATGROUP_ActionRPG);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Horde Demotions"), STAT_HordeDemotions, STATGROUP_ActionRPG);
+
+namespace
+{
+	// Minions only move in the plane, this is how far off the navmesh they may be settled from
+	const FVector NavQueryExtent(200.f, 200.f, 500.f);
+}
+
+UEnemyHordeSubsystem::UEnemyHordeSubsystem()
+{
+	PromoteRadius = 3000.f;
+	DemoteRadius = 4000.f;
+	MaxPromoted = 48;
+	MaxPromotionsPerFrame = 4;
+
+	// Same reach as AEnemy's AgroSphere and CombatSphere
+	AggroRadius = 1250.f;
+	AttackRange = 75.f;
+
+	MoveSpeed = 600.f;
+	Acceleration = 2048.f;
+
+	NumSlices = 2;
+	ChunkSize = 256;
+
+	NextSlice = 0;
+}
+
+bool UEnemyHordeSubsystem::ShouldCreateSubsystem(UObject* Outer) const
+{
+	UWorld* World = Cast<UWorld>(Outer);
+	return World && World->IsGameWorld();
+}
+
+void UEnemyHordeSubsystem::Deinitialize()
+{
+	ClearMinions();
+	Promoted.Empty();
+	MinionClasses.Empty();
+	MinionArchetypes.Empty();
+
+	Super::Deinitialize();
+}
+
+void UEnemyHordeSubsystem::SpawnMinions(TSubclassOf<AEnemy> Class, FVector Center, float Radius, int32 Count)
+{
+	if (!Class || Count <= 0) return;
+
+	const uint8 ClassIndex = FindOrAddClass(Class);
+	const float MaxHealth = MinionArchetypes[ClassIndex]->MaxHealth;
+
+	UNavigationSystemV1* NavSys = FNavigationSystem::GetCurrent<UNavigationSystemV1>(GetWorld());
+
+	Positions.Reserve(Positions.Num() + Count);
+	for (int32 i = 0; i < Count; ++i) {
+
+		FVector Location = Center + FMath::VRand().GetSafeNormal2D() * FMath::Sqrt(FMath::FRand()) * Radius;
+
+		FNavLocation NavLocation;
+		if (NavSys && NavSys->ProjectPointToNavigation(Location, NavLocation, NavQueryExtent)) {
+
+			Location = NavLocation.Location;
+		}
+
+		AddMinion(ClassIndex, Location, FVector::ZeroVector, MaxHealth, EEnemyMovementStatus::EMS_Idle);
+	}
+}
+
+void UEnemyHordeSubsystem::ClearMinions()
+{
+	Positions.Empty();
+	Velocities.Empty();
+	Health.Empty();
+	MovementStatus.Empty();
+	ClassIndices.Empty();
+	TargetIndices.Empty();
+	Requests.Empty();
+}
+
+void UEnemyHordeSubsystem::TrimMinions(int32 Count)
+{
+	for (int32 i = Positions.Num() - 1; i >= FMath::Max(Count, 0); --i) {
+
+		RemoveMinion(i);
+	}
+}
+
+void UEnemyHordeSubsystem::ForgetEnemy(AEnemy* Enemy)
+{
+	Promoted.RemoveSwap(Enemy);
+}
+
+int32 UEnemyHordeSubsystem::AddMinion(uint8 ClassIndex, const FVector& Location, const FVector& Velocity, float InHealth, EEnemyMovementStatus Status)
+{
+	Positions.Add(Location);
+	Velocities.Add(Velocity);
+	Health.Add(InHealth);
+	MovementStatus.Add(Status);
+	ClassIndices.Add(ClassIndex);
+	TargetIndices.Add(INDEX_NONE);
+	return Requests.Add(Request_None);
+}
+
+void UEnemyHordeSubsystem::RemoveMinion(int32 Index)
+{
+	Positions.RemoveAtSwap(Index, 1, false);
+	Velocities.RemoveAtSwap(Index, 1, false);
+	Health.RemoveAtSwap(Index, 1, false);
+	MovementStatus.RemoveAtSwap(Index, 1, false);
+	ClassIndices.RemoveAtSwap(Index, 1, false);
+	TargetIndices.RemoveAtSwap(Index, 1, false);
+	Requests.RemoveAtSwap(Index, 1, false);
+}
+
+uint8 UEnemyHordeSubsystem::FindOrAddClass(UClass* Class)
+{
+	int32 Index = MinionClasses.Find(Class);
+	if (Index == INDEX_NONE) {
+
+		Index = MinionClasses.Add(Class);
+		MinionArchetypes.Add(Class->GetDefaultObject<AEnemy>()->GetArchetype());
+	}
+	check(Index <= MAX_uint8);
+	return (uint8)Index;
+}
+
+void UEnemyHordeSubsystem::GatherPlayers()
+{
+	Players.Reset();
+
+	for (FConstPlayerControllerIterator It = GetWorld()->GetPlayerControllerIterator(); It; ++It) {
+
+		AMain* Main = (*It).IsValid() ? Cast<AMain>((*It)->GetPawn()) : nullptr;
+		if (Main) {
+
+			Players.Add({ Main, Main->GetActorLocation() });
+		}
+	}
+}
+
+void UEnemyHordeSubsystem::Simulate(int32 Begin, int32 End, float DeltaTime, bool bSingleThreaded)
+{
+	SCOPE_CYCLE_COUNTER(STAT_HordeSimulate);
+
+	const int32 Count = End - Begin;
+	if (Count <= 0 || DeltaTime <= 0.f) return;
+
+	// Only read from the worker threads, the field is rebuilt on the game thread in its own tick
+	const UEnemyFlowFieldSubsystem* FlowField = GetWorld()->GetSubsystem<UEnemyFlowFieldSubsystem>();
+	if (FlowField && !FlowField->bEnabled) {
+
+		FlowField = nullptr;
+	}
+
+	const int32 Chunk = FMath::Max(1, ChunkSize);
+	const int32 NumChunks = FMath::DivideAndRoundUp(Count, Chunk);
+
+	const float AggroRadiusSq = FMath::Square(AggroRadius);
+	const float PromoteRadiusSq = FMath::Square(PromoteRadius);
+	const float AttackRangeSq = FMath::Square(AttackRange);
+
+	ParallelFor(NumChunks, [&](int32 ChunkIndex)
+	{
+		const int32 ChunkBegin = Begin + ChunkIndex * Chunk;
+		const int32 ChunkEnd = FMath::Min(ChunkBegin + Chunk, End);
+
+		for (int32 i = ChunkBegin; i < ChunkEnd; ++i) {
+
+			Requests[i] = Request_None;
+			if (MovementStatus[i] == EEnemyMovementStatus::EMS_Dead) continue;
+
+			const FVector Location = Positions[i];
+
+			int32 Target = INDEX_NONE;
+			float TargetDistSq = MAX_flt;
+			for (int32 PlayerIndex = 0; PlayerIndex < Players.Num(); ++PlayerIndex) {
+
+				const float DistSq = FVector::DistSquared2D(Location, Players[PlayerIndex].Location);
+				if (DistSq < TargetDistSq) {
+
+					Target = PlayerIndex;
+					TargetDistSq = DistSq;
+				}
+			}
+
+			FVector DesiredVelocity = FVector::ZeroVector;
+
+			if (Target != INDEX_NONE && TargetDistSq <= PromoteRadiusSq) {
+
+				Requests[i] |= Request_Promote;
+			}
+
+			if (Target != INDEX_NONE && TargetDistSq <= AggroRadiusSq) {
+
+				TargetIndices[i] = Target;
+				MovementStatus[i] = EEnemyMovementStatus::EMS_MoveToTarget;
+
+				// Minions hold at the edge of attack range, the player can't be hurt by something that isn't drawn
+				if (TargetDistSq > AttackRangeSq) {
+
+					FVector Direction;
+					if (!FlowField || !FlowField->SampleDirection(Location, Direction)) {
+
+						Direction = (Players[Target].Location - Location).GetSafeNormal2D();
+					}
+					DesiredVelocity = Direction * MoveSpeed;
+				}
+			}
+			else {
+
+				TargetIndices[i] = INDEX_NONE;
+				MovementStatus[i] = EEnemyMovementStatus::EMS_Idle;
+			}
+
+			Velocities[i] = FMath::VInterpConstantTo(Velocities[i], DesiredVelocity, DeltaTime, Acceleration);
+			Positions[i] = Location + Velocities[i] * DeltaTime;
+		}
+	}, bSingleThreaded);
+}
+
+void UEnemyHordeSubsystem::SimulateAll(float DeltaTime, bool bSingleThreaded)
+{
+	GatherPlayers();
+	Simulate(0, Positions.Num(), DeltaTime, bSingleThreaded);
+
+	for (uint8& Request : Requests) {
+
+		Request = Request_None;
+	}
+}
+
+void UEnemyHordeSubsystem::ApplyRequests()
+{
+	SCOPE_CYCLE_COUNTER(STAT_HordeApply);
+
+	UWorld* World = GetWorld();
+	UActorPoolSubsystem* ActorPool = World->GetSubsystem<UActorPoolSubsystem>();
+	UNavigationSystemV1* NavSys = FNavigationSystem::GetCurrent<UNavigationSystemV1>(World);
+
+	// Minions wait in the simulation while the director has no room for more enemies
+	const AActionRPGGameModeBase* Director = World->GetAuthGameMode<AActionRPGGameModeBase>();
+
+	int32 Promotions = 0;
+
+	// Backwards, promoting swaps the last minion into the current slot
+	for (int32 i = Positions.Num() - 1; i >= 0; --i) {
+
+		const uint8 Request = Requests[i];
+		if (Request == Request_None) continue;
+
+		Requests[i] = Request_None;
+
+		UClass* Class = MinionClasses[ClassIndices[i]];
+		const AEnemy* Defaults = Class->GetDefaultObject<AEnemy>();
+		AMain* Target = Players.IsValidIndex(TargetIndices[i]) ? Players[TargetIndices[i]].Main : nullptr;
+
+		if ((Request & Request_Promote) && ActorPool && Promoted.Num() < MaxPromoted && Promotions < MaxPromotionsPerFrame && (!Director || Director->HasRoomForEnemy())) {
+
+			// The simulation only moves in the plane, settle the actor on the navmesh
+			FVector Location = Positions[i];
+			FNavLocation NavLocation;
+			if (NavSys && NavSys->ProjectPointToNavigation(Location, NavLocation, NavQueryExtent)) {
+
+				Location = NavLocation.Location;
+			}
+			Location.Z += Defaults->GetCapsuleComponent()->GetScaledCapsuleHalfHeight();
+
+			const FRotator Rotation = Velocities[i].IsNearlyZero() ? FRotator::ZeroRotator : FRotator(0.f, Velocities[i].Rotation().Yaw, 0.f);
+
+			AEnemy* Enemy = ActorPool->AcquireActor<AEnemy>(Class, FTransform(Rotation, Location));
+			if (Enemy) {
+
+				Enemy->Health = Health[i];
+				Promoted.Add(Enemy);
+
+				// The aggro subsystem only reports entering range, a minion already chasing keeps going
+				if (Target && MovementStatus[i] != EEnemyMovementStatus::EMS_Idle) {
+
+					Enemy->AggroTarget = Target;
+				}
+
+				RemoveMinion(i);
+				++Promotions;
+			}
+		}
+	}
+
+	INC_DWORD_STAT_BY(STAT_HordePromotions, Promotions);
+}
+
+void UEnemyHordeSubsystem::DemoteDistantEnemies()
+{
+	const float DemoteRadiusSq = FMath::Square(FMath::Max(DemoteRadius, PromoteRadius));
+
+	for (int32 i = Promoted.Num() - 1; i >= 0; --i) {
+
+		AEnemy* Enemy = Promoted[i];
+
+		// Dead enemies play out their own death and go back to the pool from there
+		if (!IsValid(Enemy) || !Enemy->Alive()) {
+
+			Promoted.RemoveAtSwap(i);
+			continue;
+		}
+
+		if (Enemy->CombatTarget || Enemy->bAttacking) continue;
+
+		const FVector Location = Enemy->GetActorLocation();
+
+		bool bNearPlayer = false;
+		for (const FPlayerSnapshot& Player : Players) {
+
+			if (FVector::DistSquared2D(Location, Player.Location) <= DemoteRadiusSq) {
+
+				bNearPlayer = true;
+				break;
+			}
+		}
+		if (bNearPlayer) continue;
+
+		const EEnemyMovementStatus Status = Enemy->GetEnemyMovementStatus() == EEnemyMovementStatus::EMS_MoveToTarget
+			? EEnemyMovementStatus::EMS_MoveToTarget
+			: EEnemyMovementStatus::EMS_Idle;
+
+		AddMinion(FindOrAddClass(Enemy->GetClass()), Location, Enemy->GetVelocity(), Enemy->Health, Status);
+
+		// Dropped first so the pool's ForgetEnemy call finds nothing to do
+		Promoted.RemoveAtSwap(i);
+		UActorPoolSubsystem::ReleaseOrDestroy(Enemy);
+
+		INC_DWORD_STAT(STAT_HordeDemotions);
+	}
+}
+
+bool UEnemyHordeSubsystem::IsTickable() const
+{
+	return !IsTemplate() && (Positions.Num() > 0 || Promoted.Num() > 0);
+}
+
+ETickableTickType UEnemyHordeSubsystem::GetTickableTickType() const
+{
+	return IsTemplate() ? ETickableTickType::Never : ETickableTickType::Conditional;
+}
+
+TStatId UEnemyHordeSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UEnemyHordeSubsystem, STATGROUP_Tickables);
+}
+
+void UEnemyHordeSubsystem::Tick(float DeltaTime)
+{
+	GatherPlayers();
+
+	const int32 Slices = FMath::Max(1, NumSlices);
+	if (SliceTime.Num() != Slices) {
+
+		SliceTime.Init(0.f, Slices);
+		NextSlice = 0;
+	}
+
+	for (float& Time : SliceTime) {
+
+		Time += DeltaTime;
+	}
+
+	// Each slice is stepped by the time it has been waiting, so throttled minions move at full speed
+	const int32 Num = Positions.Num();
+	const int32 Begin = Num * NextSlice / Slices;
+	const int32 End = Num * (NextSlice + 1) / Slices;
+
+	Simulate(Begin, End, SliceTime[NextSlice], false);
+
+	SliceTime[NextSlice] = 0.f;
+	NextSlice = (NextSlice + 1) % Slices;
+
+	ApplyRequests();
+	DemoteDistantEnemies();
+
+	SET_DWORD_STAT(STAT_HordeMinions, Positions.Num());
+	SET_DWORD_STAT(STAT_HordePromoted, Promoted.Num());
+}
+
+// ActionRPG.Horde.Spawn [Count] [Radius] [Class]
+// Scatters Count minions around the first player
+static FAutoConsoleCommandWithWorldAndArgs HordeSpawnCommand(
+	TEXT("ActionRPG.Horde.Spawn"),
+	TEXT("Adds simulated minions around the player. Usage: ActionRPG.Horde.Spawn [Count] [Radius] [Class]"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateStatic([](const TArray<FString>& Args, UWorld* World)
+	{
+		UEnemyHordeSubsystem* Horde = World ? World->GetSubsystem<UEnemyHordeSubsystem>() : nullptr;
+		APawn* Pawn = World ? UGameplayStatics::GetPlayerPawn(World, 0) : nullptr;
+		if (!Horde || !Pawn) return;
+
+		const int32 Count = Args.Num() > 0 ? FCString::Atoi(*Args[0]) : 1000;
+		const float Radius = Args.Num() > 1 ? FCString::Atof(*Args[1]) : 10000.f;
+
+		UClass* Class = AEnemy::StaticClass();
+		if (Args.Num() > 2) {
+
+			UClass* Found = LoadClass<AEnemy>(nullptr, *Args[2]);
+			if (Found) { Class = Found; }
+		}
+
+		Horde->SpawnMinions(Class, Pawn->GetActorLocation(), Radius, Count);
+
+		UE_LOG(LogActionRPG, Log, TEXT("Horde now has %d minions, %d promoted"), Horde->GetNumMinions(), Horde->GetNumPromoted());
+	}));
+
+// ActionRPG.Horde.Benchmark [Count] [Frames]
+// Adds Count minions around the player, steps all of them for Frames frames single threaded and in parallel, and removes them again
+static FAutoConsoleCommandWithWorldAndArgs HordeBenchmarkCommand(
+	TEXT("ActionRPG.Horde.Benchmark"),
+	TEXT("Measures horde simulation cost. Usage: ActionRPG.Horde.Benchmark [Count] [Frames]"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateStatic([](const TArray<FString>& Args, UWorld* World)
+	{
+		UEnemyHordeSubsystem* Horde = World ? World->GetSubsystem<UEnemyHordeSubsystem>() : nullptr;
+		if (!Horde) return;
+
+		const int32 Count = Args.Num() > 0 ? FCString::Atoi(*Args[0]) : 5000;
+		const int32 Frames = FMath::Max(1, Args.Num() > 1 ? FCString::Atoi(*Args[1]) : 60);
+		const float DeltaTime = 1.f / 30.f;
+
+		APawn* Pawn = UGameplayStatics::GetPlayerPawn(World, 0);
+		const FVector Center = Pawn ? Pawn->GetActorLocation() : FVector::ZeroVector;
+
+		// New minions go to the back, so trimming afterwards removes only the benchmark's own
+		const int32 PreviousCount = Horde->GetNumMinions();
+		Horde->SpawnMinions(AEnemy::StaticClass(), Center, 10000.f, Count);
+
+		double Start = FPlatformTime::Seconds();
+		for (int32 Frame = 0; Frame < Frames; ++Frame) {
+
+			Horde->SimulateAll(DeltaTime, true);
+		}
+		const double SingleSeconds = (FPlatformTime::Seconds() - Start) / Frames;
+
+		Start = FPlatformTime::Seconds();
+		for (int32 Frame = 0; Frame < Frames; ++Frame) {
+
+			Horde->SimulateAll(DeltaTime, false);
+		}
+		const double ParallelSeconds = (FPlatformTime::Seconds() - Start) / Frames;
+
+		Horde->TrimMinions(PreviousCount);
+
+		const int32 Slices = FMath::Max(1, Horde->NumSlices);
+		UE_LOG(LogActionRPG, Log, TEXT("Horde benchmark %d minions: single thread %.3f ms, parallel %.3f ms per full step, %.3f ms per frame at %d slices"),
+			Count, SingleSeconds * 1000.0, ParallelSeconds * 1000.0, ParallelSeconds * 1000.0 / Slices, Slices);
+	}));
@@ -0,0 +1,152 @@
+// Copyright by Hakan Akkurt
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "Tickable.h"
+#include "Enemy.h"
+#include "EnemyHordeSubsystem.generated.h"
+
+/**
+ * Simulates large numbers of minions without actors. Minion state lives in parallel arrays that are
+ * stepped in chunks with ParallelFor; minions that come within PromoteRadius of a player are handed a
+ * real AEnemy from the actor pool and handed back once they fall behind DemoteRadius.
+ * Simulated minions are not rendered, PromoteRadius should sit beyond what the player can make out.
+ */
+UCLASS(Config = Game)
+class ACTIONRPG_API UEnemyHordeSubsystem : public UWorldSubsystem, public FTickableGameObject
+{
+	GENERATED_BODY()
+
+public:
+
+	UEnemyHordeSubsystem();
+
+	// Minions closer than this to a player become AEnemy actors
+	UPROPERTY(Config, EditAnywhere, BlueprintReadOnly, Category = "Horde")
+	float PromoteRadius;
+
+	// Promoted enemies further than this from every player go back to being minions
+	UPROPERTY(Config, EditAnywhere, BlueprintReadOnly, Category = "Horde")
+	float DemoteRadius;
+
+	// Upper bound on live promoted enemies, minions past it keep fighting in the simulation
+	UPROPERTY(Config, EditAnywhere, BlueprintReadOnly, Category = "Horde")
+	int32 MaxPromoted;
+
+	// Promotions are spread over frames so a whole pack reaching the player doesn't spawn at once
+	UPROPERTY(Config, EditAnywhere, BlueprintReadOnly, Category = "Horde")
+	int32 MaxPromotionsPerFrame;
+
+	// Minions notice players this close and start chasing
+	UPROPERTY(Config, EditAnywhere, BlueprintReadOnly, Category = "Horde")
+	float AggroRadius;
+
+	// Minions stop this far from the player and wait to be promoted, only real enemies attack
+	UPROPERTY(Config, EditAnywhere, BlueprintReadOnly, Category = "Horde")
+	float AttackRange;
+
+	UPROPERTY(Config, EditAnywhere, BlueprintReadOnly, Category = "Horde")
+	float MoveSpeed;
+
+	UPROPERTY(Config, EditAnywhere, BlueprintReadOnly, Category = "Horde")
+	float Acceleration;
+
+	// The horde is split into this many slices and one slice is stepped per frame
+	UPROPERTY(Config, EditAnywhere, BlueprintReadOnly, Category = "Horde")
+	int32 NumSlices;
+
+	// Minions per ParallelFor task
+	UPROPERTY(Config, EditAnywhere, BlueprintReadOnly, Category = "Horde")
+	int32 ChunkSize;
+
+	// Adds Count minions of Class scattered within Radius of Center
+	UFUNCTION(BlueprintCallable, Category = "Horde")
+	void SpawnMinions(TSubclassOf<AEnemy> Class, FVector Center, float Radius, int32 Count);
+
+	// Removes every simulated minion, promoted enemies are left alone
+	UFUNCTION(BlueprintCallable, Category = "Horde")
+	void ClearMinions();
+
+	// Drops the most recently added minions until Count are left
+	void TrimMinions(int32 Count);
+
+	// Called by AEnemy when it leaves play or goes back to the pool
+	void ForgetEnemy(AEnemy* Enemy);
+
+	UFUNCTION(BlueprintPure, Category = "Horde")
+	int32 GetNumMinions() const { return Positions.Num(); }
+
+	UFUNCTION(BlueprintPure, Category = "Horde")
+	int32 GetNumPromoted() const { return Promoted.Num(); }
+
+	// Steps every minion by DeltaTime without promoting anyone, used by the benchmark
+	void SimulateAll(float DeltaTime, bool bSingleThreaded = false);
+
+	virtual bool ShouldCreateSubsystem(UObject* Outer) const override;
+
+	virtual void Deinitialize() override;
+
+	// FTickableGameObject
+	virtual void Tick(float DeltaTime) override;
+	virtual bool IsTickable() const override;
+	virtual ETickableTickType GetTickableTickType() const override;
+	virtual TStatId GetStatId() const override;
+	virtual UWorld* GetTickableGameObjectWorld() const override { return GetWorld(); }
+
+private:
+
+	// What the simulation wants the game thread to do with a minion after a step, as bit flags
+	enum EMinionRequest : uint8
+	{
+		Request_None = 0,
+		Request_Promote = 1 << 0
+	};
+
+	struct FPlayerSnapshot
+	{
+		class AMain* Main;
+		FVector Location;
+	};
+
+	// Steps minions [Begin, End) in parallel chunks
+	void Simulate(int32 Begin, int32 End, float DeltaTime, bool bSingleThreaded);
+
+	void ApplyRequests();
+
+	void DemoteDistantEnemies();
+
+	void GatherPlayers();
+
+	int32 AddMinion(uint8 ClassIndex, const FVector& Location, const FVector& Velocity, float InHealth, EEnemyMovementStatus Status);
+
+	void RemoveMinion(int32 Index);
+
+	uint8 FindOrAddClass(UClass* Class);
+
+	// Minion state, one entry per minion in every array
+	TArray<FVector> Positions;
+	TArray<FVector> Velocities;
+	TArray<float> Health;
+	TArray<EEnemyMovementStatus> MovementStatus;
+	TArray<uint8> ClassIndices;
+	TArray<int16> TargetIndices;
+	TArray<uint8> Requests;
+
+	UPROPERTY()
+	TArray<UClass*> MinionClasses;
+
+	// Archetype of each entry in MinionClasses, kept alive by the class defaults
+	TArray<const class UEnemyArchetype*> MinionArchetypes;
+
+	// Real enemies currently standing in for a minion
+	UPROPERTY()
+	TArray<AEnemy*> Promoted;
+
+	TArray<FPlayerSnapshot> Players;
+
+	// Time each slice has gone without a step
+	TArray<float> SliceTime;
+	int32 NextSlice;
+};
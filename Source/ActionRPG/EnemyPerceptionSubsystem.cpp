@@ -0,0 +1,157 @@
+// Copyright by Hakan Akkurt
+
+
+#include "EnemyPerceptionSubsystem.h"
+#include "ActionRPG.h"
+#include "Enemy.h"
+#include "Main.h"
+#include "Engine/World.h"
+
+DECLARE_DWORD_COUNTER_STAT(TEXT("Perception Queue Depth"), STAT_PerceptionQueueDepth, STATGROUP_ActionRPG);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Perception Traces"), STAT_PerceptionTraces, STATGROUP_ActionRPG);
+DECLARE_FLOAT_COUNTER_STAT(TEXT("Perception Latency (ms)"), STAT_PerceptionLatency, STATGROUP_ActionRPG);
+
+UEnemyPerceptionSubsystem::UEnemyPerceptionSubsystem()
+{
+	bRequireLineOfSight = true;
+	MaxTracesPerFrame = 16;
+	TraceChannel = ECC_Visibility;
+	ResultLifetime = 0.5f;
+
+	NextTraceId = 0;
+	AverageLatency = 0.f;
+}
+
+bool UEnemyPerceptionSubsystem::ShouldCreateSubsystem(UObject* Outer) const
+{
+	UWorld* World = Cast<UWorld>(Outer);
+	return World && World->IsGameWorld();
+}
+
+void UEnemyPerceptionSubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+
+	TraceDelegate.BindUObject(this, &UEnemyPerceptionSubsystem::OnTraceCompleted);
+}
+
+void UEnemyPerceptionSubsystem::Deinitialize()
+{
+	TraceDelegate.Unbind();
+	States.Empty();
+	Queue.Empty();
+	InFlight.Empty();
+
+	Super::Deinitialize();
+}
+
+void UEnemyPerceptionSubsystem::RequestLineOfSight(AEnemy* Enemy, AMain* Target)
+{
+	if (!bRequireLineOfSight || !Enemy || !Target) return;
+
+	FSightState& State = States.FindOrAdd(Enemy);
+	if (State.Target.Get() != Target) {
+
+		// An answer about someone else says nothing about this target, in flight or not
+		State.Target = Target;
+		State.bVisible = false;
+		State.PendingTrace = 0;
+	}
+
+	if (State.bQueued || State.PendingTrace != 0) return;
+
+	State.bQueued = true;
+	State.RequestTime = GetWorld()->GetTimeSeconds();
+	Queue.Add(Enemy);
+}
+
+bool UEnemyPerceptionSubsystem::HasLineOfSight(const AEnemy* Enemy, const AMain* Target) const
+{
+	if (!bRequireLineOfSight) return true;
+
+	const FSightState* State = States.Find(Enemy);
+	return State && State->bVisible && State->Target.Get() == Target && GetWorld()->GetTimeSeconds() - State->ResultTime <= ResultLifetime;
+}
+
+void UEnemyPerceptionSubsystem::ForgetEnemy(AEnemy* Enemy)
+{
+	// A trace still in flight finds no state when it comes back and is dropped
+	if (States.Remove(Enemy) > 0) {
+
+		Queue.RemoveSingle(Enemy);
+	}
+}
+
+bool UEnemyPerceptionSubsystem::IsTickable() const
+{
+	return !IsTemplate() && Queue.Num() > 0;
+}
+
+ETickableTickType UEnemyPerceptionSubsystem::GetTickableTickType() const
+{
+	return IsTemplate() ? ETickableTickType::Never : ETickableTickType::Conditional;
+}
+
+TStatId UEnemyPerceptionSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UEnemyPerceptionSubsystem, STATGROUP_Tickables);
+}
+
+void UEnemyPerceptionSubsystem::Tick(float DeltaTime)
+{
+	UWorld* World = GetWorld();
+
+	const int32 NumToSubmit = FMath::Min(Queue.Num(), FMath::Max(MaxTracesPerFrame, 1));
+	int32 Submitted = 0;
+
+	for (int32 i = 0; i < NumToSubmit; ++i) {
+
+		AEnemy* Enemy = Queue[i];
+		FSightState* State = States.Find(Enemy);
+		if (!State) continue;
+
+		State->bQueued = false;
+
+		AMain* Target = State->Target.Get();
+		if (!Target) continue;
+
+		FCollisionQueryParams Params(SCENE_QUERY_STAT(EnemyLineOfSight), false, Enemy);
+		Params.AddIgnoredActor(Target);
+
+		// 0 is reserved for no trace
+		if (++NextTraceId == 0) {
+
+			++NextTraceId;
+		}
+		State->PendingTrace = NextTraceId;
+		InFlight.Add(NextTraceId, Enemy);
+
+		World->AsyncLineTraceByChannel(EAsyncTraceType::Single, Enemy->GetPawnViewLocation(), Target->GetPawnViewLocation(),
+			TraceChannel, Params, FCollisionResponseParams::DefaultResponseParam, &TraceDelegate, NextTraceId);
+		++Submitted;
+	}
+
+	Queue.RemoveAt(0, NumToSubmit, false);
+
+	INC_DWORD_STAT_BY(STAT_PerceptionTraces, Submitted);
+	SET_DWORD_STAT(STAT_PerceptionQueueDepth, Queue.Num());
+}
+
+void UEnemyPerceptionSubsystem::OnTraceCompleted(const FTraceHandle& Handle, FTraceDatum& Data)
+{
+	// Results come in at the start of the next frame, matched back up by the id in UserData
+	AEnemy* Enemy = nullptr;
+	if (!InFlight.RemoveAndCopyValue(Data.UserData, Enemy)) return;
+
+	// Forgotten or re-requested since, either way this answer is stale
+	FSightState* State = States.Find(Enemy);
+	if (!State || State->PendingTrace != Data.UserData) return;
+
+	State->PendingTrace = 0;
+	State->bVisible = !Data.OutHits.ContainsByPredicate([](const FHitResult& Hit) { return Hit.bBlockingHit; });
+	State->ResultTime = GetWorld()->GetTimeSeconds();
+
+	const float Latency = State->ResultTime - State->RequestTime;
+	AverageLatency = FMath::Lerp(AverageLatency, Latency, 0.1f);
+	SET_FLOAT_STAT(STAT_PerceptionLatency, AverageLatency * 1000.f);
+}
@@ -0,0 +1,94 @@
+// Copyright by Hakan Akkurt
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "Tickable.h"
+#include "WorldCollision.h"
+#include "EnemyPerceptionSubsystem.generated.h"
+
+/**
+ * Line of sight from enemies to players, answered by async traces. Requests are queued and at most
+ * MaxTracesPerFrame of them are submitted each frame in the order they were asked for; results land
+ * the following frame. UEnemyAggroSubsystem asks for every enemy in aggro range and only lets it aggro
+ * once the last answer says it can see the player, so requests keep cycling round-robin while in range.
+ */
+UCLASS(Config = Game)
+class ACTIONRPG_API UEnemyPerceptionSubsystem : public UWorldSubsystem, public FTickableGameObject
+{
+	GENERATED_BODY()
+
+public:
+
+	UEnemyPerceptionSubsystem();
+
+	// Off lets enemies aggro through walls again, the way the overlap spheres did
+	UPROPERTY(Config, EditAnywhere, BlueprintReadOnly, Category = "Perception")
+	bool bRequireLineOfSight;
+
+	UPROPERTY(Config, EditAnywhere, BlueprintReadOnly, Category = "Perception")
+	int32 MaxTracesPerFrame;
+
+	UPROPERTY(Config, EditAnywhere, BlueprintReadOnly, Category = "Perception")
+	TEnumAsByte<ECollisionChannel> TraceChannel;
+
+	// Game seconds after which an answer no longer counts, enemies that left range and came back have to look again
+	UPROPERTY(Config, EditAnywhere, BlueprintReadOnly, Category = "Perception")
+	float ResultLifetime;
+
+	// Queues a sight check from Enemy to Target unless one is already on its way
+	void RequestLineOfSight(class AEnemy* Enemy, class AMain* Target);
+
+	// Last known answer for Enemy looking at Target, false until a trace towards Target has come back
+	bool HasLineOfSight(const AEnemy* Enemy, const AMain* Target) const;
+
+	void ForgetEnemy(AEnemy* Enemy);
+
+	FORCEINLINE int32 GetQueueDepth() const { return Queue.Num(); }
+
+	// Seconds from request to result, smoothed over recent results
+	FORCEINLINE float GetAverageLatency() const { return AverageLatency; }
+
+	virtual bool ShouldCreateSubsystem(UObject* Outer) const override;
+
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+
+	virtual void Deinitialize() override;
+
+	// FTickableGameObject
+	virtual void Tick(float DeltaTime) override;
+	virtual bool IsTickable() const override;
+	virtual ETickableTickType GetTickableTickType() const override;
+	virtual TStatId GetStatId() const override;
+	virtual UWorld* GetTickableGameObjectWorld() const override { return GetWorld(); }
+
+private:
+
+	struct FSightState
+	{
+		TWeakObjectPtr<AMain> Target;
+		double RequestTime = 0.0;
+		double ResultTime = 0.0;
+		uint32 PendingTrace = 0;
+		bool bQueued = false;
+		bool bVisible = false;
+	};
+
+	void OnTraceCompleted(const FTraceHandle& Handle, FTraceDatum& Data);
+
+	TMap<AEnemy*, FSightState> States;
+
+	// Enemies waiting for a trace slot, oldest first
+	TArray<AEnemy*> Queue;
+
+	// Submitted trace ids and who asked for them
+	TMap<uint32, AEnemy*> InFlight;
+
+	FTraceDelegate TraceDelegate;
+
+	// Identifies a submitted trace in its UserData, 0 means none
+	uint32 NextTraceId;
+
+	float AverageLatency;
+};
@@ -0,0 +1,312 @@
+// Copyright by Hakan Akkurt
+
+
+#include "EnemySignificanceSubsystem.h"
+#include "ActionRPG.h"
+#include "Enemy.h"
+#include "Main.h"
+#include "Engine/World.h"
+#include "ActorPoolSubsystem.h"
+#include "Kismet/GameplayStatics.h"
+#include "Camera/PlayerCameraManager.h"
+#include "Components/SkeletalMeshComponent.h"
+#include "GameFramework/CharacterMovementComponent.h"
+
+DECLARE_CYCLE_STAT(TEXT("Significance Update"), STAT_SignificanceUpdate, STATGROUP_ActionRPG);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Significance Bucket 0"), STAT_SignificanceBucket0, STATGROUP_ActionRPG);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Significance Bucket 1"), STAT_SignificanceBucket1, STATGROUP_ActionRPG);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Significance Bucket 2"), STAT_SignificanceBucket2, STATGROUP_ActionRPG);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Significance Bucket 3"), STAT_SignificanceBucket3, STATGROUP_ActionRPG);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Movement Walking"), STAT_MovementWalking, STATGROUP_ActionRPG);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Movement NavWalking"), STAT_MovementNavWalking, STATGROUP_ActionRPG);
+
+UEnemySignificanceSubsystem::UEnemySignificanceSubsystem()
+{
+	// Near: full rate
+	FEnemySignificanceBucket Near;
+	Near.MaxDistance = 2000.f;
+	Near.MaxCount = 24;
+	Buckets.Add(Near);
+
+	// Mid: half rate movement and anim, URO on, navmesh walking
+	FEnemySignificanceBucket Mid;
+	Mid.MaxDistance = 4500.f;
+	Mid.ActorTickInterval = 0.1f;
+	Mid.MovementTickInterval = 1.f / 30.f;
+	Mid.AnimTickInterval = 1.f / 30.f;
+	Mid.bUpdateRateOptimizations = true;
+	Mid.bNavWalking = true;
+	Buckets.Add(Mid);
+
+	// Far: coarse updates, pose only while visible
+	FEnemySignificanceBucket Far;
+	Far.MaxDistance = 9000.f;
+	Far.ActorTickInterval = 0.25f;
+	Far.MovementTickInterval = 0.1f;
+	Far.AnimTickInterval = 0.1f;
+	Far.bUpdateRateOptimizations = true;
+	Far.bNavWalking = true;
+	Far.bOnlyTickPoseWhenRendered = true;
+	Buckets.Add(Far);
+
+	// Dormant: everything else
+	FEnemySignificanceBucket Dormant;
+	Dormant.MaxDistance = BIG_NUMBER;
+	Dormant.ActorTickInterval = 1.f;
+	Dormant.MovementTickInterval = 0.5f;
+	Dormant.AnimTickInterval = 0.5f;
+	Dormant.bUpdateRateOptimizations = true;
+	Dormant.bNavWalking = true;
+	Dormant.bOnlyTickPoseWhenRendered = true;
+	Buckets.Add(Dormant);
+
+	OffscreenDistanceScale = 2.f;
+	ViewConeHalfAngle = 60.f;
+
+	FMemory::Memzero(BucketPopulation);
+}
+
+bool UEnemySignificanceSubsystem::ShouldCreateSubsystem(UObject* Outer) const
+{
+	UWorld* World = Cast<UWorld>(Outer);
+	return World && World->IsGameWorld();
+}
+
+void UEnemySignificanceSubsystem::Deinitialize()
+{
+	Enemies.Empty();
+
+	Super::Deinitialize();
+}
+
+void UEnemySignificanceSubsystem::RegisterEnemy(AEnemy* Enemy)
+{
+	if (Enemy) {
+
+		Enemies.AddUnique(Enemy);
+		Enemy->SignificanceBucket = INDEX_NONE;
+	}
+}
+
+void UEnemySignificanceSubsystem::UnregisterEnemy(AEnemy* Enemy)
+{
+	Enemies.RemoveSwap(Enemy);
+}
+
+int32 UEnemySignificanceSubsystem::GetBucketPopulation(int32 Bucket) const
+{
+	return (Bucket >= 0 && Bucket < MaxBuckets) ? BucketPopulation[Bucket] : 0;
+}
+
+bool UEnemySignificanceSubsystem::IsTickable() const
+{
+	return !IsTemplate() && Buckets.Num() > 0 && Enemies.Num() > 0;
+}
+
+ETickableTickType UEnemySignificanceSubsystem::GetTickableTickType() const
+{
+	return IsTemplate() ? ETickableTickType::Never : ETickableTickType::Conditional;
+}
+
+TStatId UEnemySignificanceSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UEnemySignificanceSubsystem, STATGROUP_Tickables);
+}
+
+void UEnemySignificanceSubsystem::Tick(float DeltaTime)
+{
+	SCOPE_CYCLE_COUNTER(STAT_SignificanceUpdate);
+
+	UWorld* World = GetWorld();
+	AMain* Main = Cast<AMain>(UGameplayStatics::GetPlayerPawn(World, 0));
+	if (!Main) return;
+
+	const FVector PlayerLocation = Main->GetActorLocation();
+	FVector ViewLocation = PlayerLocation;
+	FVector ViewDirection = Main->GetActorForwardVector();
+
+	APlayerCameraManager* CameraManager = UGameplayStatics::GetPlayerCameraManager(World, 0);
+	if (CameraManager) {
+
+		ViewLocation = CameraManager->GetCameraLocation();
+		ViewDirection = CameraManager->GetCameraRotation().Vector();
+	}
+	const float ViewConeCos = FMath::Cos(FMath::DegreesToRadians(ViewConeHalfAngle));
+
+	// Score every enemy, lower is more significant
+	TArray<TPair<float, AEnemy*>> Ranked;
+	Ranked.Reserve(Enemies.Num());
+
+	for (AEnemy* Enemy : Enemies) {
+
+		if (!Enemy) continue;
+
+		const FVector EnemyLocation = Enemy->GetActorLocation();
+		float Score = FVector::Dist(EnemyLocation, PlayerLocation);
+
+		const FVector ToEnemy = (EnemyLocation - ViewLocation).GetSafeNormal();
+		if (FVector::DotProduct(ToEnemy, ViewDirection) < ViewConeCos) {
+
+			Score *= OffscreenDistanceScale;
+		}
+
+		// Enemies engaged in a fight always run at full rate
+		if (Enemy->bOverlappingCombatSphere || Enemy->bAttacking) {
+
+			Score = 0.f;
+		}
+
+		Enemy->SignificanceScore = Score;
+		Ranked.Emplace(Score, Enemy);
+	}
+
+	Ranked.Sort([](const TPair<float, AEnemy*>& A, const TPair<float, AEnemy*>& B) { return A.Key < B.Key; });
+
+	const int32 NumBuckets = FMath::Min(Buckets.Num(), MaxBuckets);
+	FMemory::Memzero(BucketPopulation);
+
+	int32 Bucket = 0;
+	int32 NumNavWalking = 0;
+	for (const TPair<float, AEnemy*>& Entry : Ranked) {
+
+		while (Bucket < NumBuckets - 1) {
+
+			const FEnemySignificanceBucket& Settings = Buckets[Bucket];
+			const bool bFull = Settings.MaxCount > 0 && BucketPopulation[Bucket] >= Settings.MaxCount;
+
+			if (Entry.Key <= Settings.MaxDistance && !bFull) break;
+			++Bucket;
+		}
+
+		++BucketPopulation[Bucket];
+		if (Entry.Value->SignificanceBucket != Bucket) {
+
+			ApplyBucket(Entry.Value, Bucket);
+		}
+
+		if (Entry.Value->GetCharacterMovement()->MovementMode == MOVE_NavWalking) {
+
+			++NumNavWalking;
+		}
+	}
+
+	SET_DWORD_STAT(STAT_SignificanceBucket0, BucketPopulation[0]);
+	SET_DWORD_STAT(STAT_SignificanceBucket1, BucketPopulation[1]);
+	SET_DWORD_STAT(STAT_SignificanceBucket2, BucketPopulation[2]);
+	SET_DWORD_STAT(STAT_SignificanceBucket3, BucketPopulation[3]);
+	SET_DWORD_STAT(STAT_MovementWalking, Ranked.Num() - NumNavWalking);
+	SET_DWORD_STAT(STAT_MovementNavWalking, NumNavWalking);
+}
+
+void UEnemySignificanceSubsystem::ApplyBucket(AEnemy* Enemy, int32 Bucket)
+{
+	const FEnemySignificanceBucket& Settings = Buckets[Bucket];
+	Enemy->SignificanceBucket = Bucket;
+
+	// Combined with the interval the enemy's AI state asks for
+	Enemy->RefreshTickRates();
+
+	UCharacterMovementComponent* Movement = Enemy->GetCharacterMovement();
+	if (Movement) {
+
+		Movement->SetComponentTickInterval(Settings.MovementTickInterval);
+
+		// Only swaps the mode right away while on the ground, a falling enemy picks it up when it lands
+		Movement->SetGroundMovementMode(Settings.bNavWalking ? MOVE_NavWalking : MOVE_Walking);
+	}
+
+	USkeletalMeshComponent* Mesh = Enemy->GetMesh();
+	if (Mesh) {
+
+		Mesh->SetComponentTickInterval(Settings.AnimTickInterval);
+		Mesh->bEnableUpdateRateOptimizations = Settings.bUpdateRateOptimizations;
+
+		if (Settings.bOnlyTickPoseWhenRendered) {
+
+			Mesh->VisibilityBasedAnimTickOption = EVisibilityBasedAnimTickOption::OnlyTickPoseWhenRendered;
+		}
+		else {
+
+			// Restore whatever the enemy's class was authored with
+			const AEnemy* Defaults = Enemy->GetClass()->GetDefaultObject<AEnemy>();
+			Mesh->VisibilityBasedAnimTickOption = Defaults->GetMesh()->VisibilityBasedAnimTickOption;
+		}
+	}
+}
+
+// ActionRPG.Movement.Benchmark [Count] [Frames] [Class]
+// Ticks the movement of Count enemies walking in a straight line, first in full walking and then in NavWalking, and logs the cost per enemy tick
+static FAutoConsoleCommandWithWorldAndArgs MovementBenchmarkCommand(
+	TEXT("ActionRPG.Movement.Benchmark"),
+	TEXT("Compares enemy movement cost in Walking and NavWalking. Usage: ActionRPG.Movement.Benchmark [Count] [Frames] [Class]"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateStatic([](const TArray<FString>& Args, UWorld* World)
+	{
+		UActorPoolSubsystem* ActorPool = World ? World->GetSubsystem<UActorPoolSubsystem>() : nullptr;
+		APawn* PlayerPawn = World ? UGameplayStatics::GetPlayerPawn(World, 0) : nullptr;
+		if (!ActorPool || !PlayerPawn) return;
+
+		const int32 Count = Args.Num() > 0 ? FCString::Atoi(*Args[0]) : 100;
+		const int32 Frames = FMath::Max(1, Args.Num() > 1 ? FCString::Atoi(*Args[1]) : 60);
+		const float DeltaTime = 1.f / 60.f;
+
+		UClass* Class = AEnemy::StaticClass();
+		if (Args.Num() > 2) {
+
+			UClass* Found = LoadClass<AEnemy>(nullptr, *Args[2]);
+			if (Found) { Class = Found; }
+		}
+
+		// A grid next to the player so everyone starts on the same floor
+		const int32 Columns = FMath::CeilToInt(FMath::Sqrt((float)Count));
+		const FVector Origin = PlayerPawn->GetActorLocation() + FVector(500.f, 0.f, 0.f);
+
+		TArray<AEnemy*> Enemies;
+		TArray<FVector> StartLocations;
+		TArray<EMovementMode> StartModes;
+		for (int32 i = 0; i < Count; ++i) {
+
+			const FVector Location = Origin + FVector((i / Columns) * 150.f, (i % Columns) * 150.f, 0.f);
+			AEnemy* Enemy = ActorPool->AcquireActor<AEnemy>(Class, FTransform(Location));
+			if (Enemy) {
+
+				Enemies.Add(Enemy);
+				StartLocations.Add(Location);
+				StartModes.Add(Enemy->GetCharacterMovement()->MovementMode);
+			}
+		}
+
+		const EMovementMode Modes[] = { MOVE_Walking, MOVE_NavWalking };
+		double Seconds[2] = { 0.0, 0.0 };
+
+		for (int32 ModeIndex = 0; ModeIndex < 2; ++ModeIndex) {
+
+			for (int32 i = 0; i < Enemies.Num(); ++i) {
+
+				Enemies[i]->SetActorLocation(StartLocations[i], false, nullptr, ETeleportType::ResetPhysics);
+				Enemies[i]->GetCharacterMovement()->SetMovementMode(Modes[ModeIndex]);
+			}
+
+			const double Start = FPlatformTime::Seconds();
+			for (int32 Frame = 0; Frame < Frames; ++Frame) {
+
+				for (AEnemy* Enemy : Enemies) {
+
+					UCharacterMovementComponent* Movement = Enemy->GetCharacterMovement();
+					Enemy->AddMovementInput(FVector::ForwardVector);
+					Movement->TickComponent(DeltaTime, LEVELTICK_All, &Movement->PrimaryComponentTick);
+				}
+			}
+			Seconds[ModeIndex] = FPlatformTime::Seconds() - Start;
+		}
+
+		// Pooled enemies would otherwise come back out of the pool still in the last mode tested
+		for (int32 i = 0; i < Enemies.Num(); ++i) {
+
+			Enemies[i]->GetCharacterMovement()->SetMovementMode(StartModes[i]);
+			UActorPoolSubsystem::ReleaseOrDestroy(Enemies[i]);
+		}
+
+		const double Ticks = FMath::Max(1, Enemies.Num() * Frames);
+		UE_LOG(LogActionRPG, Log, TEXT("Movement benchmark %d enemies x%d frames: Walking %.2f us, NavWalking %.2f us per enemy tick"),
+			Enemies.Num(), Frames, Seconds[0] * 1000000.0 / Ticks, Seconds[1] * 1000000.0 / Ticks);
+	}));
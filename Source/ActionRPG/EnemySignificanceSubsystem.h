@@ -0,0 +1,105 @@
+// Copyright by Hakan Akkurt
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "Tickable.h"
+#include "EnemySignificanceSubsystem.generated.h"
+
+// Throttling applied to every enemy that ranks into a bucket
+USTRUCT(BlueprintType)
+struct FEnemySignificanceBucket
+{
+	GENERATED_BODY()
+
+	// Enemies whose weighted distance to the player is below this fall into the bucket
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Significance")
+	float MaxDistance = 0.f;
+
+	// How many enemies the bucket may hold before the rest spill into the next one, 0 means no limit
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Significance")
+	int32 MaxCount = 0;
+
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Significance")
+	float ActorTickInterval = 0.f;
+
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Significance")
+	float MovementTickInterval = 0.f;
+
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Significance")
+	float AnimTickInterval = 0.f;
+
+	// Let the skeletal mesh skip and interpolate frames based on screen size
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Significance")
+	bool bUpdateRateOptimizations = false;
+
+	// Stop evaluating the pose entirely while the mesh is not rendered
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Significance")
+	bool bOnlyTickPoseWhenRendered = false;
+
+	// Move along the navmesh instead of sweeping for the floor and stepping up every tick
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Significance")
+	bool bNavWalking = false;
+};
+
+/**
+ * Ranks every AEnemy by distance and view direction relative to AMain once per frame
+ * and throttles actor, movement and animation ticking by the bucket it lands in.
+ * Less significant buckets also drop enemies from full walking to NavWalking.
+ * Buckets can be overridden in DefaultGame.ini under [/Script/ActionRPG.EnemySignificanceSubsystem].
+ */
+UCLASS(Config = Game)
+class ACTIONRPG_API UEnemySignificanceSubsystem : public UWorldSubsystem, public FTickableGameObject
+{
+	GENERATED_BODY()
+
+public:
+
+	UEnemySignificanceSubsystem();
+
+	static const int32 MaxBuckets = 4;
+
+	// Ordered from most to least significant, at most MaxBuckets are used
+	UPROPERTY(Config, EditAnywhere, BlueprintReadOnly, Category = "Significance")
+	TArray<FEnemySignificanceBucket> Buckets;
+
+	// Enemies outside the camera's view cone count as this much further away
+	UPROPERTY(Config, EditAnywhere, BlueprintReadOnly, Category = "Significance")
+	float OffscreenDistanceScale;
+
+	UPROPERTY(Config, EditAnywhere, BlueprintReadOnly, Category = "Significance")
+	float ViewConeHalfAngle;
+
+	void RegisterEnemy(class AEnemy* Enemy);
+
+	void UnregisterEnemy(AEnemy* Enemy);
+
+	FORCEINLINE const TArray<AEnemy*>& GetEnemies() const { return Enemies; }
+
+	// Settings for Bucket, null for INDEX_NONE or a bucket that isn't configured
+	FORCEINLINE const FEnemySignificanceBucket* GetBucket(int32 Bucket) const { return Buckets.IsValidIndex(Bucket) ? &Buckets[Bucket] : nullptr; }
+
+	UFUNCTION(BlueprintPure, Category = "Significance")
+	int32 GetBucketPopulation(int32 Bucket) const;
+
+	virtual bool ShouldCreateSubsystem(UObject* Outer) const override;
+
+	virtual void Deinitialize() override;
+
+	// FTickableGameObject
+	virtual void Tick(float DeltaTime) override;
+	virtual bool IsTickable() const override;
+	virtual ETickableTickType GetTickableTickType() const override;
+	virtual TStatId GetStatId() const override;
+	virtual UWorld* GetTickableGameObjectWorld() const override { return GetWorld(); }
+
+private:
+
+	void ApplyBucket(AEnemy* Enemy, int32 Bucket);
+
+	UPROPERTY()
+	TArray<AEnemy*> Enemies;
+
+	int32 BucketPopulation[MaxBuckets];
+};
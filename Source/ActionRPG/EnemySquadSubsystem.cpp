@@ -0,0 +1,297 @@
+// Copyright by Hakan Akkurt
+
+
+#include "EnemySquadSubsystem.h"
+#include "ActionRPG.h"
+#include "Enemy.h"
+#include "Main.h"
+#include "AIController.h"
+#include "EnemyDecisionSubsystem.h"
+#include "EnemyFlowFieldSubsystem.h"
+#include "Engine/World.h"
+
+DECLARE_CYCLE_STAT(TEXT("Squad Regroup"), STAT_SquadRegroup, STATGROUP_ActionRPG);
+DECLARE_CYCLE_STAT(TEXT("Squad Formations"), STAT_SquadFormations, STATGROUP_ActionRPG);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Squads"), STAT_Squads, STATGROUP_ActionRPG);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Squad Followers In Formation"), STAT_SquadInFormation, STATGROUP_ActionRPG);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Squad Formation Moves"), STAT_SquadFormationMoves, STATGROUP_ActionRPG);
+
+UEnemySquadSubsystem::UEnemySquadSubsystem()
+{
+	bEnabled = true;
+	SquadRadius = 800.f;
+	MaxSquadSize = 8;
+	RegroupInterval = 1.f;
+	EngageRadius = 600.f;
+	FormationSpacing = 150.f;
+	FormationUpdateInterval = 0.5f;
+
+	RegroupCountdown = 0.f;
+}
+
+bool UEnemySquadSubsystem::ShouldCreateSubsystem(UObject* Outer) const
+{
+	UWorld* World = Cast<UWorld>(Outer);
+	return World && World->IsGameWorld();
+}
+
+void UEnemySquadSubsystem::Deinitialize()
+{
+	Squads.Empty();
+	Formation.Empty();
+
+	Super::Deinitialize();
+}
+
+AMain* UEnemySquadSubsystem::GetSquadTarget(const AEnemy* Enemy) const
+{
+	return Enemy && Squads.IsValidIndex(Enemy->SquadIndex) ? Squads[Enemy->SquadIndex].Target.Get() : nullptr;
+}
+
+void UEnemySquadSubsystem::ForgetEnemy(AEnemy* Enemy)
+{
+	if (Enemy->bInFormation) {
+
+		Formation.RemoveSwap(Enemy);
+		Enemy->bInFormation = false;
+	}
+
+	if (!Squads.IsValidIndex(Enemy->SquadIndex)) return;
+
+	FEnemySquad& Squad = Squads[Enemy->SquadIndex];
+	Enemy->SquadIndex = INDEX_NONE;
+
+	if (Squad.Leader == Enemy) {
+
+		// The first follower takes over until the next regroup
+		Squad.Leader = Squad.Followers.Num() > 0 ? Squad.Followers[0] : nullptr;
+		if (Squad.Leader) {
+
+			Squad.Followers.RemoveAt(0);
+		}
+	}
+	else {
+
+		Squad.Followers.Remove(Enemy);
+	}
+}
+
+bool UEnemySquadSubsystem::IsTickable() const
+{
+	// Keeps ticking while squads are left so the last regroup can disband them
+	const UEnemyDecisionSubsystem* Decisions = GetWorld() ? GetWorld()->GetSubsystem<UEnemyDecisionSubsystem>() : nullptr;
+	return !IsTemplate() && bEnabled && (Squads.Num() > 0 || (Decisions && Decisions->GetEnemies().Num() > 0));
+}
+
+ETickableTickType UEnemySquadSubsystem::GetTickableTickType() const
+{
+	return IsTemplate() ? ETickableTickType::Never : ETickableTickType::Conditional;
+}
+
+TStatId UEnemySquadSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UEnemySquadSubsystem, STATGROUP_Tickables);
+}
+
+void UEnemySquadSubsystem::Tick(float DeltaTime)
+{
+	RegroupCountdown -= DeltaTime;
+	if (RegroupCountdown <= 0.f) {
+
+		RegroupCountdown = RegroupInterval;
+		Regroup();
+	}
+
+	UpdateFormations();
+
+	SET_DWORD_STAT(STAT_Squads, Squads.Num());
+	SET_DWORD_STAT(STAT_SquadInFormation, Formation.Num());
+}
+
+void UEnemySquadSubsystem::Regroup()
+{
+	SCOPE_CYCLE_COUNTER(STAT_SquadRegroup);
+
+	for (const FEnemySquad& Squad : Squads) {
+
+		if (Squad.Leader) { Squad.Leader->SquadIndex = INDEX_NONE; }
+		for (AEnemy* Follower : Squad.Followers) {
+
+			Follower->SquadIndex = INDEX_NONE;
+		}
+	}
+	Squads.Reset();
+
+	UEnemyDecisionSubsystem* Decisions = GetWorld()->GetSubsystem<UEnemyDecisionSubsystem>();
+	const int32 MaxFollowers = MaxSquadSize - 1;
+	if (!Decisions || MaxFollowers < 1 || SquadRadius <= 0.f) return;
+
+	TArray<AEnemy*> Candidates;
+	for (AEnemy* Enemy : Decisions->GetEnemies()) {
+
+		if (Enemy && Enemy->Alive()) {
+
+			Candidates.Add(Enemy);
+		}
+	}
+
+	// Enemies already after someone lead first, so a chasing squad keeps its target through a regroup
+	Candidates.StableSort([](const AEnemy& A, const AEnemy& B) { return A.AggroTarget && !B.AggroTarget; });
+
+	auto GetCell = [this](const FVector& Location)
+	{
+		return FIntPoint(FMath::FloorToInt(Location.X / SquadRadius), FMath::FloorToInt(Location.Y / SquadRadius));
+	};
+
+	TMap<FIntPoint, TArray<int32>> Grid;
+	for (int32 Index = 0; Index < Candidates.Num(); ++Index) {
+
+		Grid.FindOrAdd(GetCell(Candidates[Index]->GetActorLocation())).Add(Index);
+	}
+
+	const float RadiusSq = FMath::Square(SquadRadius);
+
+	for (AEnemy* Leader : Candidates) {
+
+		if (Leader->SquadIndex != INDEX_NONE) continue;
+
+		const FVector LeaderLocation = Leader->GetActorLocation();
+		const FIntPoint LeaderCell = GetCell(LeaderLocation);
+
+		FEnemySquad Squad;
+		Squad.Leader = Leader;
+
+		for (int32 X = LeaderCell.X - 1; X <= LeaderCell.X + 1 && Squad.Followers.Num() < MaxFollowers; ++X) {
+
+			for (int32 Y = LeaderCell.Y - 1; Y <= LeaderCell.Y + 1 && Squad.Followers.Num() < MaxFollowers; ++Y) {
+
+				const TArray<int32>* Cell = Grid.Find(FIntPoint(X, Y));
+				if (!Cell) continue;
+
+				for (int32 Index : *Cell) {
+
+					AEnemy* Other = Candidates[Index];
+					if (Other == Leader || Other->SquadIndex != INDEX_NONE) continue;
+					if (FVector::DistSquared(Other->GetActorLocation(), LeaderLocation) > RadiusSq) continue;
+
+					Squad.Followers.Add(Other);
+					if (Squad.Followers.Num() >= MaxFollowers) break;
+				}
+			}
+		}
+
+		// Alone is no squad
+		if (Squad.Followers.Num() == 0) continue;
+
+		const int32 SquadIndex = Squads.Num();
+		Leader->SquadIndex = SquadIndex;
+		for (AEnemy* Follower : Squad.Followers) {
+
+			Follower->SquadIndex = SquadIndex;
+		}
+		Squads.Add(MoveTemp(Squad));
+	}
+}
+
+void UEnemySquadSubsystem::UpdateFormations()
+{
+	SCOPE_CYCLE_COUNTER(STAT_SquadFormations);
+
+	UWorld* World = GetWorld();
+	UEnemyFlowFieldSubsystem* FlowField = World->GetSubsystem<UEnemyFlowFieldSubsystem>();
+
+	const double Now = World->GetTimeSeconds();
+	const float EngageRadiusSq = FMath::Square(EngageRadius);
+
+	TSet<AEnemy*> Holding;
+	int32 MoveOrders = 0;
+
+	for (FEnemySquad& Squad : Squads) {
+
+		// The one target evaluation for the whole squad
+		AEnemy* Leader = Squad.Leader;
+		AMain* Target = Leader && Leader->Alive() ? Leader->AggroTarget : nullptr;
+		if (Target && Target->MovementStatus == EMovementStatus::EMS_Dead) {
+
+			Target = nullptr;
+		}
+
+		Squad.Target = Target;
+		Squad.bHoldFormation = Target && FVector::DistSquared(Leader->GetActorLocation(), Target->GetActorLocation()) > EngageRadiusSq;
+		if (!Squad.bHoldFormation) continue;
+
+		const bool bMoveDue = Now >= Squad.NextMoveTime;
+		if (bMoveDue) {
+
+			Squad.NextMoveTime = Now + FormationUpdateInterval;
+		}
+
+		const FVector LeaderLocation = Leader->GetActorLocation();
+		const FRotator Facing(0.f, (Target->GetActorLocation() - LeaderLocation).Rotation().Yaw, 0.f);
+
+		for (int32 Slot = 0; Slot < Squad.Followers.Num(); ++Slot) {
+
+			// Followers that reached the target or got hit fight on their own
+			AEnemy* Follower = Squad.Followers[Slot];
+			if (!Follower->Alive() || Follower->bOverlappingCombatSphere || Follower->GetEnemyState() == EEnemyState::ES_Stagger) continue;
+
+			Holding.Add(Follower);
+
+			bool bJoined = false;
+			if (!Follower->bInFormation) {
+
+				Follower->bInFormation = true;
+				Formation.Add(Follower);
+				bJoined = true;
+
+				if (FlowField) {
+
+					FlowField->StopFollowing(Follower);
+				}
+				Follower->SetState(EEnemyState::ES_Chase);
+			}
+
+			if ((bMoveDue || bJoined) && Follower->AIController) {
+
+				// Straight at the slot, the leader has already found the way
+				FAIMoveRequest MoveRequest(LeaderLocation + Facing.RotateVector(GetFormationOffset(Slot)));
+				MoveRequest.SetUsePathfinding(false);
+				MoveRequest.SetAcceptanceRadius(FormationSpacing * 0.5f);
+
+				Follower->AIController->MoveTo(MoveRequest);
+				++MoveOrders;
+			}
+		}
+	}
+
+	for (int32 Index = Formation.Num() - 1; Index >= 0; --Index) {
+
+		AEnemy* Enemy = Formation[Index];
+		if (!Holding.Contains(Enemy)) {
+
+			Formation.RemoveAtSwap(Index);
+			ReleaseFromFormation(Enemy);
+		}
+	}
+
+	SET_DWORD_STAT(STAT_SquadFormationMoves, MoveOrders);
+}
+
+void UEnemySquadSubsystem::ReleaseFromFormation(AEnemy* Enemy)
+{
+	Enemy->bInFormation = false;
+
+	// Stopped here, the decision pass sends it after the target on its own path next frame
+	if (Enemy->Alive() && Enemy->GetEnemyState() == EEnemyState::ES_Chase) {
+
+		Enemy->StopChasing();
+	}
+}
+
+FVector UEnemySquadSubsystem::GetFormationOffset(int32 Slot) const
+{
+	// A wedge behind the leader, alternating sides
+	const int32 Row = Slot / 2 + 1;
+	const float Side = (Slot % 2 == 0) ? -1.f : 1.f;
+	return FVector(-Row * FormationSpacing, Side * Row * FormationSpacing, 0.f);
+}
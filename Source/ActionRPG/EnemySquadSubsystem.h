@@ -0,0 +1,102 @@
+// Copyright by Hakan Akkurt
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "Tickable.h"
+#include "EnemySquadSubsystem.generated.h"
+
+/**
+ * Groups nearby enemies into squads every RegroupInterval. The leader perceives, picks the target and
+ * paths to it as usual; its target goes on the squad blackboard, which followers use for aggro
+ * instead of running their own sight checks. While the leader is further than EngageRadius from the
+ * target, followers skip the decision pass and move straight to formation slots around the leader
+ * without a path query. Inside EngageRadius the squad breaks up and everyone fights on their own.
+ */
+UCLASS(Config = Game)
+class ACTIONRPG_API UEnemySquadSubsystem : public UWorldSubsystem, public FTickableGameObject
+{
+	GENERATED_BODY()
+
+public:
+
+	UEnemySquadSubsystem();
+
+	UPROPERTY(Config, EditAnywhere, BlueprintReadOnly, Category = "Squad")
+	bool bEnabled;
+
+	// Followers are picked from within this distance of their leader
+	UPROPERTY(Config, EditAnywhere, BlueprintReadOnly, Category = "Squad")
+	float SquadRadius;
+
+	// Leader included
+	UPROPERTY(Config, EditAnywhere, BlueprintReadOnly, Category = "Squad")
+	int32 MaxSquadSize;
+
+	UPROPERTY(Config, EditAnywhere, BlueprintReadOnly, Category = "Squad")
+	float RegroupInterval;
+
+	// Squads whose leader gets this close to the target break formation
+	UPROPERTY(Config, EditAnywhere, BlueprintReadOnly, Category = "Squad")
+	float EngageRadius;
+
+	// Distance between formation slots
+	UPROPERTY(Config, EditAnywhere, BlueprintReadOnly, Category = "Squad")
+	float FormationSpacing;
+
+	// How often followers are sent to their slot again as the leader moves
+	UPROPERTY(Config, EditAnywhere, BlueprintReadOnly, Category = "Squad")
+	float FormationUpdateInterval;
+
+	// Target on the blackboard of Enemy's squad, null when it has none or Enemy is in no squad
+	class AMain* GetSquadTarget(const class AEnemy* Enemy) const;
+
+	// Called by AEnemy when it leaves play or goes back to the pool
+	void ForgetEnemy(AEnemy* Enemy);
+
+	FORCEINLINE int32 GetNumSquads() const { return Squads.Num(); }
+
+	virtual bool ShouldCreateSubsystem(UObject* Outer) const override;
+
+	virtual void Deinitialize() override;
+
+	// FTickableGameObject
+	virtual void Tick(float DeltaTime) override;
+	virtual bool IsTickable() const override;
+	virtual ETickableTickType GetTickableTickType() const override;
+	virtual TStatId GetStatId() const override;
+	virtual UWorld* GetTickableGameObjectWorld() const override { return GetWorld(); }
+
+private:
+
+	struct FEnemySquad
+	{
+		AEnemy* Leader = nullptr;
+
+		// Index in here picks the formation slot
+		TArray<AEnemy*> Followers;
+
+		// Blackboard, written from the leader every frame
+		TWeakObjectPtr<AMain> Target;
+		bool bHoldFormation = false;
+
+		double NextMoveTime = 0.0;
+	};
+
+	void Regroup();
+
+	void UpdateFormations();
+
+	void ReleaseFromFormation(AEnemy* Enemy);
+
+	// Leader relative, X towards the target
+	FVector GetFormationOffset(int32 Slot) const;
+
+	TArray<FEnemySquad> Squads;
+
+	// Followers currently moving in formation
+	TArray<AEnemy*> Formation;
+
+	float RegroupCountdown;
+};
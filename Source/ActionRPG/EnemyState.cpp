@@ -0,0 +1,64 @@
+// Copyright by Hakan Akkurt
+
+
+#include "EnemyState.h"
+#include "Enemy.h"
+#include "AIController.h"
+#include "EnemyFlowFieldSubsystem.h"
+
+namespace
+{
+	void StopMoving(AEnemy& Enemy)
+	{
+		UEnemyFlowFieldSubsystem* FlowField = Enemy.GetWorld()->GetSubsystem<UEnemyFlowFieldSubsystem>();
+		if (FlowField) {
+
+			FlowField->StopFollowing(&Enemy);
+		}
+
+		if (Enemy.AIController) {
+
+			Enemy.AIController->StopMovement();
+		}
+	}
+
+	void ExitEngaged(AEnemy& Enemy)
+	{
+		if (Enemy.AIController) {
+
+			Enemy.AIController->ClearFocus(EAIFocusPriority::Gameplay);
+		}
+	}
+
+	// Indexed by EEnemyState
+	const FEnemyStateInfo StateTable[] =
+	{
+		//	Parent						MovementStatus							Interval	Windows	Senses	Body	OnEnter		OnExit
+		{	EEnemyState::ES_MAX,		EEnemyMovementStatus::EMS_Idle,			0.5f,		false,	true,	true,	nullptr,	nullptr		},	// Passive
+		{	EEnemyState::ES_MAX,		EEnemyMovementStatus::EMS_MoveToTarget,	0.f,		true,	true,	true,	nullptr,	ExitEngaged	},	// Engaged
+		{	EEnemyState::ES_Passive,	EEnemyMovementStatus::EMS_Idle,			0.5f,		false,	true,	true,	StopMoving,	nullptr		},	// Idle
+		{	EEnemyState::ES_Passive,	EEnemyMovementStatus::EMS_Idle,			0.5f,		false,	true,	true,	nullptr,	nullptr		},	// Patrol
+		{	EEnemyState::ES_Engaged,	EEnemyMovementStatus::EMS_MoveToTarget,	0.f,		true,	true,	true,	nullptr,	nullptr		},	// Chase
+		{	EEnemyState::ES_Engaged,	EEnemyMovementStatus::EMS_Attacking,	0.f,		true,	true,	true,	nullptr,	nullptr		},	// Attack
+		{	EEnemyState::ES_Engaged,	EEnemyMovementStatus::EMS_Idle,			0.f,		false,	true,	true,	StopMoving,	nullptr		},	// Stagger
+		{	EEnemyState::ES_MAX,		EEnemyMovementStatus::EMS_Dead,			0.5f,		false,	false,	false,	StopMoving,	nullptr		},	// Dead
+	};
+
+	static_assert(UE_ARRAY_COUNT(StateTable) == (int32)EEnemyState::ES_MAX, "Every EEnemyState needs a row in StateTable");
+}
+
+const FEnemyStateInfo& GetEnemyStateInfo(EEnemyState State)
+{
+	check(State < EEnemyState::ES_MAX);
+	return StateTable[(int32)State];
+}
+
+bool IsEnemyStateIn(EEnemyState State, EEnemyState Ancestor)
+{
+	while (State != EEnemyState::ES_MAX) {
+
+		if (State == Ancestor) return true;
+		State = GetEnemyStateInfo(State).Parent;
+	}
+	return false;
+}
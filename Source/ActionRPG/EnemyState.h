@@ -0,0 +1,68 @@
+// Copyright by Hakan Akkurt
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "EnemyState.generated.h"
+
+UENUM(BlueprintType)
+enum class EEnemyMovementStatus : uint8
+{
+	EMS_Idle			UMETA(DisplayName = "Idle"),
+	EMS_MoveToTarget	UMETA(DisplayName = "MoveToTarget"),
+	EMS_Attacking		UMETA(DisplayName = "Attacking"),
+	EMS_Dead			UMETA(DisplayName = "Dead"),
+
+	EMS_MAX				UMETA(DisplayName = "DefaultMAX")
+};
+
+UENUM(BlueprintType)
+enum class EEnemyState : uint8
+{
+	// Composite states, never entered on their own
+	ES_Passive		UMETA(Hidden),
+	ES_Engaged		UMETA(Hidden),
+
+	ES_Idle			UMETA(DisplayName = "Idle"),
+	ES_Patrol		UMETA(DisplayName = "Patrol"),
+	ES_Chase		UMETA(DisplayName = "Chase"),
+	ES_Attack		UMETA(DisplayName = "Attack"),
+	ES_Stagger		UMETA(DisplayName = "Stagger"),
+	ES_Dead			UMETA(DisplayName = "Dead"),
+
+	ES_MAX			UMETA(Hidden)
+};
+
+/**
+ * One row of the enemy state table. Idle and Patrol sit under Passive, Chase, Attack and Stagger
+ * under Engaged; switching states exits up to the common parent and enters down to the new state.
+ */
+struct FEnemyStateInfo
+{
+	// ES_MAX for top level states
+	EEnemyState Parent;
+
+	// What EnemyMovementStatus reads while in this state, for blueprints and the anim graph
+	EEnemyMovementStatus MovementStatus;
+
+	// Actor and AI controller tick interval, 0 ticks every frame
+	float TickInterval;
+
+	// ActivateCollision may open the weapon's collision window
+	bool bCollisionWindows;
+
+	// AgroSphere and CombatSphere keep their authored collision, ignored with spatial aggro
+	bool bSenses;
+
+	// The capsule keeps its authored collision
+	bool bBodyCollision;
+
+	void (*OnEnter)(class AEnemy& Enemy);
+	void (*OnExit)(AEnemy& Enemy);
+};
+
+// Row for State, composite states included
+ACTIONRPG_API const FEnemyStateInfo& GetEnemyStateInfo(EEnemyState State);
+
+// True when State is Ancestor or nested anywhere below it
+ACTIONRPG_API bool IsEnemyStateIn(EEnemyState State, EEnemyState Ancestor);
@@ -6,7 +6,11 @@
 #include "Kismet/GameplayStatics.h"
 #include "Engine/World.h"
 #include "Sound/SoundCue.h"
+#include "ActorPoolSubsystem.h"
 #include "Enemy.h"
+#include "EnemyHearingSubsystem.h"
+#include "FXPoolSubsystem.h"
+#include "GameplayAudioSubsystem.h"
 #include "Kismet/GameplayStatics.h"
 
 AExplosive::AExplosive()
@@ -25,15 +29,18 @@ void AExplosive::OnOverlapBegin(UPrimitiveComponent* OverlappedComponent, AActor
 		if (Main || Enemy) {
 
 			if (OverlapParticles) {
-				UGameplayStatics::SpawnEmitterAtLocation(GetWorld(), OverlapParticles, GetActorLocation(), FRotator(0.f), true);
+				UFXPoolSubsystem::SpawnEmitterAtLocation(this, OverlapParticles, GetActorLocation());
 			}
 
 			if (OverlapSound) {
-				UGameplayStatics::PlaySound2D(this, OverlapSound);
+				UGameplayAudioSubsystem::PlaySoundAtLocation(this, OverlapSound, GetActorLocation());
 			}
 
+			// Loud enough to carry twice as far as a hit
+			UEnemyHearingSubsystem::ReportNoise(this, GetActorLocation(), 2.f, this);
+
 			UGameplayStatics::ApplyDamage(OtherActor, Damage, nullptr, this, DamagetTypeClass);
-			Destroy();
+			UActorPoolSubsystem::ReleaseOrDestroy(this);
 		}
 	}
 }
@@ -0,0 +1,218 @@
+// Copyright by Hakan Akkurt
+
+
+#include "FXPoolSubsystem.h"
+#include "ActionRPG.h"
+#include "Particles/ParticleSystem.h"
+#include "Particles/ParticleSystemComponent.h"
+#include "Camera/PlayerCameraManager.h"
+#include "GameFramework/PlayerController.h"
+#include "Kismet/GameplayStatics.h"
+#include "Engine/World.h"
+#include "Engine/Engine.h"
+
+DECLARE_DWORD_COUNTER_STAT(TEXT("FX Spawns"), STAT_FXSpawns, STATGROUP_ActionRPG);
+DECLARE_DWORD_COUNTER_STAT(TEXT("FX Culled"), STAT_FXCulled, STATGROUP_ActionRPG);
+DECLARE_DWORD_COUNTER_STAT(TEXT("FX Coalesced"), STAT_FXCoalesced, STATGROUP_ActionRPG);
+DECLARE_DWORD_COUNTER_STAT(TEXT("FX Stolen"), STAT_FXStolen, STATGROUP_ActionRPG);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("FX Components"), STAT_FXComponents, STATGROUP_ActionRPG);
+
+UFXPoolSubsystem::UFXPoolSubsystem()
+{
+	MaxActivePerEffect = 12;
+	MaxFreePerEffect = 16;
+	CullDistance = 8000.f;
+	OffscreenCullDistance = 1500.f;
+	ViewConeHalfAngle = 60.f;
+	CoalesceRadius = 50.f;
+
+	RecentSpawnsFrame = 0;
+}
+
+UFXPoolSubsystem* UFXPoolSubsystem::Get(const UObject* WorldContextObject)
+{
+	UWorld* World = GEngine->GetWorldFromContextObject(WorldContextObject, EGetWorldErrorMode::ReturnNull);
+	return World ? World->GetSubsystem<UFXPoolSubsystem>() : nullptr;
+}
+
+UParticleSystemComponent* UFXPoolSubsystem::SpawnEmitterAtLocation(const UObject* WorldContextObject, UParticleSystem* Template, const FVector& Location, const FRotator& Rotation)
+{
+	UFXPoolSubsystem* FXPool = Get(WorldContextObject);
+	if (FXPool) {
+
+		return FXPool->SpawnEmitter(Template, Location, Rotation);
+	}
+	return UGameplayStatics::SpawnEmitterAtLocation(WorldContextObject, Template, Location, Rotation);
+}
+
+bool UFXPoolSubsystem::ShouldCreateSubsystem(UObject* Outer) const
+{
+	UWorld* World = Cast<UWorld>(Outer);
+	return World && World->IsGameWorld();
+}
+
+void UFXPoolSubsystem::Deinitialize()
+{
+	for (TPair<UParticleSystem*, FFXPool>& Pair : Pools) {
+
+		for (UParticleSystemComponent* Component : Pair.Value.FreeComponents) {
+
+			if (Component) { Component->DestroyComponent(); }
+		}
+		for (UParticleSystemComponent* Component : Pair.Value.ActiveComponents) {
+
+			if (Component) { Component->DestroyComponent(); }
+		}
+	}
+	Pools.Empty();
+	RecentSpawns.Empty();
+	SET_DWORD_STAT(STAT_FXComponents, 0);
+
+	Super::Deinitialize();
+}
+
+UParticleSystemComponent* UFXPoolSubsystem::SpawnEmitter(UParticleSystem* Template, const FVector& Location, const FRotator& Rotation)
+{
+	if (!Template) return nullptr;
+
+	if (ShouldCull(Location)) {
+
+		INC_DWORD_STAT(STAT_FXCulled);
+		return nullptr;
+	}
+
+	UParticleSystemComponent* Recent = FindRecentSpawn(Template, Location);
+	if (Recent) {
+
+		INC_DWORD_STAT(STAT_FXCoalesced);
+		return Recent;
+	}
+
+	FFXPool& Pool = Pools.FindOrAdd(Template);
+	UParticleSystemComponent* Component = nullptr;
+
+	if (Pool.ActiveComponents.Num() >= GetCap(Template)) {
+
+		// Out of the list first, so its finish event doesn't hand it back to the free list
+		Component = Pool.ActiveComponents[0];
+		Pool.ActiveComponents.RemoveAt(0, 1, false);
+		if (Component) { Component->DeactivateImmediate(); }
+		INC_DWORD_STAT(STAT_FXStolen);
+
+		// Coalescing onto it would hand back an effect that has just moved elsewhere
+		RecentSpawns.RemoveAllSwap([Component](const FRecentSpawn& Spawn) { return Spawn.Component == Component; }, false);
+	}
+
+	while (!Component && Pool.FreeComponents.Num() > 0) {
+
+		Component = Pool.FreeComponents.Pop(false);
+	}
+
+	if (!Component) {
+
+		Component = CreateComponent(Template);
+		if (!Component) return nullptr;
+	}
+
+	Component->SetWorldLocationAndRotation(Location, Rotation);
+	Component->ActivateSystem(true);
+	Pool.ActiveComponents.Add(Component);
+
+	FRecentSpawn& Spawn = RecentSpawns.AddDefaulted_GetRef();
+	Spawn.Template = Template;
+	Spawn.Location = Location;
+	Spawn.Component = Component;
+
+	INC_DWORD_STAT(STAT_FXSpawns);
+	return Component;
+}
+
+bool UFXPoolSubsystem::ShouldCull(const FVector& Location) const
+{
+	UWorld* World = GetWorld();
+	const float CullSq = FMath::Square(CullDistance);
+	const float OffscreenSq = FMath::Square(OffscreenCullDistance);
+	const float ViewConeCos = FMath::Cos(FMath::DegreesToRadians(ViewConeHalfAngle));
+	bool bHasView = false;
+
+	for (FConstPlayerControllerIterator It = World->GetPlayerControllerIterator(); It; ++It) {
+
+		APlayerController* Controller = It->Get();
+		if (!Controller || !Controller->PlayerCameraManager) continue;
+
+		bHasView = true;
+		const FVector ViewLocation = Controller->PlayerCameraManager->GetCameraLocation();
+		const FVector ToEffect = Location - ViewLocation;
+		const float DistSq = ToEffect.SizeSquared();
+
+		if (DistSq > CullSq) continue;
+		if (DistSq <= OffscreenSq) return false;
+
+		const FVector ViewDirection = Controller->PlayerCameraManager->GetCameraRotation().Vector();
+		if (FVector::DotProduct(ToEffect.GetSafeNormal(), ViewDirection) >= ViewConeCos) return false;
+	}
+
+	// Culled only when there was a camera and none of them would see it
+	return bHasView;
+}
+
+UParticleSystemComponent* UFXPoolSubsystem::FindRecentSpawn(const UParticleSystem* Template, const FVector& Location)
+{
+	if (RecentSpawnsFrame != GFrameCounter) {
+
+		RecentSpawnsFrame = GFrameCounter;
+		RecentSpawns.Reset();
+		return nullptr;
+	}
+
+	const float CoalesceSq = FMath::Square(CoalesceRadius);
+	for (const FRecentSpawn& Spawn : RecentSpawns) {
+
+		if (Spawn.Template == Template && Spawn.Component.IsValid() && FVector::DistSquared(Spawn.Location, Location) <= CoalesceSq) {
+
+			return Spawn.Component.Get();
+		}
+	}
+	return nullptr;
+}
+
+int32 UFXPoolSubsystem::GetCap(UParticleSystem* Template) const
+{
+	const int32* Cap = EffectCaps.Find(TSoftObjectPtr<UParticleSystem>(Template));
+	return FMath::Max(1, Cap ? *Cap : MaxActivePerEffect);
+}
+
+UParticleSystemComponent* UFXPoolSubsystem::CreateComponent(UParticleSystem* Template)
+{
+	UWorld* World = GetWorld();
+
+	// Owned by the world like the ones UGameplayStatics spawns, but never auto destroyed
+	UParticleSystemComponent* Component = NewObject<UParticleSystemComponent>(World);
+	Component->bAutoDestroy = false;
+	Component->bAutoActivate = false;
+	Component->SetUsingAbsoluteLocation(true);
+	Component->SetUsingAbsoluteRotation(true);
+	Component->SetUsingAbsoluteScale(true);
+	Component->SetTemplate(Template);
+	Component->OnSystemFinished.AddDynamic(this, &UFXPoolSubsystem::OnEmitterFinished);
+	Component->RegisterComponentWithWorld(World);
+
+	INC_DWORD_STAT(STAT_FXComponents);
+	return Component;
+}
+
+void UFXPoolSubsystem::OnEmitterFinished(UParticleSystemComponent* Component)
+{
+	FFXPool* Pool = Component ? Pools.Find(Component->Template) : nullptr;
+
+	// Stolen for a newer spawn, it is already playing again
+	if (!Pool || Pool->ActiveComponents.Remove(Component) == 0) return;
+
+	if (Pool->FreeComponents.Num() >= MaxFreePerEffect) {
+
+		Component->DestroyComponent();
+		DEC_DWORD_STAT(STAT_FXComponents);
+		return;
+	}
+	Pool->FreeComponents.Add(Component);
+}
@@ -0,0 +1,106 @@
+// Copyright by Hakan Akkurt
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "FXPoolSubsystem.generated.h"
+
+class UParticleSystem;
+class UParticleSystemComponent;
+
+USTRUCT()
+struct FFXPool
+{
+	GENERATED_BODY()
+
+	UPROPERTY()
+	TArray<UParticleSystemComponent*> FreeComponents;
+
+	// Playing, oldest first
+	UPROPERTY()
+	TArray<UParticleSystemComponent*> ActiveComponents;
+};
+
+/**
+ * One-shot particle effects without a new component per spawn. Components are kept per template and
+ * handed out again once their effect has finished. An effect already playing its template's cap steals
+ * the oldest instance; effects too far away, or far enough and behind the camera, are never spawned;
+ * and the same effect spawned again close by in the same frame plays once.
+ */
+UCLASS(Config = Game)
+class ACTIONRPG_API UFXPoolSubsystem : public UWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+
+	UFXPoolSubsystem();
+
+	static UFXPoolSubsystem* Get(const UObject* WorldContextObject);
+
+	// Drop-in for UGameplayStatics::SpawnEmitterAtLocation, which it falls back to outside a game world
+	static UParticleSystemComponent* SpawnEmitterAtLocation(const UObject* WorldContextObject, UParticleSystem* Template, const FVector& Location, const FRotator& Rotation = FRotator::ZeroRotator);
+
+	// Instances of one template playing at once, unless EffectCaps says otherwise
+	UPROPERTY(Config, EditAnywhere, BlueprintReadOnly, Category = "FX")
+	int32 MaxActivePerEffect;
+
+	UPROPERTY(Config, EditAnywhere, BlueprintReadOnly, Category = "FX")
+	TMap<TSoftObjectPtr<UParticleSystem>, int32> EffectCaps;
+
+	// Finished components beyond this many per template are destroyed instead of kept
+	UPROPERTY(Config, EditAnywhere, BlueprintReadOnly, Category = "FX")
+	int32 MaxFreePerEffect;
+
+	// Nothing is spawned further than this from the camera
+	UPROPERTY(Config, EditAnywhere, BlueprintReadOnly, Category = "FX")
+	float CullDistance;
+
+	// Past this distance effects outside the view cone are skipped too
+	UPROPERTY(Config, EditAnywhere, BlueprintReadOnly, Category = "FX")
+	float OffscreenCullDistance;
+
+	UPROPERTY(Config, EditAnywhere, BlueprintReadOnly, Category = "FX")
+	float ViewConeHalfAngle;
+
+	// The same template spawned within this distance of one already spawned this frame is merged into it
+	UPROPERTY(Config, EditAnywhere, BlueprintReadOnly, Category = "FX")
+	float CoalesceRadius;
+
+	// Plays Template at Location, nullptr when it was culled
+	UFUNCTION(BlueprintCallable, Category = "FX")
+	UParticleSystemComponent* SpawnEmitter(UParticleSystem* Template, const FVector& Location, const FRotator& Rotation);
+
+	virtual bool ShouldCreateSubsystem(UObject* Outer) const override;
+
+	virtual void Deinitialize() override;
+
+private:
+
+	struct FRecentSpawn
+	{
+		const UParticleSystem* Template;
+		FVector Location;
+		TWeakObjectPtr<UParticleSystemComponent> Component;
+	};
+
+	// True when no camera would see an effect at Location
+	bool ShouldCull(const FVector& Location) const;
+
+	UParticleSystemComponent* FindRecentSpawn(const UParticleSystem* Template, const FVector& Location);
+
+	int32 GetCap(UParticleSystem* Template) const;
+
+	UParticleSystemComponent* CreateComponent(UParticleSystem* Template);
+
+	UFUNCTION()
+	void OnEmitterFinished(UParticleSystemComponent* Component);
+
+	UPROPERTY()
+	TMap<UParticleSystem*, FFXPool> Pools;
+
+	// This frame's spawns, for coalescing
+	TArray<FRecentSpawn> RecentSpawns;
+	uint64 RecentSpawnsFrame;
+};
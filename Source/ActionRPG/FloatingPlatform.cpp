@@ -3,7 +3,7 @@
 
 #include "FloatingPlatform.h"
 #include "Components/StaticMeshComponent.h"
-#include "TimerManager.h"
+#include "CombatSchedulerSubsystem.h"
 
 // Sets default values
 AFloatingPlatform::AFloatingPlatform()
@@ -33,7 +33,11 @@ void AFloatingPlatform::BeginPlay()
 
 	bInterping = false;
 	
-	GetWorldTimerManager().SetTimer(InterpTimer, this, &AFloatingPlatform::ToggleInterping, InterpTime);
+	UCombatSchedulerSubsystem* Scheduler = UCombatSchedulerSubsystem::Get(this);
+	if (Scheduler) {
+
+		Scheduler->SetTimer(InterpTimer, this, &AFloatingPlatform::ToggleInterping, InterpTime);
+	}
 
 	Distance = (EndPoint - StartPoint).Size();
 }
@@ -53,7 +57,11 @@ void AFloatingPlatform::Tick(float DeltaTime)
 
 			ToggleInterping();
 
-			GetWorldTimerManager().SetTimer(InterpTimer, this, &AFloatingPlatform::ToggleInterping, InterpTime);
+			UCombatSchedulerSubsystem* Scheduler = UCombatSchedulerSubsystem::Get(this);
+			if (Scheduler) {
+
+				Scheduler->SetTimer(InterpTimer, this, &AFloatingPlatform::ToggleInterping, InterpTime);
+			}
 			SwapVectors(StartPoint, EndPoint);
 		}
 	}
@@ -4,6 +4,7 @@
 
 #include "CoreMinimal.h"
 #include "GameFramework/Actor.h"
+#include "CombatSchedulerSubsystem.h"
 #include "FloatingPlatform.generated.h"
 
 UCLASS()
@@ -31,7 +32,7 @@ public:
 	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Platform")
 	float InterpTime;
 
-	FTimerHandle InterpTimer;
+	FCombatTimerHandle InterpTimer;
 
 	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Platform")
 	bool bInterping;
@@ -4,7 +4,7 @@
 #include "FloorSwitch.h"
 #include "Components/BoxComponent.h"
 #include "Components/StaticMeshComponent.h"
-#include "TimerManager.h"
+#include "CombatSchedulerSubsystem.h"
 
 // Sets default values
 AFloorSwitch::AFloorSwitch()
@@ -54,7 +54,11 @@ void AFloorSwitch::Tick(float DeltaTime)
 void AFloorSwitch::OnOverlapBegin(UPrimitiveComponent* OverlappedComponent, AActor* OtherActor, UPrimitiveComponent* OtherComp, int32 OtherBodyIndex, bool bFromSweep, const FHitResult& SweepResult)
 {
 	if (!bCharacterOnSwitch) { bCharacterOnSwitch = true; }
-	GetWorldTimerManager().ClearTimer(SwitchHandle);
+	UCombatSchedulerSubsystem* Scheduler = UCombatSchedulerSubsystem::Get(this);
+	if (Scheduler) {
+
+		Scheduler->ClearTimer(SwitchHandle);
+	}
 	RaiseDoor();
 	LowerFloorSwitch();
 }
@@ -62,7 +66,11 @@ void AFloorSwitch::OnOverlapBegin(UPrimitiveComponent* OverlappedComponent, AAct
 void AFloorSwitch::OnOverlapEnd(UPrimitiveComponent* OverlappedComponent, AActor* OtherActor, UPrimitiveComponent* OtherComp, int32 OtherBodyIndex)
 {
 	if (bCharacterOnSwitch) { bCharacterOnSwitch = false; }
-	GetWorldTimerManager().SetTimer(SwitchHandle, this, &AFloorSwitch::CloseDoor, SwitchTime);
+	UCombatSchedulerSubsystem* Scheduler = UCombatSchedulerSubsystem::Get(this);
+	if (Scheduler) {
+
+		Scheduler->SetTimer(SwitchHandle, this, &AFloorSwitch::CloseDoor, SwitchTime);
+	}
 }
 
 void AFloorSwitch::UpdateDoorLocation(float Z)
@@ -4,6 +4,7 @@
 
 #include "CoreMinimal.h"
 #include "GameFramework/Actor.h"
+#include "CombatSchedulerSubsystem.h"
 #include "FloorSwitch.generated.h"
 
 UCLASS()
@@ -33,7 +34,7 @@ public:
 	UPROPERTY(BlueprintReadWrite, Category = "Floor Switch")
 	FVector InitialSwitchLocation;
 
-	FTimerHandle SwitchHandle;
+	FCombatTimerHandle SwitchHandle;
 
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Floor Switch")
 	float SwitchTime;
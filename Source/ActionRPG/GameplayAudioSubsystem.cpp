@@ -0,0 +1,196 @@
+// Copyright by Hakan Akkurt
+
+
+#include "GameplayAudioSubsystem.h"
+#include "ActionRPG.h"
+#include "Sound/SoundBase.h"
+#include "Sound/SoundAttenuation.h"
+#include "GameFramework/PlayerController.h"
+#include "Kismet/GameplayStatics.h"
+#include "Engine/World.h"
+#include "Engine/Engine.h"
+
+DECLARE_DWORD_COUNTER_STAT(TEXT("Audio Requests"), STAT_AudioRequests, STATGROUP_ActionRPG);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Audio Played"), STAT_AudioPlayed, STATGROUP_ActionRPG);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Audio Deduped"), STAT_AudioDeduped, STATGROUP_ActionRPG);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Audio Over Budget"), STAT_AudioOverBudget, STATGROUP_ActionRPG);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Audio Culled"), STAT_AudioCulled, STATGROUP_ActionRPG);
+
+UGameplayAudioSubsystem::UGameplayAudioSubsystem()
+{
+	DedupeWindow = 0.05f;
+	MaxVoicesPerCue = 4;
+	CullDistance = 5000.f;
+	FullVolumeRadius = 400.f;
+	LoopingVoiceDuration = 2.f;
+
+	FallbackAttenuation = nullptr;
+	NextPruneTime = 0.0;
+}
+
+UGameplayAudioSubsystem* UGameplayAudioSubsystem::Get(const UObject* WorldContextObject)
+{
+	UWorld* World = GEngine->GetWorldFromContextObject(WorldContextObject, EGetWorldErrorMode::ReturnNull);
+	return World ? World->GetSubsystem<UGameplayAudioSubsystem>() : nullptr;
+}
+
+void UGameplayAudioSubsystem::PlaySoundAtLocation(const UObject* WorldContextObject, USoundBase* Sound, const FVector& Location)
+{
+	UGameplayAudioSubsystem* Audio = Get(WorldContextObject);
+	if (Audio) {
+
+		Audio->PlayAtLocation(Sound, Location);
+		return;
+	}
+	UGameplayStatics::PlaySoundAtLocation(WorldContextObject, Sound, Location);
+}
+
+void UGameplayAudioSubsystem::PlaySound2D(const UObject* WorldContextObject, USoundBase* Sound)
+{
+	UGameplayAudioSubsystem* Audio = Get(WorldContextObject);
+	if (Audio) {
+
+		Audio->Play2D(Sound);
+		return;
+	}
+	UGameplayStatics::PlaySound2D(WorldContextObject, Sound);
+}
+
+bool UGameplayAudioSubsystem::ShouldCreateSubsystem(UObject* Outer) const
+{
+	UWorld* World = Cast<UWorld>(Outer);
+	return World && World->IsGameWorld();
+}
+
+void UGameplayAudioSubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+
+	// Most gameplay cues were authored for PlaySound2D and carry no attenuation
+	FallbackAttenuation = NewObject<USoundAttenuation>(this);
+	FSoundAttenuationSettings& Settings = FallbackAttenuation->Attenuation;
+	Settings.bAttenuate = true;
+	Settings.bSpatialize = true;
+	Settings.AttenuationShape = EAttenuationShape::Sphere;
+	Settings.AttenuationShapeExtents = FVector(FullVolumeRadius, 0.f, 0.f);
+	Settings.FalloffDistance = FMath::Max(CullDistance - FullVolumeRadius, 1.f);
+}
+
+void UGameplayAudioSubsystem::Deinitialize()
+{
+	Cues.Empty();
+	FallbackAttenuation = nullptr;
+
+	Super::Deinitialize();
+}
+
+bool UGameplayAudioSubsystem::PlayAtLocation(USoundBase* Sound, const FVector& Location)
+{
+	if (!Sound) return false;
+
+	INC_DWORD_STAT(STAT_AudioRequests);
+
+	// Culled before the budget, so a far away fight doesn't use up the voices of one nearby
+	if (!IsAudible(Sound, Location)) {
+
+		INC_DWORD_STAT(STAT_AudioCulled);
+		return false;
+	}
+
+	if (!AdmitVoice(Sound)) return false;
+
+	USoundAttenuation* Attenuation = Sound->GetAttenuationSettingsToApply() ? nullptr : FallbackAttenuation;
+	UGameplayStatics::PlaySoundAtLocation(this, Sound, Location, FRotator::ZeroRotator, 1.f, 1.f, 0.f, Attenuation);
+
+	INC_DWORD_STAT(STAT_AudioPlayed);
+	return true;
+}
+
+bool UGameplayAudioSubsystem::Play2D(USoundBase* Sound)
+{
+	if (!Sound) return false;
+
+	INC_DWORD_STAT(STAT_AudioRequests);
+
+	if (!AdmitVoice(Sound)) return false;
+
+	UGameplayStatics::PlaySound2D(this, Sound);
+
+	INC_DWORD_STAT(STAT_AudioPlayed);
+	return true;
+}
+
+bool UGameplayAudioSubsystem::AdmitVoice(USoundBase* Sound)
+{
+	const double Now = GetWorld()->GetTimeSeconds();
+	if (Now >= NextPruneTime) {
+
+		NextPruneTime = Now + 1.0;
+		PruneCues(Now);
+	}
+
+	FCueVoices& Cue = Cues.FindOrAdd(Sound);
+
+	if (Now - Cue.LastStartTime <= DedupeWindow) {
+
+		INC_DWORD_STAT(STAT_AudioDeduped);
+		return false;
+	}
+
+	Cue.EndTimes.RemoveAllSwap([Now](double EndTime) { return EndTime <= Now; });
+	if (Cue.EndTimes.Num() >= GetVoiceBudget(Sound)) {
+
+		INC_DWORD_STAT(STAT_AudioOverBudget);
+		return false;
+	}
+
+	// Looping cues would report INDEFINITELY_LOOPING_DURATION and hold their voice for the session
+	const float Duration = Sound->IsLooping() ? LoopingVoiceDuration : Sound->GetDuration();
+	Cue.LastStartTime = Now;
+	Cue.EndTimes.Add(Now + FMath::Max(Duration, 0.1f));
+	return true;
+}
+
+void UGameplayAudioSubsystem::PruneCues(double Now)
+{
+	for (TMap<TObjectKey<USoundBase>, FCueVoices>::TIterator It = Cues.CreateIterator(); It; ++It) {
+
+		FCueVoices& Cue = It.Value();
+		Cue.EndTimes.RemoveAllSwap([Now](double EndTime) { return EndTime <= Now; });
+		if (Cue.EndTimes.Num() == 0 && Now - Cue.LastStartTime > DedupeWindow) {
+
+			It.RemoveCurrent();
+		}
+	}
+}
+
+bool UGameplayAudioSubsystem::IsAudible(USoundBase* Sound, const FVector& Location) const
+{
+	// Cues with their own attenuation are inaudible past it already
+	const float MaxDistance = Sound->GetAttenuationSettingsToApply() ? FMath::Min(CullDistance, Sound->GetMaxDistance()) : CullDistance;
+	const float MaxDistanceSq = FMath::Square(MaxDistance);
+	bool bHasListener = false;
+
+	for (FConstPlayerControllerIterator It = GetWorld()->GetPlayerControllerIterator(); It; ++It) {
+
+		APlayerController* Controller = It->Get();
+		if (!Controller || !Controller->IsLocalController()) continue;
+
+		FVector ListenerLocation;
+		FVector FrontDir;
+		FVector RightDir;
+		Controller->GetAudioListenerPosition(ListenerLocation, FrontDir, RightDir);
+
+		bHasListener = true;
+		if (FVector::DistSquared(ListenerLocation, Location) <= MaxDistanceSq) return true;
+	}
+
+	// Nothing to measure from, leave it to the audio engine
+	return !bHasListener;
+}
+
+int32 UGameplayAudioSubsystem::GetVoiceBudget(USoundBase* Sound) const
+{
+	const int32* Budget = VoiceBudgets.Find(TSoftObjectPtr<USoundBase>(Sound));
+	return FMath::Max(1, Budget ? *Budget : MaxVoicesPerCue);
+}
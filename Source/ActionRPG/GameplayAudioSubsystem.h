@@ -0,0 +1,97 @@
+// Copyright by Hakan Akkurt
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "UObject/ObjectKey.h"
+#include "GameplayAudioSubsystem.generated.h"
+
+class USoundBase;
+class USoundAttenuation;
+
+/**
+ * One place for gameplay one-shots. A cue asked for again within DedupeWindow of its last start plays
+ * once, and each cue has a budget of voices it may have playing at a time, estimated from its duration.
+ * Sounds with a location are played in the world: past CullDistance from every listener they are
+ * dropped, and cues authored without attenuation are spatialized with a fallback falloff.
+ */
+UCLASS(Config = Game)
+class ACTIONRPG_API UGameplayAudioSubsystem : public UWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+
+	UGameplayAudioSubsystem();
+
+	static UGameplayAudioSubsystem* Get(const UObject* WorldContextObject);
+
+	// Drop-ins for UGameplayStatics::PlaySoundAtLocation and PlaySound2D, which they fall back to outside a game world
+	static void PlaySoundAtLocation(const UObject* WorldContextObject, USoundBase* Sound, const FVector& Location);
+
+	static void PlaySound2D(const UObject* WorldContextObject, USoundBase* Sound);
+
+	// Seconds after a cue starts during which asking for it again does nothing, 0 only merges requests in the same frame
+	UPROPERTY(Config, EditAnywhere, BlueprintReadOnly, Category = "Audio")
+	float DedupeWindow;
+
+	// Voices one cue may have playing at once, unless VoiceBudgets says otherwise
+	UPROPERTY(Config, EditAnywhere, BlueprintReadOnly, Category = "Audio")
+	int32 MaxVoicesPerCue;
+
+	UPROPERTY(Config, EditAnywhere, BlueprintReadOnly, Category = "Audio")
+	TMap<TSoftObjectPtr<USoundBase>, int32> VoiceBudgets;
+
+	// Looping cues never report an end, each one started counts against the budget this long
+	UPROPERTY(Config, EditAnywhere, BlueprintReadOnly, Category = "Audio")
+	float LoopingVoiceDuration;
+
+	// Located sounds further than this from every listener are not played
+	UPROPERTY(Config, EditAnywhere, BlueprintReadOnly, Category = "Audio")
+	float CullDistance;
+
+	// Cues without attenuation of their own play at full volume this close and fade out to CullDistance
+	UPROPERTY(Config, EditAnywhere, BlueprintReadOnly, Category = "Audio")
+	float FullVolumeRadius;
+
+	// Plays Sound at Location, false when it was deduped, over budget or culled
+	UFUNCTION(BlueprintCallable, Category = "Audio")
+	bool PlayAtLocation(USoundBase* Sound, const FVector& Location);
+
+	// Plays Sound unattenuated, for the player's own sounds
+	UFUNCTION(BlueprintCallable, Category = "Audio")
+	bool Play2D(USoundBase* Sound);
+
+	virtual bool ShouldCreateSubsystem(UObject* Outer) const override;
+
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+
+	virtual void Deinitialize() override;
+
+private:
+
+	struct FCueVoices
+	{
+		double LastStartTime = -MAX_dbl;
+
+		// When each voice started from here is expected to end
+		TArray<double> EndTimes;
+	};
+
+	// Dedupe and voice budget, counts Sound as started when it passes
+	bool AdmitVoice(USoundBase* Sound);
+
+	bool IsAudible(USoundBase* Sound, const FVector& Location) const;
+
+	int32 GetVoiceBudget(USoundBase* Sound) const;
+
+	// Drops cues with nothing playing and past their dedupe window, so the map only holds recent ones
+	void PruneCues(double Now);
+
+	TMap<TObjectKey<USoundBase>, FCueVoices> Cues;
+	double NextPruneTime;
+
+	UPROPERTY()
+	USoundAttenuation* FallbackAttenuation;
+};
@@ -57,3 +57,47 @@ void AItem::OnOverlapEnd(UPrimitiveComponent* OverlappedComponent, AActor* Other
 
 }
 
+void AItem::OnAcquiredFromPool()
+{
+	SetPickupActive(true);
+
+	if (IdleParticlesComponent->bAutoActivate) {
+
+		IdleParticlesComponent->Activate(true);
+	}
+}
+
+void AItem::OnReturnedToPool()
+{
+	IdleParticlesComponent->Deactivate();
+}
+
+void AItem::SetPickupActive(bool bActive)
+{
+	if (bActive) {
+
+		// Whatever the item's class was authored with
+		const AItem* Defaults = GetClass()->GetDefaultObject<AItem>();
+		CollisionVolume->SetCollisionEnabled(Defaults->CollisionVolume->GetCollisionEnabled());
+		CollisionVolume->SetGenerateOverlapEvents(Defaults->CollisionVolume->GetGenerateOverlapEvents());
+
+		ParkedMesh.SetParked(Mesh, false);
+		ParkedParticles.SetParked(IdleParticlesComponent, false);
+		return;
+	}
+
+	// The root carries the rest of the item, it can only stop overlapping
+	CollisionVolume->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+	CollisionVolume->SetGenerateOverlapEvents(false);
+
+	if (!FParkedComponent::IsEnabled()) return;
+
+	if (!Mesh->GetStaticMesh()) {
+
+		ParkedMesh.SetParked(Mesh, true);
+	}
+	if (!IdleParticlesComponent->IsActive()) {
+
+		ParkedParticles.SetParked(IdleParticlesComponent, true);
+	}
+}
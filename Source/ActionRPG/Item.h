@@ -4,10 +4,12 @@
 
 #include "CoreMinimal.h"
 #include "GameFramework/Actor.h"
+#include "PoolableActor.h"
+#include "ParkedComponent.h"
 #include "Item.generated.h"
 
 UCLASS()
-class ACTIONRPG_API AItem : public AActor
+class ACTIONRPG_API AItem : public AActor, public IPoolableActor
 {
 	GENERATED_BODY()
 	
@@ -51,4 +53,17 @@ public:
 
 	UFUNCTION()
 	virtual void OnOverlapEnd(UPrimitiveComponent* OverlappedComponent, AActor* OtherActor, UPrimitiveComponent* OtherComp, int32 OtherBodyIndex);
+
+	virtual void OnAcquiredFromPool() override;
+
+	virtual void OnReturnedToPool() override;
+
+	// Off while the item is carried: nothing overlaps CollisionVolume, and Mesh and IdleParticlesComponent
+	// stop following it when they have nothing to show. Back on when the item returns to the world.
+	void SetPickupActive(bool bActive);
+
+private:
+
+	FParkedComponent ParkedMesh;
+	FParkedComponent ParkedParticles;
 };
\ No newline at end of file
@@ -17,6 +17,10 @@
 #include "MainPlayerController.h"
 #include "SaveGameRPG.h"
 #include "ItemStorage.h"
+#include "EnemyAggroSubsystem.h"
+#include "AttackTokenComponent.h"
+#include "EnemyHearingSubsystem.h"
+#include "GameplayAudioSubsystem.h"
 
 // Sets default values
 AMain::AMain()
@@ -39,6 +43,8 @@ AMain::AMain()
 	// Attach the camera to the end of the boom and let the boom adjust to match the controller orientation
 	FollowCamera->bUsePawnControlRotation = false;
 
+	AttackTokens = CreateDefaultSubobject<UAttackTokenComponent>(TEXT("AttackTokens"));
+
 	BaseTurnRate = 65.f;
 	BaseLookUpRate = 65.f;
 
@@ -500,9 +506,10 @@ void AMain::AttackEnd()
 
 void AMain::PlaySwingSound()
 {
-	if (EquippedWeapon->SwingSound) {
+	if (EquippedWeapon && EquippedWeapon->SwingSound) {
 
-		UGameplayStatics::PlaySound2D(this, EquippedWeapon->SwingSound);
+		UGameplayAudioSubsystem::PlaySound2D(this, EquippedWeapon->SwingSound);
+		UEnemyHearingSubsystem::ReportNoise(this, GetActorLocation(), 0.5f, this);
 	}
 }
 
@@ -536,7 +543,17 @@ float AMain::TakeDamage(float DamageAmount, FDamageEvent const& DamageEvent, ACo
 void AMain::UpdateCombatTarget()
 {
 	TArray<AActor*> OverlappingActors;
-	GetOverlappingActors(OverlappingActors, EnemyFilter);
+
+	// With the aggro spheres switched off nothing overlaps us, ask the aggro grid instead
+	UEnemyAggroSubsystem* Aggro = GetWorld()->GetSubsystem<UEnemyAggroSubsystem>();
+	if (Aggro && Aggro->bReplaceOverlapSpheres) {
+
+		Aggro->GetEnemiesInRange(this, OverlappingActors, EnemyFilter);
+	}
+	else {
+
+		GetOverlappingActors(OverlappingActors, EnemyFilter);
+	}
 
 	if (OverlappingActors.Num() == 0) {
 
@@ -81,6 +81,10 @@ public:
 
 	FORCEINLINE void SetCombatTarget(AEnemy* Target) { CombatTarget = Target; }
 
+	// Limits how many enemies swing at the player at once
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Combat")
+	class UAttackTokenComponent* AttackTokens;
+
 	FRotator GetLookAtRotationYaw(FVector Target);
 
 	// Set movement status and running speed
@@ -2,30 +2,101 @@
 
 
 #include "MainAnimInstance.h"
+#include "ActionRPG.h"
 #include "GameFramework/CharacterMovementComponent.h"
 #include "Main.h"
 
+DECLARE_CYCLE_STAT(TEXT("Main Anim Update Game Thread"), STAT_MainAnimGameThread, STATGROUP_ActionRPG);
+DECLARE_CYCLE_STAT(TEXT("Main Anim Update Worker"), STAT_MainAnimWorker, STATGROUP_ActionRPG);
+
+void FMainAnimInstanceProxy::PreUpdate(UAnimInstance* InAnimInstance, float DeltaSeconds)
+{
+	SCOPE_CYCLE_COUNTER(STAT_MainAnimGameThread);
+
+	FAnimInstanceProxy::PreUpdate(InAnimInstance, DeltaSeconds);
+
+	UMainAnimInstance* Instance = CastChecked<UMainAnimInstance>(InAnimInstance);
+	bHasPawn = Instance->Pawn && CVarThreadSafeAnimUpdate.GetValueOnGameThread() != 0;
+
+	if (bHasPawn) {
+
+		Velocity = Instance->Pawn->GetVelocity();
+
+		UPawnMovementComponent* MovementComponent = Instance->Pawn->GetMovementComponent();
+		bIsFalling = MovementComponent && MovementComponent->IsFalling();
+	}
+}
+
+void FMainAnimInstanceProxy::Update(float DeltaSeconds)
+{
+	SCOPE_CYCLE_COUNTER(STAT_MainAnimWorker);
+
+	FAnimInstanceProxy::Update(DeltaSeconds);
+
+	if (bHasPawn) {
+
+		MovementSpeed = Velocity.Size2D();
+	}
+}
+
+void FMainAnimInstanceProxy::PostUpdate(UAnimInstance* InAnimInstance) const
+{
+	FAnimInstanceProxy::PostUpdate(InAnimInstance);
+
+	// Back on the game thread, where Blueprints read the instance
+	if (bHasPawn) {
+
+		UMainAnimInstance* Instance = CastChecked<UMainAnimInstance>(InAnimInstance);
+		Instance->MovementSpeed = MovementSpeed;
+		Instance->bIsInAir = bIsFalling;
+	}
+}
+
 void UMainAnimInstance::NativeInitializeAnimation()
 {
 	if (Pawn == nullptr) {
 
 		Pawn = TryGetPawnOwner();
-		
+
 		if (Pawn) {
 			Main = Cast<AMain>(Pawn);
 		}
 	}
 }
 
+void UMainAnimInstance::NativeUpdateAnimation(float DeltaSeconds)
+{
+	Super::NativeUpdateAnimation(DeltaSeconds);
+
+	// No pawn yet at initialization, the next PreUpdate picks it up
+	if (Pawn == nullptr) {
+
+		Pawn = TryGetPawnOwner();
+		if (Pawn) {
+
+			Main = Cast<AMain>(Pawn);
+		}
+	}
+}
+
+FAnimInstanceProxy* UMainAnimInstance::CreateAnimInstanceProxy()
+{
+	return new FMainAnimInstanceProxy(this);
+}
+
 void UMainAnimInstance::UpdateAnimationProperties()
 {
+	if (CVarThreadSafeAnimUpdate.GetValueOnGameThread() != 0) return;
+
+	SCOPE_CYCLE_COUNTER(STAT_MainAnimGameThread);
+
 	if (Pawn == nullptr) {
 
 		Pawn = TryGetPawnOwner();
 	}
 
 	if (Pawn) {
-		
+
 		FVector Speed = Pawn->GetVelocity();
 		FVector LateralSpeed = FVector(Speed.X, Speed.Y, 0.f);
 		MovementSpeed = LateralSpeed.Size();
@@ -0,0 +1,167 @@
+// Copyright by Hakan Akkurt
+
+
+#include "MeleeSwingSubsystem.h"
+#include "ActionRPG.h"
+#include "Components/BoxComponent.h"
+#include "Engine/World.h"
+#include "Engine/Engine.h"
+
+DECLARE_CYCLE_STAT(TEXT("Melee Sweeps"), STAT_MeleeSweeps, STATGROUP_ActionRPG);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Melee Active Swings"), STAT_MeleeSwings, STATGROUP_ActionRPG);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Melee Sweep Queries"), STAT_MeleeQueries, STATGROUP_ActionRPG);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Melee Hits"), STAT_MeleeHits, STATGROUP_ActionRPG);
+
+UMeleeSwingSubsystem::UMeleeSwingSubsystem()
+{
+	MaxSubsteps = 4;
+	SubstepAngle = 20.f;
+
+	NextId = 1;
+}
+
+UMeleeSwingSubsystem* UMeleeSwingSubsystem::Get(const UObject* WorldContextObject)
+{
+	UWorld* World = GEngine->GetWorldFromContextObject(WorldContextObject, EGetWorldErrorMode::ReturnNull);
+	return World ? World->GetSubsystem<UMeleeSwingSubsystem>() : nullptr;
+}
+
+bool UMeleeSwingSubsystem::ShouldCreateSubsystem(UObject* Outer) const
+{
+	UWorld* World = Cast<UWorld>(Outer);
+	return World && World->IsGameWorld();
+}
+
+void UMeleeSwingSubsystem::Deinitialize()
+{
+	Swings.Empty();
+
+	Super::Deinitialize();
+}
+
+void UMeleeSwingSubsystem::BeginSwing(FMeleeSwingHandle& Handle, UBoxComponent* Blade, const TArray<AActor*>& IgnoredActors, FOnMeleeHits OnHits)
+{
+	EndSwing(Handle);
+	if (!Blade) return;
+
+	FMeleeSwing& Swing = Swings.AddDefaulted_GetRef();
+	Swing.Id = NextId++;
+	Swing.Blade = Blade;
+	Swing.Previous = Blade->GetComponentTransform();
+	Swing.Params = FCollisionQueryParams(SCENE_QUERY_STAT(MeleeSwing), false);
+	Swing.Params.AddIgnoredActors(IgnoredActors);
+	Swing.OnHits = MoveTemp(OnHits);
+
+	// Zero is the invalid handle
+	if (NextId == 0) { NextId = 1; }
+
+	Handle.Id = Swing.Id;
+}
+
+void UMeleeSwingSubsystem::EndSwing(FMeleeSwingHandle& Handle)
+{
+	if (!Handle.IsValid()) return;
+
+	const int32 Index = Swings.IndexOfByPredicate([&Handle](const FMeleeSwing& Swing) { return Swing.Id == Handle.Id; });
+	if (Index != INDEX_NONE) {
+
+		Swings.RemoveAtSwap(Index);
+	}
+	Handle.Invalidate();
+}
+
+bool UMeleeSwingSubsystem::IsTickable() const
+{
+	return !IsTemplate() && Swings.Num() > 0;
+}
+
+ETickableTickType UMeleeSwingSubsystem::GetTickableTickType() const
+{
+	return IsTemplate() ? ETickableTickType::Never : ETickableTickType::Conditional;
+}
+
+TStatId UMeleeSwingSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UMeleeSwingSubsystem, STATGROUP_Tickables);
+}
+
+void UMeleeSwingSubsystem::Tick(float DeltaTime)
+{
+	// Hits are handed out only after every swing is swept, callbacks may end or start swings
+	TArray<TPair<FOnMeleeHits, TArray<FHitResult>>> Deliveries;
+	int32 NumHits = 0;
+
+	{
+		SCOPE_CYCLE_COUNTER(STAT_MeleeSweeps);
+
+		TArray<FHitResult> FrameHits;
+		for (int32 Index = Swings.Num() - 1; Index >= 0; --Index) {
+
+			FMeleeSwing& Swing = Swings[Index];
+			if (!Swing.Blade.IsValid()) {
+
+				Swings.RemoveAtSwap(Index);
+				continue;
+			}
+
+			FrameHits.Reset();
+			SweepSwing(Swing, FrameHits);
+
+			if (FrameHits.Num() > 0) {
+
+				NumHits += FrameHits.Num();
+				Deliveries.Emplace(Swing.OnHits, FrameHits);
+			}
+		}
+	}
+
+	SET_DWORD_STAT(STAT_MeleeSwings, Swings.Num());
+	SET_DWORD_STAT(STAT_MeleeHits, NumHits);
+
+	for (TPair<FOnMeleeHits, TArray<FHitResult>>& Delivery : Deliveries) {
+
+		Delivery.Key.ExecuteIfBound(Delivery.Value);
+	}
+}
+
+void UMeleeSwingSubsystem::SweepSwing(FMeleeSwing& Swing, TArray<FHitResult>& FrameHits) const
+{
+	UBoxComponent* Blade = Swing.Blade.Get();
+	const FTransform Current = Blade->GetComponentTransform();
+	const FTransform Previous = Swing.Previous;
+	Swing.Previous = Current;
+
+	const FVector Extent = Blade->GetScaledBoxExtent();
+	const FCollisionShape Shape = FCollisionShape::MakeBox(Extent);
+	const FCollisionObjectQueryParams ObjectParams(ECollisionChannel::ECC_Pawn);
+
+	// A sweep can't rotate the box, turning swings are cut into steps no wider than SubstepAngle
+	const float Angle = FMath::RadiansToDegrees(Previous.GetRotation().AngularDistance(Current.GetRotation()));
+	const int32 Steps = FMath::Clamp(FMath::CeilToInt(Angle / FMath::Max(SubstepAngle, 1.f)), 1, FMath::Max(MaxSubsteps, 1));
+
+	UWorld* World = GetWorld();
+	TArray<FHitResult> Hits;
+
+	for (int32 Step = 0; Step < Steps; ++Step) {
+
+		const float From = (float)Step / Steps;
+		const float To = (float)(Step + 1) / Steps;
+
+		const FVector Start = FMath::Lerp(Previous.GetLocation(), Current.GetLocation(), From);
+		const FVector End = FMath::Lerp(Previous.GetLocation(), Current.GetLocation(), To);
+		const FQuat Rotation = FQuat::Slerp(Previous.GetRotation(), Current.GetRotation(), (From + To) * 0.5f);
+
+		Hits.Reset();
+		World->SweepMultiByObjectType(Hits, Start, End, Rotation, ObjectParams, Shape, Swing.Params);
+		INC_DWORD_STAT(STAT_MeleeQueries);
+
+		for (FHitResult& Hit : Hits) {
+
+			AActor* Actor = Hit.GetActor();
+			if (!Actor || Swing.HitActors.Contains(Actor)) continue;
+
+			Swing.HitActors.Add(Actor);
+			FrameHits.Add(MoveTemp(Hit));
+		}
+	}
+}
@@ -0,0 +1,88 @@
+// Copyright by Hakan Akkurt
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "Tickable.h"
+#include "MeleeSwingSubsystem.generated.h"
+
+// Every new actor a swing touched this frame, at most one hit per actor over the whole swing
+DECLARE_DELEGATE_OneParam(FOnMeleeHits, const TArray<FHitResult>&);
+
+// Identifies one swing, goes stale once it is ended
+struct FMeleeSwingHandle
+{
+	FMeleeSwingHandle() : Id(0) {}
+
+	bool IsValid() const { return Id != 0; }
+
+	void Invalidate() { Id = 0; }
+
+private:
+
+	friend class UMeleeSwingSubsystem;
+
+	uint32 Id;
+};
+
+/**
+ * Melee hit detection by sweeping. While a swing is active its blade box is swept each frame from
+ * where it was last frame to where the animation has put it, in substeps when it turned a lot, so
+ * fast swings can't pass through a target between frames. All swings are swept together at the end
+ * of the frame, each actor is hit at most once per swing and every swing gets one list of hits.
+ */
+UCLASS(Config = Game)
+class ACTIONRPG_API UMeleeSwingSubsystem : public UWorldSubsystem, public FTickableGameObject
+{
+	GENERATED_BODY()
+
+public:
+
+	UMeleeSwingSubsystem();
+
+	static UMeleeSwingSubsystem* Get(const UObject* WorldContextObject);
+
+	// Upper bound on sweeps per swing per frame
+	UPROPERTY(Config, EditAnywhere, BlueprintReadOnly, Category = "Melee")
+	int32 MaxSubsteps;
+
+	// A swing that turned more than this in a frame is swept in several steps
+	UPROPERTY(Config, EditAnywhere, BlueprintReadOnly, Category = "Melee")
+	float SubstepAngle;
+
+	// Sweeps Blade against pawns until EndSwing, an already running Handle is ended first
+	void BeginSwing(FMeleeSwingHandle& Handle, class UBoxComponent* Blade, const TArray<AActor*>& IgnoredActors, FOnMeleeHits OnHits);
+
+	void EndSwing(FMeleeSwingHandle& Handle);
+
+	virtual bool ShouldCreateSubsystem(UObject* Outer) const override;
+
+	virtual void Deinitialize() override;
+
+	// FTickableGameObject
+	virtual void Tick(float DeltaTime) override;
+	virtual bool IsTickable() const override;
+	virtual ETickableTickType GetTickableTickType() const override;
+	virtual TStatId GetStatId() const override;
+	virtual UWorld* GetTickableGameObjectWorld() const override { return GetWorld(); }
+
+private:
+
+	struct FMeleeSwing
+	{
+		uint32 Id;
+		TWeakObjectPtr<UBoxComponent> Blade;
+		FTransform Previous;
+		FCollisionQueryParams Params;
+		TArray<TWeakObjectPtr<AActor>> HitActors;
+		FOnMeleeHits OnHits;
+	};
+
+	// Sweeps one swing from its previous transform to the blade's current one, new hits go to FrameHits
+	void SweepSwing(FMeleeSwing& Swing, TArray<FHitResult>& FrameHits) const;
+
+	TArray<FMeleeSwing> Swings;
+
+	uint32 NextId;
+};
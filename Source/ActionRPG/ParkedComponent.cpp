@@ -0,0 +1,59 @@
+// Copyright by Hakan Akkurt
+
+
+#include "ParkedComponent.h"
+#include "ActionRPG.h"
+#include "Components/PrimitiveComponent.h"
+
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Parked Components"), STAT_ParkedComponents, STATGROUP_ActionRPG);
+
+bool FParkedComponent::IsEnabled()
+{
+	return CVarParkHitboxes.GetValueOnGameThread() != 0;
+}
+
+void FParkedComponent::SetParked(USceneComponent* Component, bool bPark)
+{
+	if (!Component || bPark == bParked) return;
+
+	UPrimitiveComponent* Primitive = Cast<UPrimitiveComponent>(Component);
+
+	if (bPark) {
+
+		// A root or an already loose component has nothing to stop following
+		if (!Component->GetAttachParent()) return;
+
+		Parent = Component->GetAttachParent();
+		Socket = Component->GetAttachSocketName();
+		RelativeTransform = Component->GetRelativeTransform();
+
+		if (Primitive) {
+
+			bGenerateOverlapEvents = Primitive->GetGenerateOverlapEvents();
+			Primitive->SetGenerateOverlapEvents(false);
+		}
+
+		Component->DetachFromComponent(FDetachmentTransformRules::KeepWorldTransform);
+		bParked = true;
+		INC_DWORD_STAT(STAT_ParkedComponents);
+		return;
+	}
+
+	bParked = false;
+	DEC_DWORD_STAT(STAT_ParkedComponents);
+
+	if (Primitive) {
+
+		Primitive->SetGenerateOverlapEvents(bGenerateOverlapEvents);
+	}
+
+	// The parent went away with its owner, the component stays where it is
+	if (!Parent.IsValid()) return;
+
+	// Attaching keeping the relative transform updates the component to the parent's current pose
+	Component->SetRelativeLocation_Direct(RelativeTransform.GetLocation());
+	Component->SetRelativeRotation_Direct(RelativeTransform.Rotator());
+	Component->SetRelativeScale3D_Direct(RelativeTransform.GetScale3D());
+	Component->AttachToComponent(Parent.Get(), FAttachmentTransformRules::KeepRelativeTransform, Socket);
+	Parent = nullptr;
+}
@@ -0,0 +1,34 @@
+// Copyright by Hakan Akkurt
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+class USceneComponent;
+
+/**
+ * Takes a component out of its attachment while nothing needs it, e.g. a blade box between hit windows.
+ * A parked component is detached where it stands with its overlap events off, so moving the actor or
+ * animating the bone it hung from no longer updates its transform, bounds or overlaps. Unparking puts it
+ * back on the same parent and socket at its old relative transform, up to date with the parent's pose.
+ */
+struct ACTIONRPG_API FParkedComponent
+{
+	FParkedComponent() : bGenerateOverlapEvents(false), bParked(false) {}
+
+	// The ActionRPG.Hitbox.Park mode, off leaves every component attached like before
+	static bool IsEnabled();
+
+	// Parks or unparks Component, asking for the state it is already in does nothing
+	void SetParked(USceneComponent* Component, bool bPark);
+
+	bool IsParked() const { return bParked; }
+
+private:
+
+	TWeakObjectPtr<USceneComponent> Parent;
+	FName Socket;
+	FTransform RelativeTransform;
+	bool bGenerateOverlapEvents;
+	bool bParked;
+};
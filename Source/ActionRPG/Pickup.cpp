@@ -6,6 +6,9 @@
 #include "Kismet/GameplayStatics.h"
 #include "Engine/World.h"
 #include "Sound/SoundCue.h"
+#include "ActorPoolSubsystem.h"
+#include "FXPoolSubsystem.h"
+#include "GameplayAudioSubsystem.h"
 
 APickup::APickup()
 {
@@ -24,13 +27,13 @@ void APickup::OnOverlapBegin(UPrimitiveComponent* OverlappedComponent, AActor* O
 			OnPickupBP(Main);
 
 			if (OverlapParticles) {
-				UGameplayStatics::SpawnEmitterAtLocation(GetWorld(), OverlapParticles, GetActorLocation(), FRotator(0.f), true);
+				UFXPoolSubsystem::SpawnEmitterAtLocation(this, OverlapParticles, GetActorLocation());
 			}
 
 			if (OverlapSound) {
-				UGameplayStatics::PlaySound2D(this, OverlapSound);
+				UGameplayAudioSubsystem::PlaySound2D(this, OverlapSound);
 			}
-			Destroy();
+			UActorPoolSubsystem::ReleaseOrDestroy(this);
 		}
 	}
 }
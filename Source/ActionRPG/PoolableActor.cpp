@@ -0,0 +1,6 @@
+// Copyright by Hakan Akkurt
+
+
+#include "PoolableActor.h"
+
+// Add default functionality here for any IPoolableActor functions that are not pure virtual.
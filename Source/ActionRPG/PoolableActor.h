@@ -0,0 +1,32 @@
+// Copyright by Hakan Akkurt
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "UObject/Interface.h"
+#include "PoolableActor.generated.h"
+
+// This class does not need to be modified.
+UINTERFACE(MinimalAPI)
+class UPoolableActor : public UInterface
+{
+	GENERATED_BODY()
+};
+
+/**
+ * Implemented by actors that UActorPoolSubsystem hands out more than once.
+ * The pool already hides the actor, toggles collision and ticking and clears its timers,
+ * these hooks only need to reset gameplay state.
+ */
+class ACTIONRPG_API IPoolableActor
+{
+	GENERATED_BODY()
+
+public:
+
+	// Called after the actor has been moved into place and re-enabled
+	virtual void OnAcquiredFromPool() {}
+
+	// Called before the actor is hidden and parked in the pool
+	virtual void OnReturnedToPool() {}
+};
@@ -0,0 +1,390 @@
+// Copyright by Hakan Akkurt
+
+
+#include "ProjectileSubsystem.h"
+#include "ActionRPG.h"
+#include "Enemy.h"
+#include "EnemyArchetype.h"
+#include "Main.h"
+#include "EnemyHearingSubsystem.h"
+#include "FXPoolSubsystem.h"
+#include "GameplayAudioSubsystem.h"
+#include "Engine/World.h"
+#include "Engine/Engine.h"
+#include "Engine/StaticMesh.h"
+#include "Components/InstancedStaticMeshComponent.h"
+#include "Kismet/GameplayStatics.h"
+#include "Sound/SoundCue.h"
+#include "Containers/Ticker.h"
+#include "HAL/IConsoleManager.h"
+
+DECLARE_CYCLE_STAT(TEXT("Projectiles Resolve"), STAT_ProjectilesResolve, STATGROUP_ActionRPG);
+DECLARE_CYCLE_STAT(TEXT("Projectiles Advance"), STAT_ProjectilesAdvance, STATGROUP_ActionRPG);
+DECLARE_CYCLE_STAT(TEXT("Projectiles Visuals"), STAT_ProjectilesVisuals, STATGROUP_ActionRPG);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Projectiles Live"), STAT_ProjectilesLive, STATGROUP_ActionRPG);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Projectiles Hits"), STAT_ProjectilesHits, STATGROUP_ActionRPG);
+
+UProjectileSubsystem::UProjectileSubsystem()
+{
+	MaxProjectiles = 4096;
+	TraceChannel = ECC_WorldDynamic;
+
+	VisualOwner = nullptr;
+	LastUpdateSeconds = 0.0;
+}
+
+UProjectileSubsystem* UProjectileSubsystem::Get(const UObject* WorldContextObject)
+{
+	UWorld* World = GEngine->GetWorldFromContextObject(WorldContextObject, EGetWorldErrorMode::ReturnNull);
+	return World ? World->GetSubsystem<UProjectileSubsystem>() : nullptr;
+}
+
+bool UProjectileSubsystem::ShouldCreateSubsystem(UObject* Outer) const
+{
+	UWorld* World = Cast<UWorld>(Outer);
+	return World && World->IsGameWorld();
+}
+
+void UProjectileSubsystem::Deinitialize()
+{
+	ClearProjectiles();
+	Visuals.Empty();
+	InstanceScratch.Empty();
+	VisualOwner = nullptr;
+
+	Super::Deinitialize();
+}
+
+bool UProjectileSubsystem::Fire(const FProjectileParams& Params, const FVector& Location, const FVector& Direction, AActor* Instigator, AController* InstigatorController)
+{
+	if (!Params.Mesh || Positions.Num() >= MaxProjectiles) return false;
+
+	const int32 Visual = FindOrAddVisual(Params.Mesh);
+	if (Visual == INDEX_NONE) return false;
+
+	Positions.Add(Location);
+	Velocities.Add(Direction.GetSafeNormal() * Params.Speed);
+	Lifetimes.Add(Params.Lifetime);
+	GravityZ.Add(GetWorld()->GetGravityZ() * Params.GravityScale);
+	Radii.Add(FMath::Max(Params.Radius, 1.f));
+	Damage.Add(Params.Damage);
+	Scales.Add(Params.MeshScale);
+	VisualIndices.Add(Visual);
+	DamageTypes.Add(Params.DamageTypeClass);
+	Instigators.Add(Instigator);
+	Controllers.Add(InstigatorController);
+
+	// Swept for the first time on the next update
+	Sweeps.AddDefaulted();
+	return true;
+}
+
+void UProjectileSubsystem::ClearProjectiles()
+{
+	Positions.Reset();
+	Velocities.Reset();
+	Lifetimes.Reset();
+	GravityZ.Reset();
+	Radii.Reset();
+	Damage.Reset();
+	Scales.Reset();
+	VisualIndices.Reset();
+	DamageTypes.Reset();
+	Instigators.Reset();
+	Controllers.Reset();
+	Sweeps.Reset();
+
+	UpdateVisuals();
+}
+
+void UProjectileSubsystem::RemoveProjectile(int32 Index)
+{
+	Positions.RemoveAtSwap(Index, 1, false);
+	Velocities.RemoveAtSwap(Index, 1, false);
+	Lifetimes.RemoveAtSwap(Index, 1, false);
+	GravityZ.RemoveAtSwap(Index, 1, false);
+	Radii.RemoveAtSwap(Index, 1, false);
+	Damage.RemoveAtSwap(Index, 1, false);
+	Scales.RemoveAtSwap(Index, 1, false);
+	VisualIndices.RemoveAtSwap(Index, 1, false);
+	DamageTypes.RemoveAtSwap(Index, 1, false);
+	Instigators.RemoveAtSwap(Index, 1, false);
+	Controllers.RemoveAtSwap(Index, 1, false);
+	Sweeps.RemoveAtSwap(Index, 1, false);
+}
+
+int32 UProjectileSubsystem::FindOrAddVisual(UStaticMesh* Mesh)
+{
+	for (int32 Index = 0; Index < Visuals.Num(); ++Index) {
+
+		if (Visuals[Index] && Visuals[Index]->GetStaticMesh() == Mesh) return Index;
+	}
+
+	if (Visuals.Num() > MAX_uint16) return INDEX_NONE;
+
+	if (!VisualOwner) {
+
+		FActorSpawnParameters SpawnParams;
+		SpawnParams.Name = TEXT("Projectiles");
+		SpawnParams.ObjectFlags |= RF_Transient;
+
+		VisualOwner = GetWorld()->SpawnActor<AActor>(AActor::StaticClass(), FTransform::Identity, SpawnParams);
+		if (!VisualOwner) return INDEX_NONE;
+	}
+
+	// Instances are only drawn, the sweeps do all the colliding. The owner sits at the origin so instance space is world space
+	UInstancedStaticMeshComponent* Visual = NewObject<UInstancedStaticMeshComponent>(VisualOwner);
+	Visual->PrimaryComponentTick.bCanEverTick = false;
+	Visual->SetStaticMesh(Mesh);
+	Visual->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+	Visual->SetGenerateOverlapEvents(false);
+	Visual->SetCanEverAffectNavigation(false);
+	Visual->SetMobility(EComponentMobility::Movable);
+	Visual->RegisterComponent();
+	VisualOwner->AddInstanceComponent(Visual);
+
+	InstanceScratch.AddDefaulted();
+	return Visuals.Add(Visual);
+}
+
+bool UProjectileSubsystem::IsTickable() const
+{
+	return !IsTemplate() && Positions.Num() > 0;
+}
+
+ETickableTickType UProjectileSubsystem::GetTickableTickType() const
+{
+	return IsTemplate() ? ETickableTickType::Never : ETickableTickType::Conditional;
+}
+
+TStatId UProjectileSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UProjectileSubsystem, STATGROUP_Tickables);
+}
+
+void UProjectileSubsystem::Tick(float DeltaTime)
+{
+	const double Start = FPlatformTime::Seconds();
+
+	ResolveSweeps();
+	Advance(DeltaTime);
+	UpdateVisuals();
+
+	LastUpdateSeconds = FPlatformTime::Seconds() - Start;
+
+	SET_DWORD_STAT(STAT_ProjectilesLive, Positions.Num());
+}
+
+void UProjectileSubsystem::ResolveSweeps()
+{
+	SCOPE_CYCLE_COUNTER(STAT_ProjectilesResolve);
+
+	UWorld* World = GetWorld();
+	int32 Hits = 0;
+
+	// Backwards, a swapped in projectile has already been looked at
+	for (int32 Index = Positions.Num() - 1; Index >= 0; --Index) {
+
+		if (!Sweeps[Index].IsValid()) continue;
+
+		FTraceDatum Data;
+		if (!World->QueryTraceData(Sweeps[Index], Data)) continue;
+
+		const FHitResult* Hit = Data.OutHits.FindByPredicate([](const FHitResult& Result) { return Result.bBlockingHit; });
+		if (Hit) {
+
+			ApplyHit(Index, *Hit);
+			RemoveProjectile(Index);
+			++Hits;
+		}
+	}
+
+	SET_DWORD_STAT(STAT_ProjectilesHits, Hits);
+}
+
+void UProjectileSubsystem::Advance(float DeltaTime)
+{
+	SCOPE_CYCLE_COUNTER(STAT_ProjectilesAdvance);
+
+	UWorld* World = GetWorld();
+
+	for (int32 Index = Positions.Num() - 1; Index >= 0; --Index) {
+
+		Lifetimes[Index] -= DeltaTime;
+		if (Lifetimes[Index] <= 0.f) {
+
+			RemoveProjectile(Index);
+			continue;
+		}
+
+		Velocities[Index].Z += GravityZ[Index] * DeltaTime;
+
+		// Drawn at the end of the step right away, the sweep confirms it next frame
+		const FVector Start = Positions[Index];
+		const FVector End = Start + Velocities[Index] * DeltaTime;
+		Positions[Index] = End;
+
+		FCollisionQueryParams Params(SCENE_QUERY_STAT(ProjectileSweep), false, Instigators[Index].Get());
+		Sweeps[Index] = World->AsyncSweepByChannel(EAsyncTraceType::Single, Start, End, FQuat::Identity, TraceChannel,
+			FCollisionShape::MakeSphere(Radii[Index]), Params);
+	}
+}
+
+void UProjectileSubsystem::ApplyHit(int32 Index, const FHitResult& Hit)
+{
+	AActor* HitActor = Hit.GetActor();
+	AActor* Instigator = Instigators[Index].Get();
+	if (!HitActor || HitActor == Instigator) return;
+
+	// Enemies don't shoot each other
+	if (Instigator && Instigator->IsA<AEnemy>() && HitActor->IsA<AEnemy>()) return;
+
+	// Harmless, still removed by the hit
+	if (!DamageTypes[Index]) return;
+
+	UParticleSystem* HitParticles = nullptr;
+	USoundCue* HitSound = nullptr;
+
+	// The same effects a melee hit on the target plays
+	AMain* Main = Cast<AMain>(HitActor);
+	AEnemy* Enemy = Cast<AEnemy>(HitActor);
+	if (Main) {
+
+		HitParticles = Main->HitParticles;
+		HitSound = Main->HitSound;
+	}
+	else if (Enemy) {
+
+		HitParticles = Enemy->GetArchetype()->HitParticles;
+		HitSound = Enemy->GetArchetype()->HitSound;
+	}
+	else {
+
+		return;
+	}
+
+	if (HitParticles) {
+
+		UFXPoolSubsystem::SpawnEmitterAtLocation(this, HitParticles, Hit.ImpactPoint);
+	}
+	if (HitSound) {
+
+		UGameplayAudioSubsystem::PlaySoundAtLocation(this, HitSound, Hit.ImpactPoint);
+	}
+	UEnemyHearingSubsystem::ReportNoise(this, Hit.ImpactPoint, 1.f, Instigator);
+
+	UGameplayStatics::ApplyDamage(HitActor, Damage[Index], Controllers[Index].Get(), Instigator, DamageTypes[Index]);
+}
+
+void UProjectileSubsystem::UpdateVisuals()
+{
+	SCOPE_CYCLE_COUNTER(STAT_ProjectilesVisuals);
+
+	for (TArray<FTransform>& Transforms : InstanceScratch) {
+
+		Transforms.Reset();
+	}
+
+	for (int32 Index = 0; Index < Positions.Num(); ++Index) {
+
+		const FRotator Rotation = Velocities[Index].IsNearlyZero() ? FRotator::ZeroRotator : Velocities[Index].Rotation();
+		InstanceScratch[VisualIndices[Index]].Emplace(Rotation, Positions[Index], FVector(Scales[Index]));
+	}
+
+	for (int32 Visual = 0; Visual < Visuals.Num(); ++Visual) {
+
+		UInstancedStaticMeshComponent* Component = Visuals[Visual];
+		if (!Component) continue;
+
+		// Instances are only added or removed at the tail, everything else is moved in place
+		const TArray<FTransform>& Transforms = InstanceScratch[Visual];
+		const int32 NumInstances = Component->GetInstanceCount();
+		for (int32 Instance = NumInstances - 1; Instance >= Transforms.Num(); --Instance) {
+
+			Component->RemoveInstance(Instance);
+		}
+		for (int32 Instance = NumInstances; Instance < Transforms.Num(); ++Instance) {
+
+			Component->AddInstance(Transforms[Instance]);
+		}
+
+		if (Transforms.Num() > 0) {
+
+			Component->BatchUpdateInstancesTransforms(0, Transforms, false, true, true);
+		}
+	}
+}
+
+// ActionRPG.Projectiles.Stress [Count] [Seconds] [Mesh]
+// Keeps Count projectiles in the air around the player for Seconds and logs the average and worst update time
+static FAutoConsoleCommandWithWorldAndArgs ProjectileStressCommand(
+	TEXT("ActionRPG.Projectiles.Stress"),
+	TEXT("Keeps a number of harmless projectiles alive around the player. Usage: ActionRPG.Projectiles.Stress [Count=2000] [Seconds=10] [Mesh]"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateStatic([](const TArray<FString>& Args, UWorld* World)
+	{
+		UProjectileSubsystem* Projectiles = UProjectileSubsystem::Get(World);
+		APawn* PlayerPawn = World ? UGameplayStatics::GetPlayerPawn(World, 0) : nullptr;
+		if (!Projectiles || !PlayerPawn) return;
+
+		struct FStressTest
+		{
+			TWeakObjectPtr<UProjectileSubsystem> Projectiles;
+			TWeakObjectPtr<APawn> Pawn;
+			FProjectileParams Params;
+			int32 Count = 0;
+			float Remaining = 0.f;
+			int32 Frames = 0;
+			int32 PeakLive = 0;
+			double TotalSeconds = 0.0;
+			double WorstSeconds = 0.0;
+		};
+
+		TSharedRef<FStressTest> Test = MakeShared<FStressTest>();
+		Test->Projectiles = Projectiles;
+		Test->Pawn = PlayerPawn;
+		Test->Count = FMath::Max(1, Args.Num() > 0 ? FCString::Atoi(*Args[0]) : 2000);
+		Test->Remaining = Args.Num() > 1 ? FCString::Atof(*Args[1]) : 10.f;
+
+		// No damage type, so hits are swept and resolved but spawn no effects, make no noise and deal no damage
+		Test->Params.Mesh = LoadObject<UStaticMesh>(nullptr, Args.Num() > 2 ? *Args[2] : TEXT("/Engine/BasicShapes/Sphere.Sphere"));
+		Test->Params.MeshScale = 0.1f;
+		Test->Params.Speed = 800.f;
+		Test->Params.Lifetime = 2.f;
+		Test->Params.Damage = 0.f;
+		if (!Test->Params.Mesh) return;
+
+		FTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateLambda([Test](float DeltaTime)
+		{
+			UProjectileSubsystem* Projectiles = Test->Projectiles.Get();
+			APawn* Pawn = Test->Pawn.Get();
+			if (!Projectiles || !Pawn) return false;
+
+			// The update that ran this frame
+			if (Projectiles->GetNumProjectiles() > 0) {
+
+				++Test->Frames;
+				Test->TotalSeconds += Projectiles->GetLastUpdateSeconds();
+				Test->WorstSeconds = FMath::Max(Test->WorstSeconds, Projectiles->GetLastUpdateSeconds());
+			}
+
+			Test->Remaining -= DeltaTime;
+			if (Test->Remaining <= 0.f) {
+
+				UE_LOG(LogActionRPG, Log, TEXT("Projectile stress %d projectiles (peak %d live): %.3f ms average, %.3f ms worst over %d frames"),
+					Test->Count, Test->PeakLive, Test->Frames > 0 ? Test->TotalSeconds * 1000.0 / Test->Frames : 0.0, Test->WorstSeconds * 1000.0, Test->Frames);
+				return false;
+			}
+
+			// Top up to Count, fired outwards and slightly up from above the player's head
+			const FVector Origin = Pawn->GetActorLocation() + FVector(0.f, 0.f, 200.f);
+			while (Projectiles->GetNumProjectiles() < Test->Count) {
+
+				FVector Direction = FMath::VRand();
+				Direction.Z = FMath::Abs(Direction.Z) * 0.25f;
+
+				if (!Projectiles->Fire(Test->Params, Origin, Direction, Pawn, nullptr)) break;
+			}
+			Test->PeakLive = FMath::Max(Test->PeakLive, Projectiles->GetNumProjectiles());
+			return true;
+		}));
+	}));
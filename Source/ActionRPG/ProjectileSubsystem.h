@@ -0,0 +1,130 @@
+// Copyright by Hakan Akkurt
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "Tickable.h"
+#include "WorldCollision.h"
+#include "ProjectileSubsystem.generated.h"
+
+// What one shot looks like and does
+USTRUCT(BlueprintType)
+struct FProjectileParams
+{
+	GENERATED_BODY()
+
+	// Drawn through one instanced component per mesh, nothing is launched without one
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Projectile")
+	class UStaticMesh* Mesh = nullptr;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Projectile")
+	float MeshScale = 1.f;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Projectile")
+	float Speed = 1500.f;
+
+	// Collision sphere swept along the path
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Projectile")
+	float Radius = 10.f;
+
+	// 0 flies straight, 1 drops like everything else
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Projectile")
+	float GravityScale = 0.f;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Projectile")
+	float Lifetime = 3.f;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Projectile")
+	float Damage = 10.f;
+
+	// Without one a hit does nothing, no damage, effects or noise, the same as an enemy's melee swing
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Projectile")
+	TSubclassOf<UDamageType> DamageTypeClass;
+};
+
+/**
+ * Projectiles without actors. Every live projectile is a slot in a set of parallel arrays; each frame
+ * the sweeps submitted last frame are read back, hits go through ApplyDamage like melee hits do, and
+ * the survivors are moved and swept again as one batch of async sweeps. All projectiles sharing a
+ * mesh are drawn by one instanced static mesh component.
+ */
+UCLASS(Config = Game)
+class ACTIONRPG_API UProjectileSubsystem : public UWorldSubsystem, public FTickableGameObject
+{
+	GENERATED_BODY()
+
+public:
+
+	UProjectileSubsystem();
+
+	static UProjectileSubsystem* Get(const UObject* WorldContextObject);
+
+	// Shots past this are dropped
+	UPROPERTY(Config, EditAnywhere, BlueprintReadOnly, Category = "Projectiles")
+	int32 MaxProjectiles;
+
+	// Projectiles stop only on what blocks this channel, trigger volumes that merely overlap it let them through
+	UPROPERTY(Config, EditAnywhere, BlueprintReadOnly, Category = "Projectiles")
+	TEnumAsByte<ECollisionChannel> TraceChannel;
+
+	// Launches one projectile from Location along Direction, false when it could not be launched
+	bool Fire(const FProjectileParams& Params, const FVector& Location, const FVector& Direction, AActor* Instigator, AController* InstigatorController);
+
+	void ClearProjectiles();
+
+	FORCEINLINE int32 GetNumProjectiles() const { return Positions.Num(); }
+
+	// Game thread time of the last update, visuals included
+	FORCEINLINE double GetLastUpdateSeconds() const { return LastUpdateSeconds; }
+
+	virtual bool ShouldCreateSubsystem(UObject* Outer) const override;
+
+	virtual void Deinitialize() override;
+
+	// FTickableGameObject
+	virtual void Tick(float DeltaTime) override;
+	virtual bool IsTickable() const override;
+	virtual ETickableTickType GetTickableTickType() const override;
+	virtual TStatId GetStatId() const override;
+	virtual UWorld* GetTickableGameObjectWorld() const override { return GetWorld(); }
+
+private:
+
+	int32 FindOrAddVisual(UStaticMesh* Mesh);
+
+	void ResolveSweeps();
+
+	void Advance(float DeltaTime);
+
+	void UpdateVisuals();
+
+	void ApplyHit(int32 Index, const FHitResult& Hit);
+
+	void RemoveProjectile(int32 Index);
+
+	// Per projectile, all the same length
+	TArray<FVector> Positions;
+	TArray<FVector> Velocities;
+	TArray<float> Lifetimes;
+	TArray<float> GravityZ;
+	TArray<float> Radii;
+	TArray<float> Damage;
+	TArray<float> Scales;
+	TArray<uint16> VisualIndices;
+	TArray<TSubclassOf<UDamageType>> DamageTypes;
+	TArray<TWeakObjectPtr<AActor>> Instigators;
+	TArray<TWeakObjectPtr<AController>> Controllers;
+	TArray<FTraceHandle> Sweeps;
+
+	UPROPERTY()
+	TArray<class UInstancedStaticMeshComponent*> Visuals;
+
+	UPROPERTY()
+	AActor* VisualOwner;
+
+	// Instance transforms per visual, reused every frame
+	TArray<TArray<FTransform>> InstanceScratch;
+
+	double LastUpdateSeconds;
+};
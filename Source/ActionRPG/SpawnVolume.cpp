@@ -2,11 +2,19 @@
 
 
 #include "SpawnVolume.h"
+#include "ActionRPG.h"
 #include "Components/BoxComponent.h"
+#include "Components/CapsuleComponent.h"
 #include "Kismet/KismetMathLibrary.h"
 #include "Engine/World.h"
 #include "Enemy.h"
 #include "AIController.h"
+#include "ActorPoolSubsystem.h"
+#include "ActionRPGGameModeBase.h"
+#include "NavigationSystem.h"
+
+DECLARE_CYCLE_STAT(TEXT("Spawn Queue Drain"), STAT_SpawnQueueDrain, STATGROUP_ActionRPG);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Spawn Queue Spawned"), STAT_SpawnQueueSpawned, STATGROUP_ActionRPG);
 
 // Sets default values
 ASpawnVolume::ASpawnVolume()
@@ -16,6 +24,13 @@ ASpawnVolume::ASpawnVolume()
 
 	SpawningBox = CreateDefaultSubobject<UBoxComponent>(TEXT("SpawningBox"));
 
+	PoolPrewarmCount = 4;
+	NumSpawnPoints = 32;
+	SpawnBudgetMs = 1.f;
+
+	TotalWeight = 0.f;
+	NextQueuedSpawn = 0;
+
 }
 
 // Called when the game starts or when spawned
@@ -23,13 +38,70 @@ void ASpawnVolume::BeginPlay()
 {
 	Super::BeginPlay();
 	
-	if (Actor_1 && Actor_2 && Actor_3 && Actor_4 && Actor_5) {
+	BuildSpawnTable();
+	BakeSpawnPoints();
+
+	UActorPoolSubsystem* ActorPool = GetWorld()->GetSubsystem<UActorPoolSubsystem>();
+	if (ActorPool) {
+
+		for (const FSpawnTableEntry& Entry : SpawnTable) {
 
-		SpawnArray.Add(Actor_1);
-		SpawnArray.Add(Actor_2);
-		SpawnArray.Add(Actor_3);
-		SpawnArray.Add(Actor_4);
-		SpawnArray.Add(Actor_5);
+			if (Entry.ActorClass) {
+
+				ActorPool->Prewarm(Entry.ActorClass, PoolPrewarmCount);
+			}
+		}
+	}
+}
+
+void ASpawnVolume::BuildSpawnTable()
+{
+	for (TSubclassOf<AActor> LegacyClass : { Actor_1, Actor_2, Actor_3, Actor_4, Actor_5 }) {
+
+		if (LegacyClass) {
+
+			SpawnTable.Add({ LegacyClass, 1.f });
+		}
+	}
+
+	TotalWeight = 0.f;
+	for (const FSpawnTableEntry& Entry : SpawnTable) {
+
+		if (Entry.ActorClass && Entry.Weight > 0.f) {
+
+			TotalWeight += Entry.Weight;
+		}
+	}
+}
+
+void ASpawnVolume::BakeSpawnPoints()
+{
+	SpawnPoints.Reset();
+
+	UNavigationSystemV1* NavSys = FNavigationSystem::GetCurrent<UNavigationSystemV1>(GetWorld());
+	if (!NavSys || NumSpawnPoints <= 0) return;
+
+	const FVector Extent = SpawningBox->GetScaledBoxExtent();
+	const FVector Origin = SpawningBox->GetComponentLocation();
+	const FBox Bounds(Origin - Extent, Origin + Extent);
+
+	// Searched through the full height of the box, points the projection pushes out of it are dropped
+	const FVector QueryExtent(50.f, 50.f, Extent.Z);
+
+	const int32 MaxAttempts = NumSpawnPoints * 4;
+	for (int32 Attempt = 0; Attempt < MaxAttempts && SpawnPoints.Num() < NumSpawnPoints; ++Attempt) {
+
+		FNavLocation NavLocation;
+		const FVector Point = UKismetMathLibrary::RandomPointInBoundingBox(Origin, Extent);
+		if (NavSys->ProjectPointToNavigation(Point, NavLocation, QueryExtent) && Bounds.IsInsideXY(NavLocation.Location)) {
+
+			SpawnPoints.Add(NavLocation.Location);
+		}
+	}
+
+	if (SpawnPoints.Num() == 0) {
+
+		UE_LOG(LogActionRPG, Warning, TEXT("%s found no navmesh inside its box, spawning at random points instead"), *GetName());
 	}
 }
 
@@ -38,10 +110,16 @@ void ASpawnVolume::Tick(float DeltaTime)
 {
 	Super::Tick(DeltaTime);
 
+	DrainSpawnQueue();
 }
 
 FVector ASpawnVolume::GetSpawnPoint()
 {
+	if (SpawnPoints.Num() > 0) {
+
+		return SpawnPoints[FMath::RandRange(0, SpawnPoints.Num() - 1)];
+	}
+
 	FVector Extent = SpawningBox->GetScaledBoxExtent();
 	FVector Origin = SpawningBox->GetComponentLocation();
 
@@ -53,37 +131,112 @@ FVector ASpawnVolume::GetSpawnPoint()
 void ASpawnVolume::SpawnOurActor_Implementation(UClass* ToSpawn, const FVector& Location)
 {
 	if (ToSpawn) {
-		UWorld* World = GetWorld();
-		FActorSpawnParameters SpawnParams;
 
-		if (World) {
-			AActor* Actor = World->SpawnActor<AActor>(ToSpawn, Location, FRotator(0.f), SpawnParams);
+		SpawnQueue.Add({ ToSpawn, Location, SpawnPoints.Contains(Location) });
+	}
+}
+
+void ASpawnVolume::QueueWave(int32 Count)
+{
+	for (int32 i = 0; i < Count; ++i) {
+
+		UClass* ToSpawn = GetSpawnActor();
+		if (!ToSpawn) return;
 
-			AEnemy* Enemy = Cast<AEnemy>(Actor);
-			if (Enemy) {
+		SpawnOurActor(ToSpawn, GetSpawnPoint());
+	}
+}
 
-				Enemy->SpawnDefaultController();
+void ASpawnVolume::DrainSpawnQueue()
+{
+	if (NextQueuedSpawn >= SpawnQueue.Num()) return;
 
-				AAIController* AICont = Cast<AAIController>(Enemy->GetController());
-				if (AICont) {
+	SCOPE_CYCLE_COUNTER(STAT_SpawnQueueDrain);
 
-					Enemy->AIController = AICont;
-				}
-			}
+	// Pooled enemies keep their AI controller, AEnemy::OnAcquiredFromPool spawns one on first use
+	UActorPoolSubsystem* ActorPool = GetWorld()->GetSubsystem<UActorPoolSubsystem>();
+
+	// The director holds spawns back once the population or its frame budget is used up
+	AActionRPGGameModeBase* Director = GetWorld()->GetAuthGameMode<AActionRPGGameModeBase>();
+
+	const double Deadline = FPlatformTime::Seconds() + SpawnBudgetMs / 1000.0;
+	int32 Spawned = 0;
+
+	while (NextQueuedSpawn < SpawnQueue.Num() && (Spawned == 0 || FPlatformTime::Seconds() < Deadline)) {
+
+		const FQueuedSpawn& Spawn = SpawnQueue[NextQueuedSpawn];
+		UClass* Class = Spawn.Class.Get();
+		if (!Class) {
+
+			++NextQueuedSpawn;
+			continue;
 		}
+
+		// Baked spawn points sit on the navmesh, characters go in standing on it
+		FVector Location = Spawn.Location;
+		const ACharacter* Defaults = Cast<ACharacter>(Class->GetDefaultObject());
+		if (Defaults && Spawn.bOnNavmesh) {
+
+			Location.Z += Defaults->GetCapsuleComponent()->GetScaledCapsuleHalfHeight();
+		}
+
+		const FTransform Transform(FRotator(0.f), Location);
+		if (!ActorPool) {
+
+			SpawnUnpooled(Class, Transform);
+		}
+		else if (Director) {
+
+			if (!Director->RequestSpawn(Class, Transform)) break;
+		}
+		else {
+
+			ActorPool->AcquireActor(Class, Transform);
+		}
+		++NextQueuedSpawn;
+		++Spawned;
+	}
+
+	if (NextQueuedSpawn >= SpawnQueue.Num()) {
+
+		SpawnQueue.Reset();
+		NextQueuedSpawn = 0;
+	}
+
+	INC_DWORD_STAT_BY(STAT_SpawnQueueSpawned, Spawned);
+}
+
+AActor* ASpawnVolume::SpawnUnpooled(UClass* Class, const FTransform& Transform)
+{
+	FActorSpawnParameters SpawnParams;
+	SpawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AdjustIfPossibleButAlwaysSpawn;
+
+	AActor* Actor = GetWorld()->SpawnActor<AActor>(Class, Transform, SpawnParams);
+
+	AEnemy* Enemy = Cast<AEnemy>(Actor);
+	if (Enemy) {
+
+		Enemy->SpawnDefaultController();
+		Enemy->AIController = Cast<AAIController>(Enemy->GetController());
 	}
+	return Actor;
 }
 
 TSubclassOf<AActor> ASpawnVolume::GetSpawnActor()
 {
-	if (SpawnArray.Num() > 0) {
+	if (TotalWeight <= 0.f) return nullptr;
 
-		int32 Selection = FMath::RandRange(0, SpawnArray.Num() - 1);
+	float Pick = FMath::FRand() * TotalWeight;
+	TSubclassOf<AActor> Selection = nullptr;
 
-		return SpawnArray[Selection];
-	}
-	else {
+	for (const FSpawnTableEntry& Entry : SpawnTable) {
+
+		if (!Entry.ActorClass || Entry.Weight <= 0.f) continue;
 
-		return nullptr;
+		// The last usable entry catches what rounding leaves over
+		Selection = Entry.ActorClass;
+		Pick -= Entry.Weight;
+		if (Pick < 0.f) break;
 	}
+	return Selection;
 }
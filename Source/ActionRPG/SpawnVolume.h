@@ -6,6 +6,19 @@
 #include "GameFramework/Actor.h"
 #include "SpawnVolume.generated.h"
 
+// One row of a spawn volume's table, picked with a chance proportional to Weight
+USTRUCT(BlueprintType)
+struct FSpawnTableEntry
+{
+	GENERATED_BODY()
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Spawning")
+	TSubclassOf<AActor> ActorClass;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Spawning", meta = (ClampMin = "0"))
+	float Weight = 1.f;
+};
+
 UCLASS()
 class ACTIONRPG_API ASpawnVolume : public AActor
 {
@@ -18,6 +31,10 @@ public:
 	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Spawning")
 	class UBoxComponent* SpawningBox;
 
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Spawning")
+	TArray<FSpawnTableEntry> SpawnTable;
+
+	// Kept for volumes placed before SpawnTable, each one that is set joins the table with weight 1
 	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Spawning")
 	TSubclassOf<AActor> Actor_1;
 
@@ -33,7 +50,17 @@ public:
 	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Spawning")
 	TSubclassOf<AActor> Actor_5;
 
-	TArray<TSubclassOf<AActor>> SpawnArray;
+	// Inactive instances of each spawn class created at BeginPlay so waves don't go through SpawnActor
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Spawning")
+	int32 PoolPrewarmCount;
+
+	// Points on the navmesh inside the box, found at BeginPlay and handed out by GetSpawnPoint
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Spawning")
+	int32 NumSpawnPoints;
+
+	// Queued spawns are drained each frame until this much time has been spent, at least one goes through
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Spawning")
+	float SpawnBudgetMs;
 
 protected:
 	// Called when the game starts or when spawned
@@ -49,7 +76,42 @@ public:
 	UFUNCTION(BlueprintPure, Category = "Spawning")
 	TSubclassOf<AActor> GetSpawnActor();
 
+	// Queues the spawn, it happens within the next frames' budget
 	UFUNCTION(BlueprintNativeEvent, BlueprintCallable, Category = "Spawning")
 	void SpawnOurActor(UClass* ToSpawn, const FVector& Location);
 
+	// Queues Count spawns picked from the table at cached spawn points
+	UFUNCTION(BlueprintCallable, Category = "Spawning")
+	void QueueWave(int32 Count);
+
+	UFUNCTION(BlueprintPure, Category = "Spawning")
+	int32 GetNumQueuedSpawns() const { return SpawnQueue.Num() - NextQueuedSpawn; }
+
+private:
+
+	struct FQueuedSpawn
+	{
+		TWeakObjectPtr<UClass> Class;
+		FVector Location;
+
+		// At a baked spawn point, on the navmesh rather than where the character's middle goes
+		bool bOnNavmesh;
+	};
+
+	void BuildSpawnTable();
+
+	void BakeSpawnPoints();
+
+	void DrainSpawnQueue();
+
+	// SpawnActor the way volumes spawned before the actor pool, for worlds without one
+	AActor* SpawnUnpooled(UClass* Class, const FTransform& Transform);
+
+	float TotalWeight;
+
+	TArray<FVector> SpawnPoints;
+
+	// Consumed from NextQueuedSpawn on and reset once empty, so draining never shifts the array
+	TArray<FQueuedSpawn> SpawnQueue;
+	int32 NextQueuedSpawn;
 };
@@ -10,7 +10,10 @@
 #include "particles/ParticleSystemComponent.h"
 #include "Components/BoxComponent.h"
 #include "Enemy.h"
-#include "Engine/SkeletalMeshSocket.h"
+#include "EnemyArchetype.h"
+#include "EnemyHearingSubsystem.h"
+#include "FXPoolSubsystem.h"
+#include "GameplayAudioSubsystem.h"
 
 
 AWeapon::AWeapon()
@@ -26,19 +29,20 @@ AWeapon::AWeapon()
 	WeaponState = EWeaponState::EWS_Pickup;
 
 	Damage = 25.f;
+
+	WeaponSocket = nullptr;
 }
 
 void AWeapon::BeginPlay()
 {
 	Super::BeginPlay();
 
-	CombatCollision->OnComponentBeginOverlap.AddDynamic(this, &AWeapon::CombatOnOverlapBegin);
-	CombatCollision->OnComponentEndOverlap.AddDynamic(this, &AWeapon::CombatOnOverlapEnd);
-
+	// Only the shape of the blade, swings are swept by UMeleeSwingSubsystem
 	CombatCollision->SetCollisionEnabled(ECollisionEnabled::NoCollision);
-	CombatCollision->SetCollisionObjectType(ECollisionChannel::ECC_WorldDynamic);
-	CombatCollision->SetCollisionResponseToAllChannels(ECollisionResponse::ECR_Ignore);
-	CombatCollision->SetCollisionResponseToChannel(ECollisionChannel::ECC_Pawn, ECollisionResponse::ECR_Overlap);
+
+	WeaponSocket = SkeletalMesh->GetSocketByName("WeaponSocket");
+
+	ParkedCombatCollision.SetParked(CombatCollision, FParkedComponent::IsEnabled());
 }
 
 void AWeapon::OnOverlapBegin(UPrimitiveComponent* OverlappedComponent, AActor* OtherActor, UPrimitiveComponent* OtherComp, int32 OtherBodyIndex, bool bFromSweep, const FHitResult& SweepResult)
@@ -94,30 +98,30 @@ void AWeapon::Equip(AMain* Char)
 			WeaponState = EWeaponState::EWS_Equipped;
 		}
 
-		if (OnEquipSound) { UGameplayStatics::PlaySound2D(this, OnEquipSound); }
+		if (OnEquipSound) { UGameplayAudioSubsystem::PlaySound2D(this, OnEquipSound); }
 		if (!bWeaponParticles) { IdleParticlesComponent->Deactivate(); }
+
+		SetPickupActive(false);
 	}
 }
 
-void AWeapon::CombatOnOverlapBegin(UPrimitiveComponent* OverlappedComponent, AActor* OtherActor, UPrimitiveComponent* OtherComp, int32 OtherBodyIndex, bool bFromSweep, const FHitResult& SweepResult)
+void AWeapon::OnSwingHits(const TArray<FHitResult>& Hits)
 {
-	if (OtherActor) {
+	for (const FHitResult& Hit : Hits) {
 
-		AEnemy* Enemy = Cast<AEnemy>(OtherActor);
+		AEnemy* Enemy = Cast<AEnemy>(Hit.GetActor());
 		if (Enemy) {
 
-			if (Enemy->HitParticles) {
-
-				const USkeletalMeshSocket* WeaponSocket = SkeletalMesh->GetSocketByName("WeaponSocket");
-				if (WeaponSocket) {
+			const UEnemyArchetype* Type = Enemy->GetArchetype();
+			if (Type->HitParticles && WeaponSocket) {
 
-					FVector SocketLocation = WeaponSocket->GetSocketLocation(SkeletalMesh);
-					UGameplayStatics::SpawnEmitterAtLocation(GetWorld(), Enemy->HitParticles, SocketLocation, FRotator(0.f), false);
-				}
+				FVector SocketLocation = WeaponSocket->GetSocketLocation(SkeletalMesh);
+				UFXPoolSubsystem::SpawnEmitterAtLocation(this, Type->HitParticles, SocketLocation);
 			}
-			if (Enemy->HitSound) {
-				UGameplayStatics::PlaySound2D(this, Enemy->HitSound);
+			if (Type->HitSound) {
+				UGameplayAudioSubsystem::PlaySoundAtLocation(this, Type->HitSound, Enemy->GetActorLocation());
 			}
+			UEnemyHearingSubsystem::ReportNoise(this, Enemy->GetActorLocation(), 1.f, this);
 			if (DamageTypeClass) {
 				UGameplayStatics::ApplyDamage(Enemy, Damage, WeaponInstigator, this, DamageTypeClass);
 			}
@@ -125,17 +129,30 @@ void AWeapon::CombatOnOverlapBegin(UPrimitiveComponent* OverlappedComponent, AAc
 	}
 }
 
-void AWeapon::CombatOnOverlapEnd(UPrimitiveComponent* OverlappedComponent, AActor* OtherActor, UPrimitiveComponent* OtherComp, int32 OtherBodyIndex)
+void AWeapon::ActivateCollision()
 {
+	// Back on the weapon before the swing reads where the blade is
+	ParkedCombatCollision.SetParked(CombatCollision, false);
 
-}
+	UMeleeSwingSubsystem* Melee = UMeleeSwingSubsystem::Get(this);
+	if (Melee) {
 
-void AWeapon::ActivateCollision()
-{
-	CombatCollision->SetCollisionEnabled(ECollisionEnabled::QueryOnly);
+		TArray<AActor*> IgnoredActors = { this };
+		if (WeaponInstigator && WeaponInstigator->GetPawn()) {
+
+			IgnoredActors.Add(WeaponInstigator->GetPawn());
+		}
+		Melee->BeginSwing(SwingHandle, CombatCollision, IgnoredActors, FOnMeleeHits::CreateUObject(this, &AWeapon::OnSwingHits));
+	}
 }
 
 void AWeapon::DeactivateCollision()
 {
-	CombatCollision->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+	UMeleeSwingSubsystem* Melee = UMeleeSwingSubsystem::Get(this);
+	if (Melee) {
+
+		Melee->EndSwing(SwingHandle);
+	}
+
+	ParkedCombatCollision.SetParked(CombatCollision, FParkedComponent::IsEnabled());
 }
@@ -4,6 +4,8 @@
 
 #include "CoreMinimal.h"
 #include "Item.h"
+#include "MeleeSwingSubsystem.h"
+#include "ParkedComponent.h"
 #include "Weapon.generated.h"
 
 UENUM(BlueprintType)
@@ -64,12 +66,10 @@ public:
 	FORCEINLINE void SetWeaponState(EWeaponState State) { WeaponState = State; }
 	FORCEINLINE EWeaponState GetWeaponState() { return WeaponState;  }
 
-	UFUNCTION()
-	void CombatOnOverlapBegin(UPrimitiveComponent* OverlappedComponent, AActor* OtherActor, UPrimitiveComponent* OtherComp, int32 OtherBodyIndex, bool bFromSweep, const FHitResult& SweepResult);
-
-	UFUNCTION()
-	void CombatOnOverlapEnd(UPrimitiveComponent* OverlappedComponent, AActor* OtherActor, UPrimitiveComponent* OtherComp, int32 OtherBodyIndex);
+	// Everything the swing cut through this frame, each enemy once per swing
+	void OnSwingHits(const TArray<FHitResult>& Hits);
 
+	// Starts sweeping CombatCollision, see UMeleeSwingSubsystem
 	UFUNCTION(BlueprintCallable)
 	void ActivateCollision();
 
@@ -83,4 +83,14 @@ public:
 	AController* WeaponInstigator;
 
 	FORCEINLINE void SetInstigator(AController* Inst) { WeaponInstigator = Inst; }
+
+private:
+
+	FMeleeSwingHandle SwingHandle;
+
+	// CombatCollision between hit windows
+	FParkedComponent ParkedCombatCollision;
+
+	// Looked up once, hit effects spawn here
+	const class USkeletalMeshSocket* WeaponSocket;
 };